@@ -1,7 +1,7 @@
 use std::{env, error::Error};
 
 use lapin::message::Delivery;
-use log::info;
+use log::{debug, info};
 use serde::Deserialize;
 
 pub struct QueueMessage {
@@ -18,6 +18,301 @@ pub struct JsonMessage {
     pub bumpiness: i16,
 }
 
+// Batched form of the device: {"device_id": "...", "segments": [[lat, lon, timestamp, bumpiness], ...]}
+#[derive(Debug, Deserialize)]
+struct JsonBatch {
+    device_id: String,
+    segments: Vec<(f64, f64, i64, i16)>,
+}
+
+// A message body holds either one segment or a batch
+#[derive(Debug, Deserialize)]
+#[serde(untagged)]
+enum JsonPayload {
+    Single(JsonMessage),
+    Batch(JsonBatch),
+}
+
+impl JsonPayload {
+    fn into_messages(self) -> Vec<JsonMessage> {
+        match self {
+            JsonPayload::Single(message) => vec![message],
+            JsonPayload::Batch(batch) => batch
+                .segments
+                .into_iter()
+                .map(|(lat, lon, timestamp, bumpiness)| JsonMessage {
+                    lat,
+                    lon,
+                    timestamp,
+                    device_id: batch.device_id.clone(),
+                    bumpiness,
+                })
+                .collect(),
+        }
+    }
+}
+
+// Binary form of the device (roadsense-embedded/lib/SegmentPayload.h), little-endian:
+// "RS", version, record count, device id length n, n bytes of device id, then the records.
+// Version 1: per record int32 latitude, int32 longitude [1e-7 deg], uint32 timestamp, uint8 bumpiness.
+// Version 2: the first record as in version 1, then per record the differences to the previous
+// one as zig-zag varints (latitude, longitude, timestamp) and the bumpiness byte.
+// Version 3: the version 2 records compressed with LZSS (roadsense-embedded/lib/Lzss.h).
+// Version 4: per record the version 1 record and 13 uint16 of vibration features (SegmentFeatures).
+const BINARY_MAGIC: &[u8] = b"RS";
+const BINARY_FIXED: u8 = 1;
+const BINARY_DELTA: u8 = 2;
+const BINARY_DELTA_LZ: u8 = 3;
+const BINARY_FEATURES: u8 = 4;
+const BINARY_HEADER_SIZE: usize = 5;
+const BINARY_RECORD_SIZE: usize = 13;
+const BINARY_FEATURE_SIZE: usize = 26;
+const BINARY_DELTA_MAX: usize = 16; // Longest delta record: three 5 byte varints and the bumpiness
+const BINARY_SCALE: f64 = 1e7;
+
+// LZSS parameters of the device
+const LZSS_OFFSET_BITS: u32 = 8;
+const LZSS_LENGTH_BITS: u32 = 4;
+const LZSS_MIN_MATCH: usize = 2;
+
+// Vibration features of a segment's Z acceleration (roadsense-embedded/lib/SegmentQuality.h),
+// raw sensor units (16384 = 1 g); the spectrum is zero when the device does not compute it
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct SegmentFeatures {
+    pub rms: u16,
+    pub peak_to_peak: u16,
+    pub crest_factor: u16, // [1/256]
+    pub kurtosis: u16,     // [1/256]
+    pub exceedances: [u16; 3],
+    pub samples: u16,
+    pub bands: [u16; 4],
+    pub frames: u16,
+}
+
+impl SegmentFeatures {
+    fn from_le_bytes(data: &[u8]) -> Self {
+        let field = |index: usize| u16::from_le_bytes([data[index * 2], data[index * 2 + 1]]);
+        SegmentFeatures {
+            rms: field(0),
+            peak_to_peak: field(1),
+            crest_factor: field(2),
+            kurtosis: field(3),
+            exceedances: [field(4), field(5), field(6)],
+            samples: field(7),
+            bands: [field(8), field(9), field(10), field(11)],
+            frames: field(12),
+        }
+    }
+}
+
+// View of a binary payload: version 1 and 4 records are read from the delivery buffer as they
+// are iterated, delta records are decoded by parse()
+pub struct BinarySegments<'a> {
+    pub device_id: &'a str,
+    records: BinaryRecords<'a>,
+}
+
+enum BinaryRecords<'a> {
+    Fixed(&'a [u8]),
+    Featured(&'a [u8]),
+    Decoded(Vec<(f64, f64, i64, i16)>),
+}
+
+impl<'a> BinarySegments<'a> {
+    pub fn is_binary(data: &[u8]) -> bool {
+        data.starts_with(BINARY_MAGIC)
+    }
+
+    pub fn parse(data: &'a [u8]) -> Result<Self, Box<dyn Error>> {
+        if data.len() < BINARY_HEADER_SIZE || !Self::is_binary(data) {
+            return Err("Not a binary segment payload".into());
+        }
+        let count = data[3] as usize;
+        let records_start = BINARY_HEADER_SIZE + data[4] as usize;
+        if data.len() < records_start {
+            return Err("Binary segment payload length does not match its header".into());
+        }
+        let records = match data[2] {
+            BINARY_FIXED => {
+                if data.len() != records_start + count * BINARY_RECORD_SIZE {
+                    return Err("Binary segment payload length does not match its header".into());
+                }
+                BinaryRecords::Fixed(&data[records_start..])
+            }
+            BINARY_FEATURES => {
+                let record_size = BINARY_RECORD_SIZE + BINARY_FEATURE_SIZE;
+                if data.len() != records_start + count * record_size {
+                    return Err("Binary segment payload length does not match its header".into());
+                }
+                BinaryRecords::Featured(&data[records_start..])
+            }
+            BINARY_DELTA => BinaryRecords::Decoded(decode_deltas(&data[records_start..], count)?),
+            BINARY_DELTA_LZ => {
+                let limit = BINARY_RECORD_SIZE + count.saturating_sub(1) * BINARY_DELTA_MAX;
+                let records = lzss_decompress(&data[records_start..], limit)?;
+                BinaryRecords::Decoded(decode_deltas(&records, count)?)
+            }
+            version => {
+                return Err(
+                    format!("Unsupported binary segment payload version {}", version).into(),
+                )
+            }
+        };
+        Ok(BinarySegments {
+            device_id: std::str::from_utf8(&data[BINARY_HEADER_SIZE..records_start])?,
+            records,
+        })
+    }
+
+    // (lat, lon, timestamp, bumpiness) per record
+    pub fn iter(&self) -> Box<dyn Iterator<Item = (f64, f64, i64, i16)> + '_> {
+        match &self.records {
+            BinaryRecords::Fixed(records) => {
+                Box::new(records.chunks_exact(BINARY_RECORD_SIZE).map(fixed_record))
+            }
+            BinaryRecords::Featured(records) => Box::new(
+                records
+                    .chunks_exact(BINARY_RECORD_SIZE + BINARY_FEATURE_SIZE)
+                    .map(fixed_record),
+            ),
+            BinaryRecords::Decoded(segments) => Box::new(segments.iter().copied()),
+        }
+    }
+
+    // Whether the payload carries features (version 4)
+    pub fn has_features(&self) -> bool {
+        matches!(self.records, BinaryRecords::Featured(_))
+    }
+
+    // Features per record, in the order of iter(); none without has_features()
+    pub fn features(&self) -> Box<dyn Iterator<Item = SegmentFeatures> + '_> {
+        match &self.records {
+            BinaryRecords::Featured(records) => Box::new(
+                records
+                    .chunks_exact(BINARY_RECORD_SIZE + BINARY_FEATURE_SIZE)
+                    .map(|record| SegmentFeatures::from_le_bytes(&record[BINARY_RECORD_SIZE..])),
+            ),
+            _ => Box::new(std::iter::empty()),
+        }
+    }
+}
+
+// A version 1 record, or the start of a version 4 one
+fn fixed_record(record: &[u8]) -> (f64, f64, i64, i16) {
+    let field = |offset: usize| <[u8; 4]>::try_from(&record[offset..offset + 4]).unwrap();
+    (
+        i32::from_le_bytes(field(0)) as f64 / BINARY_SCALE,
+        i32::from_le_bytes(field(4)) as f64 / BINARY_SCALE,
+        u32::from_le_bytes(field(8)) as i64,
+        record[12] as i16,
+    )
+}
+
+// Version 2 records: an absolute first record, then zig-zag varint differences
+fn decode_deltas(
+    records: &[u8],
+    count: usize,
+) -> Result<Vec<(f64, f64, i64, i16)>, Box<dyn Error>> {
+    if count == 0 || records.len() < BINARY_RECORD_SIZE {
+        return Err(truncated_records());
+    }
+    let field = |offset: usize| <[u8; 4]>::try_from(&records[offset..offset + 4]).unwrap();
+    let mut latitude = i32::from_le_bytes(field(0)) as i64;
+    let mut longitude = i32::from_le_bytes(field(4)) as i64;
+    let mut timestamp = u32::from_le_bytes(field(8)) as i64;
+    let mut segments = Vec::with_capacity(count);
+    segments.push((
+        latitude as f64 / BINARY_SCALE,
+        longitude as f64 / BINARY_SCALE,
+        timestamp,
+        records[12] as i16,
+    ));
+
+    let mut position = BINARY_RECORD_SIZE;
+    for _ in 1..count {
+        latitude = latitude.wrapping_add(read_zigzag_varint(records, &mut position)?);
+        longitude = longitude.wrapping_add(read_zigzag_varint(records, &mut position)?);
+        timestamp = timestamp.wrapping_add(read_zigzag_varint(records, &mut position)?);
+        let bumpiness = *records.get(position).ok_or_else(truncated_records)?;
+        position += 1;
+        segments.push((
+            latitude as f64 / BINARY_SCALE,
+            longitude as f64 / BINARY_SCALE,
+            timestamp,
+            bumpiness as i16,
+        ));
+    }
+    if position != records.len() {
+        return Err("Binary segment payload length does not match its header".into());
+    }
+    Ok(segments)
+}
+
+fn truncated_records() -> Box<dyn Error> {
+    "Binary segment payload records are truncated".into()
+}
+
+fn too_long_records() -> Box<dyn Error> {
+    "Binary segment payload records are longer than its header allows".into()
+}
+
+// LEB128 of (d << 1) ^ (d >> 63) at position, which is moved past it
+fn read_zigzag_varint(records: &[u8], position: &mut usize) -> Result<i64, Box<dyn Error>> {
+    let mut zigzag: u64 = 0;
+    for shift in (0..64).step_by(7) {
+        let byte = *records.get(*position).ok_or_else(truncated_records)?;
+        *position += 1;
+        zigzag |= ((byte & 0x7F) as u64) << shift;
+        if byte & 0x80 == 0 {
+            return Ok((zigzag >> 1) as i64 ^ -((zigzag & 1) as i64));
+        }
+    }
+    Err("Binary segment payload varint is too long".into())
+}
+
+// LZSS bit stream, most significant bit first: 1 and a literal byte, or 0, offset - 1 and
+// length - LZSS_MIN_MATCH of a copy from the output; fewer than 9 bits left are padding.
+// Fails rather than produce more than limit bytes.
+fn lzss_decompress(data: &[u8], limit: usize) -> Result<Vec<u8>, Box<dyn Error>> {
+    let mut position = 0;
+    let mut read = |count: u32| {
+        let mut value = 0usize;
+        for _ in 0..count {
+            value = (value << 1) | ((data[position / 8] >> (7 - position % 8)) & 1) as usize;
+            position += 1;
+        }
+        value
+    };
+    let mut out = Vec::with_capacity(limit.min(data.len() * 2));
+    let mut remaining = data.len() * 8;
+    while remaining >= 9 {
+        if out.len() >= limit {
+            return Err(too_long_records());
+        }
+        if read(1) == 1 {
+            out.push(read(8) as u8);
+            remaining -= 9;
+            continue;
+        }
+        if remaining < 1 + (LZSS_OFFSET_BITS + LZSS_LENGTH_BITS) as usize {
+            return Err("Binary segment payload compressed data is truncated".into());
+        }
+        let offset = read(LZSS_OFFSET_BITS) + 1;
+        let length = read(LZSS_LENGTH_BITS) + LZSS_MIN_MATCH;
+        remaining -= 1 + (LZSS_OFFSET_BITS + LZSS_LENGTH_BITS) as usize;
+        if offset > out.len() {
+            return Err("Binary segment payload compressed data refers before its start".into());
+        }
+        if out.len() + length > limit {
+            return Err(too_long_records());
+        }
+        for _ in 0..length {
+            out.push(out[out.len() - offset]);
+        }
+    }
+    Ok(out)
+}
+
 impl QueueMessage {
     pub fn new(message: Delivery) -> Self {
         // load expected content type from env
@@ -31,11 +326,11 @@ impl QueueMessage {
 }
 
 pub trait MessageParser {
-    fn parse_message(&self) -> Result<JsonMessage, Box<dyn Error>>;
+    fn parse_message(&self) -> Result<Vec<JsonMessage>, Box<dyn Error>>;
 }
 
 impl MessageParser for QueueMessage {
-    fn parse_message(&self) -> Result<JsonMessage, Box<dyn Error>> {
+    fn parse_message(&self) -> Result<Vec<JsonMessage>, Box<dyn Error>> {
         // extract content type from message
         let content_type = self.msg.properties.content_type();
         print!("{}", self.expected_content_type);
@@ -66,13 +361,279 @@ impl MessageParser for QueueMessage {
         if !status {
             Err("Unsupported content type".into())
         } else {
-            // extract body from message and parse it to JsonMessage
+            // binary payloads are decoded in place
+            if BinarySegments::is_binary(&self.msg.data) {
+                let segments = BinarySegments::parse(&self.msg.data)?;
+
+                // The device publishes features on their own topic, next to the segments; they
+                // have no table yet, so they are logged and yield no new segments
+                if segments.has_features() {
+                    for ((lat, lon, timestamp, _), features) in
+                        segments.iter().zip(segments.features())
+                    {
+                        debug!(
+                            "Features of {} at {}, {} ({}): {:?}",
+                            segments.device_id, lat, lon, timestamp, features
+                        );
+                    }
+                    return Ok(Vec::new());
+                }
+                return Ok(segments
+                    .iter()
+                    .map(|(lat, lon, timestamp, bumpiness)| JsonMessage {
+                        lat,
+                        lon,
+                        timestamp,
+                        device_id: segments.device_id.to_string(),
+                        bumpiness,
+                    })
+                    .collect());
+            }
+
+            // otherwise extract body from message and parse it to JsonMessages (one, or a batch)
             let body = std::str::from_utf8(&self.msg.data).unwrap();
             println!("{}", body);
             let sanitized = body.replace("\\", "").replace("\n", "");
             println!("{}", sanitized);
-            let parsed: JsonMessage = serde_json::from_str(sanitized.as_str())?;
-            Ok(parsed)
+            let parsed: JsonPayload = serde_json::from_str(sanitized.as_str())?;
+            Ok(parsed.into_messages())
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // Payloads written by the device encoders (roadsense-embedded/lib/SegmentPayload.h) for
+    // device "rs1" and RECORDS: encodeSegmentPayload() and encodeSegmentDeltaPayload()
+    const FIXED_PAYLOAD: [u8; 60] = [
+        0x52, 0x53, 0x01, 0x04, 0x03, 0x72, 0x73, 0x31, 0xA8, 0x63, 0x6D, 0x1B, 0x4C, 0xC8, 0x57,
+        0x05, 0xD9, 0x83, 0x4D, 0x67, 0x1B, 0xC0, 0x63, 0x6D, 0x1B, 0x5F, 0xC8, 0x57, 0x05, 0xD9,
+        0x83, 0x4D, 0x67, 0x1E, 0x0D, 0x64, 0x6D, 0x1B, 0x9F, 0xC8, 0x57, 0x05, 0xDA, 0x83, 0x4D,
+        0x67, 0x5C, 0x65, 0x63, 0x6D, 0x1B, 0x3B, 0xCD, 0x57, 0x05, 0xDB, 0x83, 0x4D, 0x67, 0x05,
+    ];
+    const DELTA_PAYLOAD: [u8; 37] = [
+        0x52, 0x53, 0x02, 0x04, 0x03, 0x72, 0x73, 0x31, 0xA8, 0x63, 0x6D, 0x1B, 0x4C, 0xC8, 0x57,
+        0x05, 0xD9, 0x83, 0x4D, 0x67, 0x1B, 0x30, 0x26, 0x00, 0x1E, 0x9A, 0x01, 0x80, 0x01, 0x02,
+        0x5C, 0xCF, 0x02, 0xB8, 0x12, 0x02, 0x05,
+    ];
+    // compressSegmentPayload() of the encodeSegmentDeltaPayload() of RUN: 16 literals (the anchor
+    // and the first delta record), copies of 17, 17 and 7 bytes from 4 back, then one padding bit
+    const COMPRESSED_PAYLOAD: [u8; 31] = [
+        0x52, 0x53, 0x03, 0x0C, 0x03, 0x72, 0x73, 0x31, 0xF8, 0x55, 0x2D, 0xB1, 0xB9, 0x86, 0x96,
+        0xAF, 0x05, 0xFA, 0x60, 0xE9, 0xB6, 0x79, 0x44, 0x12, 0x0D, 0x02, 0x01, 0xF8, 0x0F, 0xC0,
+        0x6A,
+    ];
+    // encodeSegmentFeaturePayload() of the first two RECORDS with FEATURES
+    const FEATURE_PAYLOAD: [u8; 86] = [
+        0x52, 0x53, 0x04, 0x02, 0x03, 0x72, 0x73, 0x31, 0xA8, 0x63, 0x6D, 0x1B, 0x4C, 0xC8, 0x57,
+        0x05, 0xD9, 0x83, 0x4D, 0x67, 0x1B, 0x2C, 0x03, 0x3A, 0x11, 0x33, 0x04, 0x0A, 0x05, 0x0E,
+        0x00, 0x03, 0x00, 0x00, 0x00, 0x64, 0x00, 0x78, 0x00, 0x54, 0x01, 0x5F, 0x00, 0x14, 0x00,
+        0x03, 0x00, 0xC0, 0x63, 0x6D, 0x1B, 0x5F, 0xC8, 0x57, 0x05, 0xDA, 0x83, 0x4D, 0x67, 0x1E,
+        0x72, 0x06, 0x48, 0x26, 0x1E, 0x05, 0x00, 0x08, 0x25, 0x00, 0x0C, 0x00, 0x02, 0x00, 0x62,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    ];
+    // The second segment without spectrum
+    const FEATURES: [SegmentFeatures; 2] = [
+        SegmentFeatures {
+            rms: 812,
+            peak_to_peak: 4410,
+            crest_factor: 1075,
+            kurtosis: 1290,
+            exceedances: [14, 3, 0],
+            samples: 100,
+            bands: [120, 340, 95, 20],
+            frames: 3,
+        },
+        SegmentFeatures {
+            rms: 1650,
+            peak_to_peak: 9800,
+            crest_factor: 1310,
+            kurtosis: 2048,
+            exceedances: [37, 12, 2],
+            samples: 98,
+            bands: [0; 4],
+            frames: 0,
+        },
+    ];
+    // Small steps, a step back in latitude and a long one in longitude (two byte varints)
+    const RECORDS: [(f64, f64, i64, i16); 4] = [
+        (46.0153768, 8.9638988, 1733133273, 27),
+        (46.0153792, 8.9639007, 1733133273, 30),
+        (46.0153869, 8.9639071, 1733133274, 92),
+        (46.0153701, 8.9640251, 1733133275, 5),
+    ];
+
+    // A straight run: every delta record is the same 4 bytes
+    fn run() -> Vec<(f64, f64, i64, i16)> {
+        (0..12)
+            .map(|i| {
+                (
+                    46.0150000 + i as f64 * 2e-7,
+                    8.9630000 + i as f64 * 3e-7,
+                    1733133300 + i as i64,
+                    40,
+                )
+            })
+            .collect()
+    }
+
+    fn assert_records(segments: &BinarySegments, expected: &[(f64, f64, i64, i16)]) {
+        let records: Vec<_> = segments.iter().collect();
+        assert_eq!(records.len(), expected.len());
+        for (record, expected) in records.iter().zip(expected) {
+            assert!(
+                (record.0 - expected.0).abs() < 1e-9,
+                "{:?} != {:?}",
+                record,
+                expected
+            );
+            assert!(
+                (record.1 - expected.1).abs() < 1e-9,
+                "{:?} != {:?}",
+                record,
+                expected
+            );
+            assert_eq!((record.2, record.3), (expected.2, expected.3));
         }
     }
+
+    fn parse_error(data: &[u8]) -> String {
+        BinarySegments::parse(data)
+            .err()
+            .expect("payload should be rejected")
+            .to_string()
+    }
+
+    #[test]
+    fn parses_fixed_records() {
+        let segments = BinarySegments::parse(&FIXED_PAYLOAD).unwrap();
+        assert_eq!(segments.device_id, "rs1");
+        assert_records(&segments, &RECORDS);
+    }
+
+    #[test]
+    fn parses_delta_records() {
+        let segments = BinarySegments::parse(&DELTA_PAYLOAD).unwrap();
+        assert_eq!(segments.device_id, "rs1");
+        assert_records(&segments, &RECORDS);
+    }
+
+    #[test]
+    fn parses_features() {
+        let segments = BinarySegments::parse(&FEATURE_PAYLOAD).unwrap();
+        assert_eq!(segments.device_id, "rs1");
+        assert!(segments.has_features());
+        let mut records = RECORDS[..2].to_vec();
+        records[1].2 += 1;
+        assert_records(&segments, &records);
+        assert_eq!(segments.features().collect::<Vec<_>>(), FEATURES);
+
+        assert!(!BinarySegments::parse(&FIXED_PAYLOAD)
+            .unwrap()
+            .has_features());
+        assert_eq!(
+            BinarySegments::parse(&DELTA_PAYLOAD)
+                .unwrap()
+                .features()
+                .count(),
+            0
+        );
+        assert!(parse_error(&FEATURE_PAYLOAD[..85]).contains("does not match its header"));
+        let mut payload = FEATURE_PAYLOAD;
+        payload[3] = 1;
+        assert!(parse_error(&payload).contains("does not match its header"));
+    }
+
+    #[test]
+    fn parses_compressed_records() {
+        let segments = BinarySegments::parse(&COMPRESSED_PAYLOAD).unwrap();
+        assert_eq!(segments.device_id, "rs1");
+        assert_records(&segments, &run());
+    }
+
+    #[test]
+    fn decompresses_overlapping_copies() {
+        // 'a', 'b', then 6 bytes from 2 back (offset 2 < length 6), then one padding bit
+        let data = [0xB0, 0xD8, 0x80, 0x28];
+        assert_eq!(lzss_decompress(&data, 8).unwrap(), b"abababab");
+        let error = lzss_decompress(&data, 7).err().unwrap().to_string();
+        assert!(error.contains("longer than its header allows"));
+    }
+
+    #[test]
+    fn limits_decompressed_size() {
+        // The records of 12 segments are at most 13 + 11 * 16 bytes; claiming 2 must fail
+        let mut payload = COMPRESSED_PAYLOAD;
+        payload[3] = 2;
+        assert!(parse_error(&payload).contains("longer than its header allows"));
+
+        // Eight literal zeros, then copies of 17 bytes from 1 back, 17 bytes per 13 bits
+        let mut data = vec![0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00];
+        let copies = [
+            0x00, 0x78, 0x03, 0xC0, 0x1E, 0x00, 0xF0, 0x07, 0x80, 0x3C, 0x01, 0xE0, 0x0F,
+        ];
+        for _ in 0..40 {
+            data.extend_from_slice(&copies);
+        }
+        assert_eq!(
+            lzss_decompress(&data, usize::MAX).unwrap().len(),
+            8 + 320 * 17
+        );
+        let limit = BINARY_RECORD_SIZE + 254 * BINARY_DELTA_MAX;
+        assert!(lzss_decompress(&data, limit).is_err());
+    }
+
+    #[test]
+    fn rejects_truncated_payloads() {
+        assert!(parse_error(&FIXED_PAYLOAD[..4]).contains("Not a binary"));
+        assert!(parse_error(&FIXED_PAYLOAD[..6]).contains("does not match its header"));
+        assert!(parse_error(&FIXED_PAYLOAD[..59]).contains("does not match its header"));
+        assert!(parse_error(&DELTA_PAYLOAD[..36]).contains("truncated"));
+        // Inside the anchor and inside a varint
+        assert!(parse_error(&DELTA_PAYLOAD[..15]).contains("truncated"));
+        assert!(parse_error(&DELTA_PAYLOAD[..26]).contains("truncated"));
+        assert!(parse_error(&COMPRESSED_PAYLOAD[..30]).contains("truncated"));
+    }
+
+    #[test]
+    fn rejects_count_mismatch() {
+        for count in [3, 5] {
+            let mut fixed = FIXED_PAYLOAD;
+            fixed[3] = count;
+            assert!(parse_error(&fixed).contains("does not match its header"));
+        }
+        let mut delta = DELTA_PAYLOAD;
+        delta[3] = 3;
+        assert!(parse_error(&delta).contains("does not match its header"));
+        delta[3] = 5;
+        assert!(parse_error(&delta).contains("truncated"));
+        delta[3] = 0;
+        assert!(parse_error(&delta).contains("truncated"));
+    }
+
+    #[test]
+    fn rejects_unknown_version() {
+        let mut payload = DELTA_PAYLOAD;
+        payload[2] = 5;
+        assert!(parse_error(&payload).contains("Unsupported binary segment payload version 5"));
+        payload[2] = 0;
+        assert!(parse_error(&payload).contains("version 0"));
+    }
+
+    #[test]
+    fn reads_zigzag_varints() {
+        let data = [0x00, 0x01, 0x02, 0x9A, 0x01, 0xFE, 0xFF, 0xFF, 0xFF, 0x0F];
+        let mut position = 0;
+        let mut values = Vec::new();
+        while position < data.len() {
+            values.push(read_zigzag_varint(&data, &mut position).unwrap());
+        }
+        assert_eq!(values, [0, -1, 1, 77, i32::MAX as i64]);
+
+        let too_long = [0x80; 10];
+        assert!(read_zigzag_varint(&too_long, &mut 0).is_err());
+        assert!(read_zigzag_varint(&[0x80], &mut 0).is_err());
+    }
 }
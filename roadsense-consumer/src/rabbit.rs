@@ -74,16 +74,17 @@ impl Rabbit {
             delivery.ack(BasicAckOptions::default()).await?;
 
             // We wrap the delivered message into a QueueMessage struct
-            let msg = QueueMessage::new(delivery).parse_message();
-            if let Err(err) = msg {
+            let msgs = QueueMessage::new(delivery).parse_message();
+            if let Err(err) = msgs {
                 error!("Failed to parse message: {:?}", err);
                 continue;
             }
-            let msg = Arc::new(msg.unwrap());
 
-            // Pass the message to the sender
-            if sender.send(msg).await.is_err() {
-                error!("Failed to send message to sender");
+            // Pass the segments of the message (one, or a batch) to the sender
+            for msg in msgs.unwrap() {
+                if sender.send(Arc::new(msg)).await.is_err() {
+                    error!("Failed to send message to sender");
+                }
             }
         }
 
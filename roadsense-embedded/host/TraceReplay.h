@@ -0,0 +1,215 @@
+// Recorded drive traces and their replay through the host shim.
+//
+// Trace format (text, one record per line, records sorted by time):
+//
+//   # roadsense-trace v1             header / comments start with '#'
+//   A <t_us> <z>                     MPU6050 Z acceleration, raw (+-2g: 16384 = 1 g)
+//   G <t_us> <sentence>              NMEA sentence as received, without CR LF
+//   U <t_us> <hex>                   UBX frame as received (sync to checksum), in hex
+//
+// <t_us> is microseconds since the start of the recording. Traces are
+// written by test/record_trace (real drives) and by host/tracegen.
+//
+// TraceReplay stands in for both sensors: it is the shim::ImuSource read by
+// the MPU6050 emulation and it feeds the sentences into Serial1 (the GPS
+// UART) at the recorded times, spread out at the receiver's baud rate. The
+// firmware therefore runs its real MPU6050 and GPS parser code paths on the
+// recorded data, on the virtual clock, as fast as the host allows.
+#pragma once
+
+#include <Arduino.h>
+#include <MPU6050.h>
+#include <ctype.h>
+#include <deque>
+#include <string>
+
+namespace trace {
+
+struct Record {
+  char type = 0;      // 'A', 'G' or 'U'
+  uint64_t time = 0;  // [us]
+  int16_t z = 0;      // 'A' records
+  std::string sentence; // 'G' records
+  std::string frame;    // 'U' records (raw bytes)
+};
+
+class TraceReader {
+public:
+  ~TraceReader() { close(); }
+
+  bool open(const char* path) {
+    close();
+    file = fopen(path, "r");
+    return file != nullptr;
+  }
+  void close() {
+    if (file) fclose(file);
+    file = nullptr;
+  }
+
+  // Reads the next record (returns false at end of file)
+  bool next(Record& record) {
+    char line[512];
+    while (file && fgets(line, sizeof(line), file)) {
+      lineNumber++;
+      if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+
+      char* end = nullptr;
+      record.type = line[0];
+      record.time = strtoull(line + 1, &end, 10);
+      if (end == line + 1) return malformed();
+
+      if (record.type == 'A') {
+        record.z = (int16_t)strtol(end, nullptr, 10);
+        return true;
+      }
+      if (record.type == 'G') {
+        while (*end == ' ') end++;
+        size_t length = strcspn(end, "\r\n");
+        record.sentence.assign(end, length);
+        return true;
+      }
+      if (record.type == 'U') {
+        while (*end == ' ') end++;
+        record.frame.clear();
+        for (; isxdigit((unsigned char)end[0]) && isxdigit((unsigned char)end[1]); end += 2) {
+          char hex[3] = {end[0], end[1], '\0'};
+          record.frame.push_back((char)strtoul(hex, nullptr, 16));
+        }
+        if (record.frame.empty() || (*end != '\0' && *end != '\r' && *end != '\n')) return malformed();
+        return true;
+      }
+      return malformed();
+    }
+    return false;
+  }
+
+  unsigned long line() const { return lineNumber; }
+
+private:
+  FILE* file = nullptr;
+  unsigned long lineNumber = 0;
+
+  bool malformed() {
+    fprintf(stderr, "trace: malformed record on line %lu\n", lineNumber);
+    close();
+    return false;
+  }
+};
+
+class TraceWriter {
+public:
+  explicit TraceWriter(FILE* out) : out(out) { fputs("# roadsense-trace v1\n", out); }
+  void accel(uint64_t time, int16_t z) { fprintf(out, "A %llu %d\n", (unsigned long long)time, z); }
+  void sentence(uint64_t time, const char* nmea) { fprintf(out, "G %llu %s\n", (unsigned long long)time, nmea); }
+  void frame(uint64_t time, const std::string& ubx) {
+    fprintf(out, "U %llu ", (unsigned long long)time);
+    for (char c : ubx) fprintf(out, "%02X", (uint8_t)c);
+    fputc('\n', out);
+  }
+
+private:
+  FILE* out;
+};
+
+class TraceReplay : public shim::ImuSource {
+public:
+  explicit TraceReplay(unsigned long gpsBaud = 9600) : gpsBaud(gpsBaud) {}
+
+  bool open(const char* path) {
+    if (!reader.open(path)) return false;
+    havePending = reader.next(pending);
+    return havePending;
+  }
+
+  // Installs the replay as IMU source and GPS UART feed, and moves the
+  // virtual clock to the start of the recording
+  void attach() {
+    shim::imuSource = this;
+    shim::uart1.clear();
+    shim::uart1.refill = [this](uint64_t now) { pump(now); };
+    shim::virtualClock.reset(havePending ? pending.time : 0);
+  }
+
+  // Consumes every record up to time `now`
+  void pump(uint64_t now) {
+    while (havePending && pending.time <= now) {
+      if (pending.type == 'A') {
+        imuHistory.push_back({pending.time, pending.z});
+        if (imuHistory.size() > maxHistory) imuHistory.pop_front();
+        imuSamples++;
+      } else if (pending.type == 'G') {
+        feedBytes(pending.time, pending.sentence + "\r\n");
+        sentences++;
+      } else {
+        feedBytes(pending.time, pending.frame);
+        frames++;
+      }
+      lastTime = pending.time;
+      havePending = reader.next(pending);
+    }
+  }
+
+  // Sample-and-hold of the recorded Z acceleration
+  int16_t accelZ(uint64_t timeMicros) override {
+    pump(timeMicros);
+    while (imuHistory.size() > 1 && imuHistory[1].time <= timeMicros) imuHistory.pop_front();
+    return imuHistory.empty() ? 16384 : imuHistory.front().z;
+  }
+
+  // True once every record has been consumed
+  bool finished() const { return !havePending; }
+  uint64_t lastRecordTime() const { return lastTime; }
+
+  unsigned long imuSamples = 0;
+  unsigned long sentences = 0;
+  unsigned long frames = 0;
+
+private:
+  struct Sample {
+    uint64_t time;
+    int16_t z;
+  };
+  static constexpr size_t maxHistory = 4096;
+
+  TraceReader reader;
+  Record pending;
+  bool havePending = false;
+  uint64_t lastTime = 0;
+  unsigned long gpsBaud;
+  std::deque<Sample> imuHistory;
+
+  // Bytes of a sentence or frame arrive one UART frame (10 bits) apart
+  void feedBytes(uint64_t time, const std::string& bytes) {
+    const uint64_t byteMicros = 10000000ULL / gpsBaud;
+    uint64_t t = time;
+    for (char c : bytes) {
+      uint8_t byte = (uint8_t)c;
+      shim::uart1.feed(t, &byte, 1);
+      t += byteMicros;
+    }
+  }
+};
+
+// NMEA checksum over the characters between '$' and '*'
+inline uint8_t nmeaChecksum(const char* body) {
+  uint8_t checksum = 0;
+  while (*body) checksum ^= (uint8_t)*body++;
+  return checksum;
+}
+
+// UBX frame (sync characters, header, payload, Fletcher checksum)
+inline std::string ubxFrame(uint8_t messageClass, uint8_t messageId, const void* payload, uint16_t size) {
+  std::string frame = {(char)0xB5, (char)0x62, (char)messageClass, (char)messageId, (char)(size & 0xFF), (char)(size >> 8)};
+  frame.append((const char*)payload, size);
+  uint8_t a = 0, b = 0;
+  for (size_t i = 2; i < frame.size(); i++) {
+    a += (uint8_t)frame[i];
+    b += a;
+  }
+  frame.push_back((char)a);
+  frame.push_back((char)b);
+  return frame;
+}
+
+} // namespace trace
@@ -0,0 +1,51 @@
+// Host micro-benchmarks of the firmware hot paths (see lib/HotPathBench.h).
+// Reports ns/op and heap allocations/op; every heap call (malloc(),
+// calloc(), realloc(), operator new) is counted, see shim/HeapHooks.h.
+//
+// Usage: bench
+
+#include <Arduino.h>
+#include <mbed.h>
+#include <HeapHooks.h>
+#include "../lib/HotPathBench.h"
+
+// Print to stdout regardless of the console echo setting
+class StdoutPrint : public Print {
+public:
+  size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+};
+
+int main() {
+  StdoutPrint out;
+  RabbitMQClient client;
+  PipelineCosts costs = runHotPathBenchmarks(out, client);
+
+  // Host only: the full publish path through the shim MQTT client
+  client.connectWiFi();
+  client.connect();
+  printBenchResult(out, bench("publishSegmentQuality", BENCH_ITERATIONS / 10, [&client](uint32_t i) {
+    SegmentQuality segment = {46.012015 + i * 9e-6, 8.961104, (uint8_t)i};
+    benchKeep(client.publishSegmentQuality(TOPIC, segment, 1733133227 + i));
+  }));
+  SegmentQuality batch[SEGMENT_BATCH_SIZE];
+  time_t batchTimes[SEGMENT_BATCH_SIZE];
+  for (uint32_t k = 0; k < SEGMENT_BATCH_SIZE; k++) {
+    batch[k] = {46.012015 + k * 9e-6, 8.961104, (uint8_t)k};
+    batchTimes[k] = 1733133227 + k;
+  }
+  printBenchResult(out, bench("publishSegmentBatchJson (24)", BENCH_ITERATIONS / 100, [&](uint32_t) {
+    benchKeep(client.publishSegmentBatchJson(TOPIC, batch, batchTimes, SEGMENT_BATCH_SIZE));
+  }));
+  printBenchResult(out, bench("publishSegmentBatchBinary (24)", BENCH_ITERATIONS / 10, [&](uint32_t) {
+    benchKeep(client.publishSegmentBatchBinary(TOPIC, batch, batchTimes, SEGMENT_BATCH_SIZE));
+  }));
+  // As the publisher thread calls it: connect() (a no-op when connected), then publish
+  printBenchResult(out, bench("sendBatchCallback (24)", BENCH_ITERATIONS / 10, [&](uint32_t) {
+    benchKeep(client.sendBatchCallback(batch, batchTimes, SEGMENT_BATCH_SIZE));
+  }));
+
+  out.println();
+  printCpuBudget(out, costs);
+  return 0;
+}
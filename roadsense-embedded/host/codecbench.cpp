@@ -0,0 +1,214 @@
+// Segment payload codecs on replayed drives (see lib/SegmentPayload.h).
+//
+// Reads the segment CSV files written by replay, cuts each drive into
+// batches of SEGMENT_BATCH_SIZE segments as the publisher does, and encodes
+// every batch as JSON, as fixed 13 byte records (version 1), as zig-zag
+// varint deltas (version 2) and as deltas with the LZSS pass (version 3).
+// Reports the bytes per segment, the size against version 1 and JSON, and
+// the encode time per batch on this machine. The version 2 and 3 payloads
+// are decoded again and must give back every segment (positions rounded
+// to 1e-7 degrees).
+//
+// Usage: codecbench [--repeat N] <segments.csv>...
+
+#include <Arduino.h>
+#include <vector>
+#include "../lib/Bench.h" // benchKeep()
+#include "../lib/RabbitMQClient.h"
+#include "../lib/SegmentPayload.h"
+
+struct Drive {
+  const char* path;
+  std::vector<SegmentQuality> segments;
+  std::vector<time_t> timestamps;
+};
+
+struct CodecResult {
+  uint64_t bytes = 0;
+  uint64_t messages = 0;
+  double seconds = 0.0; // Encoding all batches once
+};
+
+static double wallSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool readDrive(Drive& drive) {
+  FILE* in = fopen(drive.path, "r");
+  if (!in) {
+    perror(drive.path);
+    return false;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), in)) {
+    double latitude, longitude;
+    unsigned quality;
+    long timestamp;
+    if (sscanf(line, "%lf,%lf,%u,%ld", &latitude, &longitude, &quality, &timestamp) != 4) continue; // Header
+    drive.segments.push_back({latitude, longitude, (uint8_t)quality});
+    drive.timestamps.push_back((time_t)timestamp);
+  }
+  fclose(in);
+  return true;
+}
+
+// Host decoder of versions 2 and 3; false if the payload is not valid or
+// does not give back the count segments from first
+static bool decodeMatches(const uint8_t* payload, size_t length, const SegmentQuality* segments,
+                          const time_t* timestamps, size_t count) {
+  if (length < 5 || payload[3] != count || 5 + (size_t)payload[4] > length) return false;
+  const uint8_t* records = payload + 5 + payload[4];
+  size_t recordsLength = length - 5 - payload[4];
+  uint8_t decompressed[segmentDeltaPayloadMaxSize(0, SEGMENT_BATCH_SIZE)];
+  if (payload[2] == SEGMENT_PAYLOAD_DELTA_LZ) {
+    recordsLength = lzssDecompress(records, recordsLength, decompressed, sizeof(decompressed));
+    records = decompressed;
+  } else if (payload[2] != SEGMENT_PAYLOAD_DELTA) {
+    return false;
+  }
+
+  size_t position = 0;
+  auto varint = [&](int64_t& value) {
+    uint64_t zigzag = 0;
+    for (int shift = 0; shift < 64 && position < recordsLength; shift += 7) {
+      uint8_t byte = records[position++];
+      zigzag |= (uint64_t)(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+        return true;
+      }
+    }
+    return false;
+  };
+  int64_t latitude = 0, longitude = 0, timestamp = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (i == 0) {
+      if (recordsLength < SEGMENT_PAYLOAD_RECORD_SIZE) return false;
+      int32_t lat, lon;
+      uint32_t time;
+      memcpy(&lat, records, 4);
+      memcpy(&lon, records + 4, 4);
+      memcpy(&time, records + 8, 4);
+      latitude = lat, longitude = lon, timestamp = time;
+      position = 12;
+    } else {
+      int64_t dLatitude, dLongitude, dTimestamp;
+      if (!varint(dLatitude) || !varint(dLongitude) || !varint(dTimestamp)) return false;
+      latitude += dLatitude, longitude += dLongitude, timestamp += dTimestamp;
+    }
+    if (position >= recordsLength) return false;
+    uint8_t quality = records[position++];
+    if (latitude != lround(segments[i].latitude * SEGMENT_PAYLOAD_SCALE) ||
+        longitude != lround(segments[i].longitude * SEGMENT_PAYLOAD_SCALE) ||
+        timestamp != (int64_t)(uint32_t)timestamps[i] || quality != segments[i].quality) {
+      return false;
+    }
+  }
+  return position == recordsLength;
+}
+
+int main(int argc, char** argv) {
+  unsigned long repeat = 20;
+  std::vector<Drive> drives;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = strtoul(argv[++i], nullptr, 10);
+    } else if (argv[i][0] != '-') {
+      drives.push_back({argv[i], {}, {}});
+    } else {
+      drives.clear();
+      break;
+    }
+  }
+  if (drives.empty() || repeat == 0) {
+    fprintf(stderr, "usage: %s [--repeat N] <segments.csv>...\n", argv[0]);
+    return 2;
+  }
+
+  static RabbitMQClient client;
+  static const char* names[] = {"JSON", "fixed (v1)", "delta (v2)", "delta+LZ (v3)"};
+  const size_t codecs = sizeof(names) / sizeof(names[0]);
+  static char json[MQTT_BUFFER_SIZE];
+  static uint8_t payload[MQTT_BUFFER_SIZE];
+  static uint8_t delta[segmentDeltaPayloadMaxSize(sizeof(DEVICE_ID) - 1, SEGMENT_BATCH_SIZE)];
+
+  // Encodes one batch with codec; returns the payload size (0 on failure)
+  auto encode = [&](size_t codec, const SegmentQuality* segments, const time_t* timestamps, size_t count) -> size_t {
+    switch (codec) {
+      case 0:
+        return client.buildSegmentBatchPayload(json, sizeof(json), segments, timestamps, count);
+      case 1:
+        return encodeSegmentPayload(payload, sizeof(payload), DEVICE_ID, segments, timestamps, count);
+      case 2:
+        return encodeSegmentDeltaPayload(payload, sizeof(payload), DEVICE_ID, segments, timestamps, count);
+      default: {
+        size_t length = encodeSegmentDeltaPayload(delta, sizeof(delta), DEVICE_ID, segments, timestamps, count);
+        return compressSegmentPayload(delta, length, payload, sizeof(payload));
+      }
+    }
+  };
+
+  // One table row per drive and codec, then the totals
+  auto print = [&](const char* drive, uint64_t segments, const std::vector<CodecResult>& results) {
+    for (size_t codec = 0; codec < codecs; codec++) {
+      const CodecResult& result = results[codec];
+      printf("%-24s %-14s %9llu %7.2f %7.1f%% %7.1f%% %9.2f\n", codec == 0 ? drive : "", names[codec],
+             (unsigned long long)result.bytes, segments ? (double)result.bytes / segments : 0.0,
+             100.0 * result.bytes / results[1].bytes, 100.0 * result.bytes / results[0].bytes,
+             result.messages ? result.seconds * 1e6 / result.messages : 0.0);
+    }
+  };
+
+  std::vector<CodecResult> totals(codecs);
+  uint64_t totalSegments = 0;
+  unsigned long errors = 0;
+  printf("%-24s %-14s %9s %7s %8s %8s %9s\n", "drive", "codec", "bytes", "B/seg", "vs v1", "vs JSON", "us/batch");
+  for (Drive& drive : drives) {
+    if (!readDrive(drive)) return 1;
+    size_t count = drive.segments.size();
+    if (count == 0) continue;
+    totalSegments += count;
+    std::vector<CodecResult> results(codecs);
+    for (size_t codec = 0; codec < codecs; codec++) {
+      CodecResult& result = results[codec];
+      for (size_t first = 0; first < count; first += SEGMENT_BATCH_SIZE) {
+        size_t n = count - first < SEGMENT_BATCH_SIZE ? count - first : SEGMENT_BATCH_SIZE;
+        size_t length = encode(codec, &drive.segments[first], &drive.timestamps[first], n);
+        if (length == 0 ||
+            (codec >= 2 && !decodeMatches(payload, length, &drive.segments[first], &drive.timestamps[first], n))) {
+          errors++;
+        }
+        result.bytes += length;
+        result.messages++;
+      }
+      double start = wallSeconds();
+      size_t keep = 0;
+      for (unsigned long r = 0; r < repeat; r++) {
+        for (size_t first = 0; first < count; first += SEGMENT_BATCH_SIZE) {
+          size_t n = count - first < SEGMENT_BATCH_SIZE ? count - first : SEGMENT_BATCH_SIZE;
+          keep += encode(codec, &drive.segments[first], &drive.timestamps[first], n);
+        }
+      }
+      result.seconds = (wallSeconds() - start) / repeat;
+      benchKeep(keep);
+
+      totals[codec].bytes += result.bytes;
+      totals[codec].messages += result.messages;
+      totals[codec].seconds += result.seconds;
+    }
+    // File name up to the first dot, and the segment count
+    const char* name = strrchr(drive.path, '/') ? strrchr(drive.path, '/') + 1 : drive.path;
+    char label[40];
+    snprintf(label, sizeof(label), "%.*s (%zu)", (int)strcspn(name, "."), name, count);
+    print(label, count, results);
+  }
+  if (drives.size() > 1 && totalSegments > 0) {
+    char label[40];
+    snprintf(label, sizeof(label), "all (%llu)", (unsigned long long)totalSegments);
+    print(label, totalSegments, totals);
+  }
+  if (errors) printf("%lu batches did not encode or decode back to their segments\n", errors);
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,238 @@
+// Store-and-forward benchmark of the flash segment log (lib/SegmentLog.h).
+//
+// Simulates a drive of several hours on the shim virtual clock: task1
+// pushes numbered segments into the segment ring buffer at --rate per
+// second, task2 calls forwardSegments() every 100 ms (every second while
+// offline) as in the firmware, and WiFi is down for --offline minutes out
+// of every --online + --offline. With --reboots N the firmware loses power
+// N times while programming the block in RAM, at a random byte of the
+// write: the ring buffer and that block are lost, and the log is mounted
+// again from the flash.
+//
+// The broker checks that segments arrive in order, with their time, and
+// at the end, after the backlog has been published, that every segment is
+// accounted for: published, dropped by the full log, or lost at a power
+// loss, and no more of those than were in RAM (a write cut in its padding
+// still leaves a valid block). Reports the flash bytes programmed per
+// segment, the write amplification against the 11 byte records, the sector
+// erase counts (wear leveling) and the CPU time of the log on this machine.
+//
+// Usage: logbench [--hours H] [--rate N] [--online MIN] [--offline MIN] [--reboots N] [--seed N]
+
+#include <Arduino.h>
+#include <memory>
+#include <random>
+#include <vector>
+#include <FlashIAPBlockDevice.h>
+#include "../lib/FlashIAPLimits.h"
+#include "../lib/SpscRingBuffer.h"
+#include "../lib/PackedSegment.h"
+#include "../lib/SegmentLog.h"
+#include "../lib/RabbitMQClient.h" // SEGMENT_BATCH_SIZE
+
+#define SEGMENT_BUFFER_SIZE 2048
+#define BENCH_UNIX_START 1733133227 // Unix time at uptime 0
+#define BENCH_LATITUDE 460000000    // [1e-7 deg] of segment 0, 100 more per segment
+
+static double wallSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static time_t unixNow() {
+  return BENCH_UNIX_START + millis() / 1000;
+}
+
+int main(int argc, char** argv) {
+  double hours = 8.0;
+  unsigned long rate = 10;
+  unsigned long onlineMinutes = 20;
+  unsigned long offlineMinutes = 100;
+  unsigned long reboots = 0;
+  unsigned long seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--hours") && i + 1 < argc) {
+      hours = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+      rate = strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--online") && i + 1 < argc) {
+      onlineMinutes = strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--offline") && i + 1 < argc) {
+      offlineMinutes = strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--reboots") && i + 1 < argc) {
+      reboots = strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      seed = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: %s [--hours H] [--rate N] [--online MIN] [--offline MIN] [--reboots N] [--seed N]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (rate == 0 || rate > 10 * SEGMENT_BUFFER_SIZE || onlineMinutes == 0) {
+    fprintf(stderr, "--rate must be 1..%d, --online at least 1\n", 10 * SEGMENT_BUFFER_SIZE);
+    return 2;
+  }
+
+  // The log on the IAP region after the calibration sector, as in the firmware
+  auto [flashSize, startAddress, iapSize] = getFlashIAPLimits();
+  FlashIAPBlockDevice device(startAddress, iapSize);
+  device.init();
+  bd_size_t sector = device.get_erase_size();
+  uint32_t firstSector = (uint32_t)((startAddress + sector - shim::FlashMemory::start) / shim::FlashMemory::sectorSize);
+
+  std::unique_ptr<SegmentLog> log(new SegmentLog);
+  double mountSeconds = 0.0;
+  unsigned long mounts = 0;
+  auto mount = [&]() {
+    double start = wallSeconds();
+    bool ok = log->begin(&device, sector, iapSize - sector);
+    mountSeconds += wallSeconds() - start;
+    mounts++;
+    return ok;
+  };
+  if (!mount()) {
+    fprintf(stderr, "SegmentLog::begin() failed\n");
+    return 1;
+  }
+
+  SpscRingBuffer<PackedSegment, SEGMENT_BUFFER_SIZE, RingOverflow::DropOldest> ring;
+  std::vector<uint32_t> producedAt; // Uptime [ms] per segment
+  std::vector<uint8_t> seen;        // Per segment: published
+  bool online = true;
+
+  unsigned long published = 0, publishedFromLog = 0, duplicates = 0, outOfOrder = 0, timeErrors = 0;
+  uint32_t lastPublished = 0;
+  bool anyPublished = false;
+  auto timeOf = [](const PackedSegment& segment) {
+    return packedSegmentTime(segment, millis(), unixNow());
+  };
+  auto publishOne = [&](const PackedSegment& segment, time_t unixTime) {
+    uint32_t n = (uint32_t)(segment.latitude - BENCH_LATITUDE) / 100;
+    if (n >= seen.size() || segment.quality != (uint8_t)n) {
+      outOfOrder++;
+      return;
+    }
+    if (seen[n]) {
+      duplicates++; // Published again after a power loss
+    } else {
+      if (anyPublished && n < lastPublished) outOfOrder++;
+      seen[n] = 1;
+      lastPublished = n;
+      anyPublished = true;
+      published++;
+    }
+    time_t expected = BENCH_UNIX_START + producedAt[n] / 1000;
+    if (unixTime < expected - 2 || unixTime > expected + 2) timeErrors++;
+  };
+  unsigned long batches = 0;
+  auto publish = [&](const PackedSegment* segments, const time_t* unixTimes, size_t count) {
+    if (!online) return false;
+    for (size_t i = 0; i < count; i++) publishOne(segments[i], unixTimes[i]);
+    batches++;
+    return true;
+  };
+
+  uint64_t appended = 0, droppedFull = 0;
+  unsigned long inRamAtPowerLoss = 0;
+  uint32_t maxBacklog = 0;
+  double forwardSeconds = 0.0;
+  auto forward = [&]() {
+    uint32_t before = log->getStats().consumed;
+    double start = wallSeconds();
+    forwardSegments<SEGMENT_BATCH_SIZE>(*log, ring, online, timeOf, publish);
+    forwardSeconds += wallSeconds() - start;
+    publishedFromLog += log->getStats().consumed - before;
+    if (log->size() > maxBacklog) maxBacklog = log->size();
+  };
+
+  std::mt19937 random((uint32_t)seed);
+  const unsigned long steps = (unsigned long)(hours * 36000.0); // 100 ms each
+  const unsigned long cycle = (onlineMinutes + offlineMinutes) * 600;
+  unsigned long nextReboot = 1;
+  double due = 0.0;
+
+  for (unsigned long step = 0; step < steps; step++) {
+    delay(100);
+    online = step % cycle < onlineMinutes * 600;
+
+    // task1
+    for (due += rate / 10.0; due >= 1.0; due -= 1.0) {
+      uint32_t n = (uint32_t)producedAt.size();
+      unsigned long now = millis();
+      producedAt.push_back((uint32_t)now);
+      seen.push_back(0);
+      ring.push({BENCH_LATITUDE + (int32_t)n * 100, 89000000 + (int32_t)(n % 7) * 30, (uint16_t)(now >> PACKED_SEGMENT_TICK_SHIFT), (uint8_t)n});
+    }
+
+    // task2
+    if (online || step % 10 == 0) forward();
+
+    // Power loss while programming the block in RAM
+    if (nextReboot <= reboots && step == steps * nextReboot / (reboots + 1)) {
+      nextReboot++;
+      uint32_t pending = log->getPendingCount();
+      shim::flashMemory.programBudget = random() % SEGMENT_LOG_BLOCK_SIZE;
+      bool synced = log->sync();
+      shim::flashMemory.programBudget = -1;
+      PackedSegment segment;
+      while (ring.pop(segment)) inRamAtPowerLoss++;
+      if (!synced) inRamAtPowerLoss += pending;
+      appended += log->getStats().appended;
+      droppedFull += log->getStats().dropped;
+      log.reset(new SegmentLog);
+      if (!mount()) {
+        fprintf(stderr, "SegmentLog::begin() failed after power loss %lu\n", nextReboot - 1);
+        return 1;
+      }
+    }
+  }
+
+  // Back online for good: publish the backlog
+  online = true;
+  unsigned long drainSteps = 0;
+  while (!log->isEmpty() || !ring.isEmpty()) {
+    delay(100);
+    forward();
+    drainSteps++;
+  }
+  appended += log->getStats().appended;
+  droppedFull += log->getStats().dropped;
+
+  unsigned long produced = (unsigned long)producedAt.size();
+  unsigned long bufferDrops = (unsigned long)ring.getDroppedCount();
+  unsigned long missing = produced - published;
+  unsigned long lostAtPowerLoss = missing - (unsigned long)droppedFull - bufferDrops;
+  bool accounted = missing >= droppedFull + bufferDrops && lostAtPowerLoss <= inRamAtPowerLoss;
+
+  const auto& flash = shim::flashMemory.stats;
+  uint32_t minErases = UINT32_MAX, maxErases = 0;
+  uint32_t sectors = log->getSectorCount();
+  for (uint32_t s = 0; s < sectors; s++) {
+    uint32_t erases = shim::flashMemory.sectorEraseCounts[firstSector + s];
+    if (erases < minErases) minErases = erases;
+    if (erases > maxErases) maxErases = erases;
+  }
+
+  printf("drive:          %.1f h, %lu segments (%lu/s), offline %lu of every %lu min, %lu power losses\n",
+         hours, produced, rate, offlineMinutes, onlineMinutes + offlineMinutes, reboots);
+  printf("published:      %lu (%lu through the log) in %lu messages, %lu duplicates, %lu out of order, %lu wrong times\n",
+         published, publishedFromLog - duplicates, batches, duplicates, outOfOrder, timeErrors);
+  printf("lost:           %lu (log full %llu, buffer overflow %lu, power loss %ld of %lu in RAM)%s\n",
+         missing, (unsigned long long)droppedFull, bufferDrops, (long)lostAtPowerLoss, inRamAtPowerLoss,
+         accounted ? "" : " UNACCOUNTED");
+  printf("backlog:        max %lu segments, published in %.1f s once online\n",
+         (unsigned long)maxBacklog, drainSteps / 10.0);
+  printf("flash:          %llu bytes programmed, %.2f per logged segment, %llu sector erases\n",
+         (unsigned long long)flash.bytesProgrammed, appended ? (double)flash.bytesProgrammed / appended : 0.0,
+         (unsigned long long)flash.sectorErases);
+  printf("write amplification: %.2f (bytes programmed per byte of %u byte records)\n",
+         appended ? (double)flash.bytesProgrammed / (appended * sizeof(PackedSegment)) : 0.0, (unsigned)sizeof(PackedSegment));
+  printf("sector erases:  min %lu, max %lu over %lu sectors\n",
+         (unsigned long)(sectors ? minErases : 0), (unsigned long)maxErases, (unsigned long)sectors);
+  printf("CPU:            %.2f us per segment in forwardSegments(), %.2f ms per mount\n",
+         produced ? forwardSeconds * 1e6 / produced : 0.0, mounts ? mountSeconds * 1e3 / mounts : 0.0);
+
+  return accounted && outOfOrder == 0 && timeErrors == 0 ? 0 : 1;
+}
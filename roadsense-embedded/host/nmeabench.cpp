@@ -0,0 +1,140 @@
+// Benchmarks the firmware NMEA parser (lib/NmeaParser.h) next to the
+// TinyGPS++ shim (TinyGPSPlus plus the speed and antenna TinyGPSCustom
+// fields, with atof() on the speed), on the NMEA sentences of a recorded
+// drive. Reports ns per position fix and heap allocations, and
+// checks that both parsers agree on the final position, speed and time.
+// With --ubx, also times the UBX NAV-PVT backend (lib/UbxParser.h) on the
+// frames of a UBX recording.
+//
+// The TinyGPS++ row is the host stand-in in shim/, not the library: it
+// parses the same way (term strings, atof()) but its timing says nothing
+// about how fast the real TinyGPSPlus is. It is there as the reference the
+// parsers must agree with.
+//
+// Usage: nmeabench <trace> [--ubx <ubx-trace>] [--passes N]
+
+#include <Arduino.h>
+#include <HeapHooks.h>
+#include <string>
+#include <TinyGPS++.h>
+#include "../lib/Bench.h"
+#include "../lib/NmeaParser.h"
+#include "../lib/UbxParser.h"
+#include "TraceReplay.h"
+
+class StdoutPrint : public Print {
+public:
+  size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+  size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+};
+
+// GPS UART byte stream of a trace: 'G' records as NMEA lines, 'U' records
+// as raw UBX frames. Returns the number of position fixes ($--RMC sentences
+// or NAV-PVT frames).
+static unsigned long loadGpsStream(const char* path, char type, std::string& stream) {
+  trace::TraceReader reader;
+  if (!reader.open(path)) {
+    fprintf(stderr, "cannot read trace %s\n", path);
+    return 0;
+  }
+  unsigned long fixes = 0;
+  trace::Record record;
+  while (reader.next(record)) {
+    if (record.type != type) continue;
+    if (type == 'G') {
+      stream += record.sentence;
+      stream += "\r\n";
+      if (record.sentence.size() > 6 && record.sentence.compare(3, 3, "RMC") == 0) fixes++;
+    } else {
+      stream += record.frame;
+      if ((uint8_t)record.frame[2] == UBX_CLASS_NAV && (uint8_t)record.frame[3] == UBX_NAV_PVT) fixes++;
+    }
+  }
+  if (fixes == 0) fprintf(stderr, "no %s fixes in %s\n", type == 'G' ? "NMEA" : "UBX", path);
+  return fixes;
+}
+
+int main(int argc, char** argv) {
+  const char* tracePath = nullptr;
+  const char* ubxTracePath = nullptr;
+  uint32_t passes = 20;
+  bool usage = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--passes") && i + 1 < argc) passes = strtoul(argv[++i], nullptr, 10);
+    else if (!strcmp(argv[i], "--ubx") && i + 1 < argc) ubxTracePath = argv[++i];
+    else if (!tracePath && argv[i][0] != '-') tracePath = argv[i];
+    else usage = true;
+  }
+  if (usage || !tracePath || passes == 0) {
+    fprintf(stderr, "usage: %s <trace> [--ubx <ubx-trace>] [--passes N]\n", argv[0]);
+    return 2;
+  }
+
+  std::string stream, ubxStream;
+  const unsigned long fixes = loadGpsStream(tracePath, 'G', stream);
+  const unsigned long ubxFixes = ubxTracePath ? loadGpsStream(ubxTracePath, 'U', ubxStream) : 0;
+  if (fixes == 0 || (ubxTracePath && ubxFixes == 0)) return 1;
+  const char* bytes = stream.data();
+  const size_t size = stream.size();
+  printf("NMEA: %lu fixes, %zu bytes (%.0f bytes/fix)\n", fixes, size, (double)size / fixes);
+  if (ubxTracePath)
+    printf("UBX:  %lu fixes, %zu bytes (%.0f bytes/fix)\n", ubxFixes, ubxStream.size(), (double)ubxStream.size() / ubxFixes);
+  printf("%u passes, ns per fix\n\n", passes);
+
+  StdoutPrint out;
+  CycleCounter::begin();
+  printBenchHeader(out);
+
+  // Firmware parser; one op = one pass over the log
+  NmeaParser nmea;
+  BenchResult nmeaResult = bench("NmeaParser", passes, [&](uint32_t) {
+    for (size_t i = 0; i < size; i++) nmea.encode(bytes[i]);
+    benchKeep(nmea.state());
+  });
+
+  // TinyGPS++ shim with the fields RoadQualifier read from it
+  TinyGPSPlus gps;
+  TinyGPSCustom antennaStatus(gps, "GPTXT", 4);
+  TinyGPSCustom speedKmph(gps, "GNVTG", 7);
+  double speed = 0.0;
+  BenchResult tinyResult = bench("TinyGPS++ shim (not the library)", passes, [&](uint32_t) {
+    for (size_t i = 0; i < size; i++) {
+      gps.encode(bytes[i]);
+      if (speedKmph.isUpdated()) speed = atof(speedKmph.value());
+    }
+    benchKeep(speed);
+  });
+
+  // Report per fix rather than per pass
+  for (BenchResult* result : {&nmeaResult, &tinyResult}) {
+    result->iterations *= fixes;
+    printBenchResult(out, *result);
+  }
+
+  // UBX NAV-PVT backend on its own recording
+  if (ubxTracePath) {
+    UbxParser ubx;
+    const char* ubxBytes = ubxStream.data();
+    const size_t ubxSize = ubxStream.size();
+    BenchResult ubxResult = bench("UbxParser", passes, [&](uint32_t) {
+      for (size_t i = 0; i < ubxSize; i++) ubx.encode(ubxBytes[i]);
+      benchKeep(ubx.state());
+    });
+    ubxResult.iterations *= ubxFixes;
+    printBenchResult(out, ubxResult);
+    if (ubx.checksumErrors) printf("UBX checksum errors: %u\n", ubx.checksumErrors);
+  }
+
+  // Both parsers must end in the same state
+  const GpsSnapshot& state = nmea.state();
+  double latError = fabs(state.latitudeE7 * 1e-7 - gps.location.lat());
+  double lngError = fabs(state.longitudeE7 * 1e-7 - gps.location.lng());
+  double speedError = fabs(state.speedMmps * 0.0036 - speed);
+  bool timeMatches = state.hour == gps.time.hour() && state.minute == gps.time.minute() &&
+                     state.second == gps.time.second() && state.day == gps.date.day() &&
+                     state.month == gps.date.month() && state.year == gps.date.year();
+  printf("\nchecksum errors: %u\n", nmea.checksumErrors);
+  printf("difference:      lat %.1e deg, lng %.1e deg, speed %.4f km/h, time %s\n",
+         latError, lngError, speedError, timeMatches ? "equal" : "DIFFERENT");
+  return latError < 2e-7 && lngError < 2e-7 && speedError < 0.002 && timeMatches ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+// Host simulation of the RoadSense firmware pipeline.
+//
+// Runs RoadQualifier::begin() and then qualifies segments, pushing them
+// through the segment ring buffer and RabbitMQClient the way task1/task2 do on the
+// Portenta (segments the broker does not take go to the flash segment log),
+// all on the shim virtual clock. Reports segments per second and
+// CPU time per segment on this machine.
+//
+// Usage: qualify_sim [--segments N] [--publish-every N] [--verbose] [--realtime]
+
+#include <Arduino.h>
+#include <mbed.h>
+#include "../lib/SegmentQuality.h"
+#include "../lib/RabbitMQClient.h"
+#include "../lib/roadqualifier.h"
+#include "../lib/SpscRingBuffer.h"
+#include "../lib/PackedSegment.h"
+#include "../lib/SegmentLog.h"
+
+#define SEGMENT_BUFFER_SIZE 2048
+
+static double cpuSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double wallSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+RoadQualifier roadQualifier;
+RabbitMQClient rabbitMQClient;
+SpscRingBuffer<PackedSegment, SEGMENT_BUFFER_SIZE, RingOverflow::DropOldest> circular_buffer;
+SegmentLog segmentLog;
+
+int main(int argc, char** argv) {
+  unsigned long segments = 1000;
+  unsigned long publishEvery = 10;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--segments") && i + 1 < argc) {
+      segments = strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--publish-every") && i + 1 < argc) {
+      publishEvery = strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "--verbose")) {
+      shim::console.echo = true;
+    } else if (!strcmp(argv[i], "--realtime")) {
+      shim::virtualClock.setMode(shim::VirtualClock::Mode::Realtime);
+    } else {
+      fprintf(stderr, "usage: %s [--segments N] [--publish-every N] [--verbose] [--realtime]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  Serial.begin(115200);
+
+  double wallStart = wallSeconds();
+  if (!roadQualifier.begin()) {
+    fprintf(stderr, "RoadQualifier::begin() failed\n");
+    return 1;
+  }
+  printf("begin():        %.1f s virtual, %.3f s wall\n",
+         shim::virtualClock.nowMicros() / 1e6, wallSeconds() - wallStart);
+
+  // Segment log after the calibration sector, as in initSegmentLog()
+  auto [flashSize, startAddress, iapSize] = getFlashIAPLimits();
+  FlashIAPBlockDevice segmentFlash(startAddress, iapSize);
+  segmentFlash.init();
+  bd_size_t sector = segmentFlash.get_erase_size();
+  if (!segmentLog.begin(&segmentFlash, sector, iapSize - sector)) {
+    fprintf(stderr, "SegmentLog::begin() failed\n");
+    return 1;
+  }
+
+  rabbitMQClient.connectWiFi();
+  auto segmentTime = [](const PackedSegment& packedSegment) {
+    return packedSegmentTime(packedSegment, millis(), roadQualifier.getUnixTime());
+  };
+  auto publishSegments = [](const PackedSegment* packedSegments, const time_t* timestamps, size_t count) {
+    SegmentQuality segments[SEGMENT_BATCH_SIZE];
+    for (size_t i = 0; i < count; i++) segments[i] = unpackSegment(packedSegments[i]);
+    return rabbitMQClient.sendBatchCallback(segments, timestamps, count);
+  };
+
+  unsigned long valid = 0;
+  double qualifyCpu = 0.0;
+  uint64_t virtualStart = shim::virtualClock.nowMicros();
+  wallStart = wallSeconds();
+
+  for (unsigned long n = 1; n <= segments; n++) {
+    // task1: qualify and buffer
+    double cpuStart = cpuSeconds();
+    bool ok = roadQualifier.qualifySegment();
+    qualifyCpu += cpuSeconds() - cpuStart;
+    if (ok) {
+      valid++;
+      circular_buffer.push(packSegment(roadQualifier.getSegmentQuality(), millis()));
+    }
+
+    // task2: drain the buffer
+    if (n == segments || (publishEvery && n % publishEvery == 0)) {
+      forwardSegments<SEGMENT_BATCH_SIZE>(segmentLog, circular_buffer, rabbitMQClient.isConnectedWiFi(), segmentTime, publishSegments);
+    }
+  }
+
+  double wall = wallSeconds() - wallStart;
+  double virtualTime = (shim::virtualClock.nowMicros() - virtualStart) / 1e6;
+
+  printf("segments:       %lu (%lu valid, %lu invalid)\n", segments, valid, segments - valid);
+  printf("virtual time:   %.2f s (%.1f ms per segment)\n", virtualTime, segments ? virtualTime * 1e3 / segments : 0.0);
+  printf("wall time:      %.3f s (%.0fx real time)\n", wall, wall > 0 ? virtualTime / wall : 0.0);
+  printf("throughput:     %.0f segments/s\n", wall > 0 ? segments / wall : 0.0);
+  printf("CPU/segment:    %.2f us in qualifySegment()\n", segments ? qualifyCpu * 1e6 / segments : 0.0);
+  printf("published:      %llu messages, %llu payload bytes\n",
+         (unsigned long long)shim::broker.messages, (unsigned long long)shim::broker.payloadBytes);
+  printf("buffer drops:   %lu\n", (unsigned long)circular_buffer.getDroppedCount());
+  printf("segment log:    %lu appended, %lu unpublished\n",
+         (unsigned long)segmentLog.getStats().appended, (unsigned long)segmentLog.size());
+
+#ifdef PROFILE_STAGES
+  class StdoutPrint : public Print {
+  public:
+    size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+  } out;
+  printf("\n");
+  roadQualifier.printStageProfile(out);
+#endif
+  return 0;
+}
@@ -0,0 +1,163 @@
+// Re-qualifies a recorded drive (see TraceReplay.h) on the host.
+//
+// The firmware runs with the real MPU6050 and GPS parser code paths, fed by
+// the trace through the shim. Every valid segment is written as one CSV
+// line, so the output of two firmware versions can be diffed directly.
+//
+// Usage: replay <trace> [--calibration MIN:MAX] [--baud N] [--features] [-o FILE] [--verbose]
+//
+// --features appends the vibration features of each segment (see
+// lib/SegmentFeatures.h) to its line, and with RoughnessSpectrum (the
+// ROUGHNESS_SPECTRUM switch) the band values (lib/RoughnessSpectrum.h).
+//
+// Without --calibration the device calibration runs on the first 25 s of
+// the trace, exactly as after a flash erase.
+
+#include <Arduino.h>
+#include <mbed.h>
+#include "../lib/SegmentQuality.h"
+#include "../lib/roadqualifier.h"
+#include "TraceReplay.h"
+
+static double wallSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Stores calibration values in the shim flash, where begin() looks for them
+static bool storeCalibration(int32_t minValue, int32_t maxValue) {
+  auto [flashSize, startAddress, iapSize] = getFlashIAPLimits();
+  FlashIAPBlockDevice blockDevice(startAddress, iapSize);
+  if (blockDevice.init() != 0) return false;
+
+  // The calibration policy completes the range to its record
+  RoadQualifier::CalibrationRecord calData = RoadQualifier::calibrationRecord(minValue, maxValue);
+  uint8_t page[(sizeof(calData) + 31) / 32 * 32];
+  memset(page, 0xFF, sizeof(page));
+  memcpy(page, &calData, sizeof(calData));
+
+  return blockDevice.erase(0, blockDevice.get_erase_size()) == 0 &&
+         blockDevice.program(page, 0, sizeof(page)) == 0;
+}
+
+RoadQualifier roadQualifier;
+trace::TraceReplay *replay = nullptr;
+
+static unsigned long validSegments = 0, invalidSegments = 0;
+static FILE* out = stdout;
+static double wallStart = 0.0;
+static uint64_t virtualStart = 0;
+
+static void summary() {
+  double wall = wallSeconds() - wallStart;
+  double virtualTime = (shim::virtualClock.nowMicros() - virtualStart) / 1e6;
+  fprintf(stderr, "trace:     %lu IMU samples, %lu NMEA sentences, %lu UBX frames\n",
+          replay->imuSamples, replay->sentences, replay->frames);
+  fprintf(stderr, "segments:  %lu valid, %lu invalid\n", validSegments, invalidSegments);
+  fprintf(stderr, "i2c:       %llu transactions, %llu bytes\n",
+          (unsigned long long)Wire.stats.transactions, (unsigned long long)Wire.stats.bytes);
+  fprintf(stderr, "replayed:  %.1f s of driving in %.3f s (%.0fx real time)\n",
+          virtualTime, wall, wall > 0 ? virtualTime / wall : 0.0);
+  fflush(out);
+}
+
+int main(int argc, char** argv) {
+  const char* tracePath = nullptr;
+  const char* outPath = nullptr;
+#ifdef GPS_UBX
+  unsigned long baud = UBX_BAUD;
+#else
+  unsigned long baud = GPS_BAUD;
+#endif
+  bool haveCalibration = false;
+  bool features = false;
+  long calibrationMin = 0, calibrationMax = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--calibration") && i + 1 < argc) {
+      haveCalibration = sscanf(argv[++i], "%ld:%ld", &calibrationMin, &calibrationMax) == 2;
+    } else if (!strcmp(argv[i], "--baud") && i + 1 < argc) {
+      baud = strtoul(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (!strcmp(argv[i], "--features")) {
+      features = true;
+    } else if (!strcmp(argv[i], "--verbose")) {
+      shim::console.echo = true;
+    } else if (!tracePath && argv[i][0] != '-') {
+      tracePath = argv[i];
+    } else {
+      tracePath = nullptr;
+      break;
+    }
+  }
+  if (!tracePath) {
+    fprintf(stderr, "usage: %s <trace> [--calibration MIN:MAX] [--baud N] [--features] [-o FILE] [--verbose]\n", argv[0]);
+    return 2;
+  }
+
+  static trace::TraceReplay traceReplay(baud);
+  replay = &traceReplay;
+  if (!replay->open(tracePath)) {
+    fprintf(stderr, "cannot read trace %s\n", tracePath);
+    return 1;
+  }
+  replay->attach();
+
+  if (outPath && !(out = fopen(outPath, "w"))) {
+    perror(outPath);
+    return 1;
+  }
+
+  if (haveCalibration && !storeCalibration(calibrationMin, calibrationMax)) {
+    fprintf(stderr, "cannot store calibration\n");
+    return 1;
+  }
+
+  wallStart = wallSeconds();
+  virtualStart = shim::virtualClock.nowMicros();
+
+  // A segment never completes while standing still, so stop once the
+  // trace has been exhausted for a while
+  shim::uart1.refill = [](uint64_t now) {
+    replay->pump(now);
+    if (replay->finished() && now > replay->lastRecordTime() + 10000000ULL) {
+      summary();
+      exit(0);
+    }
+  };
+
+  Serial.begin(115200);
+  if (!roadQualifier.begin()) {
+    fprintf(stderr, "RoadQualifier::begin() failed\n");
+    return 1;
+  }
+
+  fputs(features ? "lat,lon,quality,timestamp,rms,p2p,crest,kurtosis,exc1,exc2,exc3,samples"
+                 : "lat,lon,quality,timestamp", out);
+  fputs(features && RoadQualifier::hasSpectrum ? ",band1,band2,band3,band4,frames\n" : "\n", out);
+  while (!replay->finished()) {
+    if (roadQualifier.qualifySegment()) {
+      DetailedSegmentQuality segment = roadQualifier.getDetailedSegmentQuality();
+      fprintf(out, "%.7f,%.7f,%u,%ld", segment.latitude, segment.longitude, segment.quality,
+              (long)roadQualifier.getUnixTime());
+      if (features) {
+        const SegmentFeatures& f = segment.features;
+        fprintf(out, ",%u,%u,%.2f,%.2f,%u,%u,%u,%u", f.rms, f.peakToPeak, f.crestFactor / 256.0, f.kurtosis / 256.0,
+                f.exceedances[0], f.exceedances[1], f.exceedances[2], f.samples);
+        if (RoadQualifier::hasSpectrum) {
+          const SegmentSpectrum& s = segment.spectrum;
+          fprintf(out, ",%u,%u,%u,%u,%u", s.bands[0], s.bands[1], s.bands[2], s.bands[3], s.frames);
+        }
+      }
+      fputc('\n', out);
+      validSegments++;
+    } else {
+      invalidSegments++;
+    }
+  }
+
+  summary();
+  return 0;
+}
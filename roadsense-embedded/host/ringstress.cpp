@@ -0,0 +1,153 @@
+// Multithreaded stress test and throughput comparison of the segment
+// buffers: SpscRingBuffer (lib/SpscRingBuffer.h) with both overflow
+// policies, single and batched, against the mutex-based MyCircularBuffer
+// it replaced in the firmware.
+//
+// A producer thread pushes numbered segments into a 1024 entry buffer, a
+// consumer thread pops them, twice per buffer:
+// - flow controlled: the producer waits while the consumer is a buffer
+//   behind, so nothing is lost and the time is that of the hand-over
+// - overflowing: the producer pushes as fast as it can, so most items are
+//   dropped and the overflow paths race with the consumer
+// The consumer checks that every item arrives intact and in order (with
+// gaps when overflowing), and at the end that popped + dropped items add
+// up to the pushed ones. Reports ns per pushed item and the share dropped.
+//
+// Built twice: build/ringstress for the timings and build/ringstress-tsan
+// with ThreadSanitizer, which also reports any data race between the two
+// sides (`make -C host run-ringstress` runs both).
+//
+// Usage: ringstress [--items N]
+
+#include <Arduino.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "../lib/SegmentQuality.h"
+#include "../lib/SpscRingBuffer.h"
+
+#define BUFFER_SIZE 1024
+#include "../lib/MyCircularBuffer.h"
+
+#define STRESS_BATCH 8 // Items per pushN()/popN()
+
+static SegmentQuality makeItem(uint32_t seq) {
+  return {(double)seq, -(double)seq, (uint8_t)seq};
+}
+
+// Adapters with the batch size as the only difference
+template <typename Buffer, size_t Batch>
+struct RingAdapter {
+  Buffer buffer;
+  void push(const SegmentQuality* items, size_t n) {
+    if (Batch == 1) {
+      buffer.push(items[0]);
+    } else {
+      buffer.pushN(items, n);
+    }
+  }
+  size_t pop(SegmentQuality* items, size_t n) {
+    return Batch == 1 ? (size_t)buffer.pop(items[0]) : buffer.popN(items, n);
+  }
+  long dropped() const { return buffer.getDroppedCount(); }
+};
+
+struct MutexAdapter {
+  MyCircularBuffer buffer;
+  void push(const SegmentQuality* items, size_t n) { buffer.put(items[0]); }
+  size_t pop(SegmentQuality* items, size_t n) { return buffer.get(items[0]) ? 1 : 0; }
+  long dropped() const { return -1; } // Not counted, overwritten silently
+};
+
+struct StressResult {
+  double nsPerItem;
+  double droppedShare;
+  bool ok;
+};
+
+template <typename Adapter, size_t Batch>
+static StressResult stress(uint32_t items, bool flowControl) {
+  std::unique_ptr<Adapter> buffer(new Adapter()); // Fresh indices and counters per run
+  Adapter& adapter = *buffer;
+  std::atomic<bool> producing{true};
+  std::atomic<uint32_t> popped{0};
+  bool intact = true;
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread consumer([&] {
+    SegmentQuality batch[Batch];
+    uint32_t next = 0; // Lowest sequence number still expected
+    while (true) {
+      // Check the flag before popping: an empty buffer after the producer
+      // stopped is really empty
+      bool done = !producing.load(std::memory_order_acquire);
+      size_t n = adapter.pop(batch, Batch);
+      if (n == 0) {
+        if (done) break;
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i = 0; i < n; i++) {
+        uint32_t seq = (uint32_t)batch[i].latitude;
+        if (batch[i].longitude != -batch[i].latitude || batch[i].quality != (uint8_t)seq || seq < next) {
+          intact = false;
+        }
+        next = seq + 1;
+      }
+      popped.store(popped.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+  });
+
+  SegmentQuality batch[Batch];
+  for (uint32_t seq = 0; seq < items; seq += Batch) {
+    size_t n = 0;
+    for (; n < Batch && seq + n < items; n++) batch[n] = makeItem(seq + n);
+    while (flowControl && seq + n - popped.load(std::memory_order_acquire) > BUFFER_SIZE) {
+      std::this_thread::yield();
+    }
+    adapter.push(batch, n);
+  }
+  producing.store(false, std::memory_order_release);
+  consumer.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  long dropped = adapter.dropped();
+  uint32_t received = popped.load(std::memory_order_relaxed);
+  bool counted = dropped < 0 || received + (uint32_t)dropped == items;
+  return {seconds * 1e9 / items, (double)(items - received) / items, intact && counted && (!flowControl || received == items)};
+}
+
+template <typename Adapter, size_t Batch>
+static bool stress(const char* name, uint32_t items) {
+  StressResult flowControlled = stress<Adapter, Batch>(items, true);
+  StressResult overflowing = stress<Adapter, Batch>(items, false);
+  printf("%-36s %10.1f %10.1f %8.1f%%  %s\n", name, flowControlled.nsPerItem, overflowing.nsPerItem,
+         100.0 * overflowing.droppedShare, flowControlled.ok && overflowing.ok ? "ok" : "FAILED");
+  return flowControlled.ok && overflowing.ok;
+}
+
+int main(int argc, char** argv) {
+  uint32_t items = 2000000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--items") && i + 1 < argc) {
+      items = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: %s [--items N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  typedef SpscRingBuffer<SegmentQuality, BUFFER_SIZE, RingOverflow::DropNewest> DropNewestRing;
+  typedef SpscRingBuffer<SegmentQuality, BUFFER_SIZE, RingOverflow::DropOldest> DropOldestRing;
+  printf("%u segments through a %u entry buffer, one producer and one consumer thread\n", items, BUFFER_SIZE);
+  printf("%-36s %10s %10s %9s\n", "", "ns/item", "ns/item", "dropped");
+  printf("%-36s %10s %10s %9s\n", "", "(flow)", "(overflow)", "");
+  bool ok = true;
+  ok &= stress<RingAdapter<DropNewestRing, 1>, 1>("SpscRingBuffer DropNewest", items);
+  ok &= stress<RingAdapter<DropOldestRing, 1>, 1>("SpscRingBuffer DropOldest", items);
+  ok &= stress<RingAdapter<DropNewestRing, STRESS_BATCH>, STRESS_BATCH>("SpscRingBuffer DropNewest (batch 8)", items);
+  ok &= stress<RingAdapter<DropOldestRing, STRESS_BATCH>, STRESS_BATCH>("SpscRingBuffer DropOldest (batch 8)", items);
+  ok &= stress<MutexAdapter, 1>("MyCircularBuffer (mutex)", items);
+  return ok ? 0 : 1;
+}
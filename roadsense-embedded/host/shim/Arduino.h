@@ -0,0 +1,200 @@
+// Host (Linux) stand-in for the parts of the Arduino core used by
+// roadsense-embedded. Time is taken from shim::virtualClock.
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "VirtualClock.h"
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+
+#define HIGH 0x1
+#define LOW  0x0
+
+// ----- Time ----- //
+
+inline unsigned long millis() { return (unsigned long)(shim::virtualClock.poll() / 1000ULL); }
+inline unsigned long micros() { return (unsigned long)shim::virtualClock.poll(); }
+inline void delay(unsigned long ms) { shim::virtualClock.advanceMicros((uint64_t)ms * 1000ULL); }
+inline void delayMicroseconds(unsigned int us) { shim::virtualClock.advanceMicros(us); }
+inline void yield() {}
+
+// ----- Random numbers (deterministic, seedable) ----- //
+
+namespace shim {
+inline uint64_t randomState = 0x853C49E6748FEA9BULL;
+
+inline uint32_t nextRandom() {
+  // xorshift64*
+  randomState ^= randomState >> 12;
+  randomState ^= randomState << 25;
+  randomState ^= randomState >> 27;
+  return (uint32_t)((randomState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+} // namespace shim
+
+inline void randomSeed(unsigned long seed) {
+  if (seed != 0) shim::randomState = seed;
+}
+inline long random(long howbig) {
+  if (howbig <= 0) return 0;
+  return (long)(shim::nextRandom() % (uint32_t)howbig);
+}
+inline long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+
+// ----- Print / Stream ----- //
+
+class Print {
+public:
+  virtual ~Print() = default;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+  }
+  size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+
+  size_t print(const char* s) { return write(s); }
+  size_t print(const String& s) { return write(s.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(int v, int base = DEC) { return print((long)v, base); }
+  size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+  size_t print(long v, int base = DEC) { return printFormatted(base == HEX ? "%lX" : "%ld", v); }
+  size_t print(unsigned long v, int base = DEC) { return printFormatted(base == HEX ? "%lX" : "%lu", v); }
+  size_t print(long long v, int base = DEC) { return printFormatted(base == HEX ? "%llX" : "%lld", v); }
+  size_t print(unsigned long long v, int base = DEC) { return printFormatted(base == HEX ? "%llX" : "%llu", v); }
+  size_t print(double v, int digits = 2) { return printFormatted("%.*f", digits, v); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T& v) { size_t n = print(v); return n + println(); }
+  template <typename T>
+  size_t println(const T& v, int format) { size_t n = print(v, format); return n + println(); }
+
+private:
+  template <typename... Args>
+  size_t printFormatted(const char* format, Args... args) {
+    char s[64];
+    int n = snprintf(s, sizeof(s), format, args...);
+    return n > 0 ? write((const uint8_t*)s, (size_t)n) : 0;
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+namespace shim {
+
+// Console output (Serial). Silent unless echo is enabled, so that debug
+// printing costs little when measuring.
+class Console : public Stream {
+public:
+  bool echo = false;
+  size_t write(uint8_t c) override {
+    if (echo) fputc(c, stdout);
+    return 1;
+  }
+  size_t write(const uint8_t* buffer, size_t size) override {
+    if (echo) fwrite(buffer, 1, size, stdout);
+    return size;
+  }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+
+// UART receive side. Bytes are queued with the (virtual) time at which they
+// arrive and become readable once the clock has passed that time.
+class UartRx : public Stream {
+public:
+  void feed(uint64_t timeMicros, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; i++) rx.push_back({timeMicros, data[i]});
+  }
+  void clear() { rx.clear(); }
+  // Time at which the next queued byte arrives (UINT64_MAX when drained)
+  uint64_t nextArrival() const { return rx.empty() ? UINT64_MAX : rx.front().time; }
+
+  // Called with the current time before the queue is inspected, so that a
+  // source (e.g. a trace replay) can feed bytes lazily
+  std::function<void(uint64_t now)> refill;
+
+  int available() override {
+    uint64_t now = virtualClock.nowMicros();
+    if (refill) refill(now);
+    int n = 0;
+    for (const auto& byte : rx) {
+      if (byte.time > now) break;
+      n++;
+    }
+    return n;
+  }
+  int read() override {
+    if (refill) refill(virtualClock.nowMicros());
+    if (rx.empty() || rx.front().time > virtualClock.nowMicros()) return -1;
+    uint8_t c = rx.front().value;
+    rx.pop_front();
+    return c;
+  }
+  int peek() override {
+    if (refill) refill(virtualClock.nowMicros());
+    if (rx.empty() || rx.front().time > virtualClock.nowMicros()) return -1;
+    return rx.front().value;
+  }
+  size_t write(uint8_t c) override { tx.push_back(c); return 1; }
+
+  std::deque<uint8_t> tx; // bytes the firmware sent (e.g. receiver configuration)
+
+private:
+  struct TimedByte {
+    uint64_t time;
+    uint8_t value;
+  };
+  std::deque<TimedByte> rx;
+};
+
+} // namespace shim
+
+class HardwareSerial : public Stream {
+public:
+  explicit HardwareSerial(Stream& port) : port(port) {}
+  void begin(unsigned long baud) { baudRate = baud; }
+  void end() {}
+  unsigned long baud() const { return baudRate; }
+  explicit operator bool() const { return true; }
+  int available() override { return port.available(); }
+  int read() override { return port.read(); }
+  int peek() override { return port.peek(); }
+  size_t write(uint8_t c) override { return port.write(c); }
+  size_t write(const uint8_t* buffer, size_t size) override { return port.write(buffer, size); }
+  using Print::write;
+
+private:
+  Stream& port;
+  unsigned long baudRate = 0;
+};
+
+namespace shim {
+inline Console console;
+inline UartRx uart1;
+} // namespace shim
+
+inline HardwareSerial Serial(shim::console);
+inline HardwareSerial Serial1(shim::uart1);
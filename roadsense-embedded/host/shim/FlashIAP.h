@@ -0,0 +1,103 @@
+// Host stand-in for mbed::FlashIAP with the Portenta H7 (STM32H747) layout:
+// 2 MB of flash in 128 KB sectors, programmed in 32-byte flash words.
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+#define FLASHIAP_APP_ROM_END_ADDR 0x080C0000
+
+namespace shim {
+
+// Backing store shared by every FlashIAP / FlashIAPBlockDevice instance, so
+// data survives "reboots" of the firmware objects within one host process.
+class FlashMemory {
+public:
+  static constexpr uint32_t start = 0x08000000;
+  static constexpr uint32_t size = 2 * 1024 * 1024;
+  static constexpr uint32_t sectorSize = 128 * 1024;
+  static constexpr uint32_t pageSize = 32;
+
+  struct Stats {
+    uint64_t bytesRead = 0;
+    uint64_t bytesProgrammed = 0;
+    uint64_t bytesErased = 0;
+    uint64_t sectorErases = 0;
+  };
+
+  FlashMemory() : cells(size, 0xFF), sectorEraseCounts(size / sectorSize, 0) {}
+
+  bool contains(uint32_t address, uint32_t length) const {
+    return address >= start && length <= size && address - start <= size - length;
+  }
+
+  void read(uint32_t address, void* buffer, uint32_t length) {
+    memcpy(buffer, &cells[address - start], length);
+    stats.bytesRead += length;
+  }
+
+  // NOR semantics: programming can only clear bits. Returns false if a
+  // simulated power loss cut the write short.
+  bool program(uint32_t address, const void* buffer, uint32_t length) {
+    bool complete = true;
+    if (programBudget >= 0 && length > programBudget) {
+      length = (uint32_t)programBudget;
+      complete = false;
+    }
+    if (programBudget >= 0) programBudget -= length;
+    const uint8_t* data = (const uint8_t*)buffer;
+    for (uint32_t i = 0; i < length; i++) cells[address - start + i] &= data[i];
+    stats.bytesProgrammed += length;
+    return complete;
+  }
+
+  bool erase(uint32_t address, uint32_t length) {
+    if (programBudget == 0) return false;
+    memset(&cells[address - start], 0xFF, length);
+    for (uint32_t s = (address - start) / sectorSize; s < (address - start + length) / sectorSize; s++)
+      sectorEraseCounts[s]++;
+    stats.bytesErased += length;
+    stats.sectorErases += length / sectorSize;
+    return true;
+  }
+
+  // Bytes that can still be programmed before a simulated power loss (-1:
+  // no limit); at 0 programming and erasing have no effect until it is reset
+  int64_t programBudget = -1;
+
+  Stats stats;
+  std::vector<uint8_t> cells;
+  std::vector<uint32_t> sectorEraseCounts;
+};
+
+inline FlashMemory flashMemory;
+
+} // namespace shim
+
+namespace mbed {
+
+class FlashIAP {
+public:
+  int init() { return 0; }
+  int deinit() { return 0; }
+  int read(void* buffer, uint32_t address, uint32_t size) {
+    if (!shim::flashMemory.contains(address, size)) return -1;
+    shim::flashMemory.read(address, buffer, size);
+    return 0;
+  }
+  int program(const void* buffer, uint32_t address, uint32_t size) {
+    if (!shim::flashMemory.contains(address, size) || address % get_page_size() || size % get_page_size()) return -1;
+    return shim::flashMemory.program(address, buffer, size) ? 0 : -1;
+  }
+  int erase(uint32_t address, uint32_t size) {
+    if (!shim::flashMemory.contains(address, size) || address % get_sector_size(address) || size % get_sector_size(address)) return -1;
+    return shim::flashMemory.erase(address, size) ? 0 : -1;
+  }
+  uint32_t get_page_size() const { return shim::FlashMemory::pageSize; }
+  uint32_t get_sector_size(uint32_t) const { return shim::FlashMemory::sectorSize; }
+  uint32_t get_flash_start() const { return shim::FlashMemory::start; }
+  uint32_t get_flash_size() const { return shim::FlashMemory::size; }
+  uint8_t get_erase_value() const { return 0xFF; }
+};
+
+} // namespace mbed
@@ -0,0 +1,47 @@
+// Host stand-in for mbed's FlashIAPBlockDevice on top of the shim FlashIAP.
+#pragma once
+
+#include "FlashIAP.h"
+
+typedef uint64_t bd_addr_t;
+typedef uint64_t bd_size_t;
+
+#define BD_ERROR_OK            0
+#define BD_ERROR_DEVICE_ERROR  -4001
+
+class FlashIAPBlockDevice {
+public:
+  FlashIAPBlockDevice(uint32_t address = 0, uint32_t size = 0) : baseAddress(address), deviceSize(size) {}
+
+  int init() {
+    if (flash.init() != 0) return BD_ERROR_DEVICE_ERROR;
+    if (deviceSize == 0) deviceSize = flash.get_flash_start() + flash.get_flash_size() - baseAddress;
+    return BD_ERROR_OK;
+  }
+  int deinit() { return flash.deinit(); }
+
+  int read(void* buffer, bd_addr_t addr, bd_size_t size) {
+    if (addr + size > deviceSize) return BD_ERROR_DEVICE_ERROR;
+    return flash.read(buffer, baseAddress + (uint32_t)addr, (uint32_t)size) ? BD_ERROR_DEVICE_ERROR : BD_ERROR_OK;
+  }
+  int program(const void* buffer, bd_addr_t addr, bd_size_t size) {
+    if (addr + size > deviceSize) return BD_ERROR_DEVICE_ERROR;
+    return flash.program(buffer, baseAddress + (uint32_t)addr, (uint32_t)size) ? BD_ERROR_DEVICE_ERROR : BD_ERROR_OK;
+  }
+  int erase(bd_addr_t addr, bd_size_t size) {
+    if (addr + size > deviceSize) return BD_ERROR_DEVICE_ERROR;
+    return flash.erase(baseAddress + (uint32_t)addr, (uint32_t)size) ? BD_ERROR_DEVICE_ERROR : BD_ERROR_OK;
+  }
+
+  bd_size_t get_read_size() const { return 1; }
+  bd_size_t get_program_size() const { return flash.get_page_size(); }
+  bd_size_t get_erase_size() const { return flash.get_sector_size(baseAddress); }
+  bd_size_t get_erase_size(bd_addr_t addr) const { return flash.get_sector_size(baseAddress + (uint32_t)addr); }
+  int get_erase_value() const { return flash.get_erase_value(); }
+  bd_size_t size() const { return deviceSize; }
+
+private:
+  mbed::FlashIAP flash;
+  uint32_t baseAddress;
+  bd_size_t deviceSize;
+};
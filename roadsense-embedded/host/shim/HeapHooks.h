@@ -0,0 +1,75 @@
+// Counts every heap call of a host tool in shim::heapStats: malloc(),
+// calloc(), realloc(), the aligned allocators and free() are replaced by
+// wrappers around the glibc implementations (__libc_malloc() and friends),
+// and operator new/delete go through them. So C code, libraries and the
+// shim String are all counted, not only operator new.
+//
+// Include in exactly one translation unit of a tool (the one with main()).
+// The replacements are noexcept like the glibc declarations.
+#pragma once
+
+#include <new>
+#include <errno.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include "HostHeap.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) noexcept {
+  shim::countHeapAllocation(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+  shim::countHeapAllocation(count * size);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept {
+  if (size == 0 && ptr) {
+    shim::countHeapFree();
+  } else {
+    shim::countHeapAllocation(size);
+  }
+  return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+  shim::countHeapAllocation(size);
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+  return memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept {
+  void* p = memalign(alignment, size);
+  if (!p) return ENOMEM;
+  *ptr = p;
+  return 0;
+}
+
+void free(void* ptr) noexcept {
+  if (ptr) shim::countHeapFree();
+  __libc_free(ptr);
+}
+}
+
+void* operator new(size_t size) {
+  if (void* p = malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return malloc(size ? size : 1); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return malloc(size ? size : 1); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
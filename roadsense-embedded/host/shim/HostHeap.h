@@ -0,0 +1,38 @@
+// Heap accounting shared by the host shim and the host tools. The counts
+// are kept by the malloc()/operator new replacements of HeapHooks.h, which
+// a tool that reports allocations includes once; without them they stay 0.
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace shim {
+
+struct HeapStats {
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> frees{0};
+  std::atomic<uint64_t> bytes{0};
+};
+
+inline HeapStats heapStats;
+
+inline void countHeapAllocation(size_t size) {
+  heapStats.allocations.fetch_add(1, std::memory_order_relaxed);
+  heapStats.bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+inline void countHeapFree() {
+  heapStats.frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+// realloc() where the Arduino core and libraries malloc (String, PubSubClient)
+inline void* heapRealloc(void* ptr, size_t size) {
+  return realloc(ptr, size);
+}
+
+inline void heapFree(void* ptr) {
+  free(ptr);
+}
+
+} // namespace shim
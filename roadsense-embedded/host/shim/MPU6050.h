@@ -0,0 +1,221 @@
+// Host stand-in for the Electronic Cats MPU6050 library.
+//
+// shim::MPU6050Device emulates the sensor at register level on the shim
+// I2C bus; the MPU6050 driver class talks to it through Wire exactly like
+// the real library, so I2C traffic and bus time are accounted. Z
+// acceleration comes from a pluggable shim::ImuSource.
+//
+// The sample clock and the 1 KB FIFO are emulated as well: while the FIFO
+// is enabled, one accelerometer frame is queued per sample period of the
+// virtual clock (SMPLRT_DIV and the DLPF setting decide the rate), and on
+// overflow the oldest bytes are dropped and FIFO_OFLOW is raised, as on
+// the chip.
+#pragma once
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <deque>
+
+#define MPU6050_DEFAULT_ADDRESS 0x68
+
+#define MPU6050_RA_SMPLRT_DIV   0x19
+#define MPU6050_RA_CONFIG       0x1A
+#define MPU6050_RA_FIFO_EN      0x23
+#define MPU6050_RA_INT_STATUS   0x3A
+#define MPU6050_RA_ACCEL_XOUT_H 0x3B
+#define MPU6050_RA_ACCEL_ZOUT_H 0x3F
+#define MPU6050_RA_USER_CTRL    0x6A
+#define MPU6050_RA_FIFO_COUNTH  0x72
+#define MPU6050_RA_FIFO_R_W     0x74
+#define MPU6050_RA_WHO_AM_I     0x75
+
+#define MPU6050_ACCEL_FIFO_EN_BIT       3
+#define MPU6050_INTERRUPT_FIFO_OFLOW_BIT 4
+#define MPU6050_USERCTRL_FIFO_EN_BIT    6
+#define MPU6050_USERCTRL_FIFO_RESET_BIT 2
+
+#define MPU6050_FIFO_SIZE 1024
+
+namespace shim {
+
+// Source of Z acceleration samples (raw units, +-2g range) over time
+class ImuSource {
+public:
+  virtual ~ImuSource() = default;
+  virtual int16_t accelZ(uint64_t timeMicros) = 0;
+};
+
+// Default source: 1 g plus gaussian road noise
+class NoiseImuSource : public ImuSource {
+public:
+  float noiseStd = 1500.0f;
+
+  int16_t accelZ(uint64_t) override {
+    float u1 = (nextRandom() + 1.0f) / 4294967296.0f;
+    float u2 = nextRandom() / 4294967296.0f;
+    float normal = 16384.0f + noiseStd * sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+    if (normal > 32767.0f) normal = 32767.0f;
+    if (normal < -32768.0f) normal = -32768.0f;
+    return (int16_t)normal;
+  }
+};
+
+inline NoiseImuSource noiseImuSource;
+inline ImuSource* imuSource = &noiseImuSource;
+
+class MPU6050Device : public I2CDevice {
+public:
+  MPU6050Device() { registers[MPU6050_RA_WHO_AM_I] = MPU6050_DEFAULT_ADDRESS; }
+
+  void writeRegisters(uint8_t reg, const uint8_t* data, size_t size) override {
+    sampleUntil(virtualClock.nowMicros());
+    for (size_t i = 0; i < size; i++) registers[(uint8_t)(reg + i)] = data[i];
+
+    if (registers[MPU6050_RA_USER_CTRL] & (1 << MPU6050_USERCTRL_FIFO_RESET_BIT)) {
+      registers[MPU6050_RA_USER_CTRL] &= ~(1 << MPU6050_USERCTRL_FIFO_RESET_BIT); // self-clearing
+      fifo.clear();
+      registers[MPU6050_RA_INT_STATUS] &= ~(1 << MPU6050_INTERRUPT_FIFO_OFLOW_BIT);
+    }
+  }
+
+  void readRegisters(uint8_t reg, uint8_t* data, size_t size) override {
+    sampleUntil(virtualClock.nowMicros());
+
+    // FIFO_R_W does not auto-increment: a burst pops consecutive FIFO bytes
+    if (reg == MPU6050_RA_FIFO_R_W) {
+      for (size_t i = 0; i < size; i++) {
+        data[i] = fifo.empty() ? 0 : fifo.front();
+        if (!fifo.empty()) fifo.pop_front();
+      }
+      return;
+    }
+
+    if (reg <= MPU6050_RA_ACCEL_ZOUT_H + 1 && reg + size > MPU6050_RA_ACCEL_XOUT_H) latchAccel(virtualClock.nowMicros());
+    registers[MPU6050_RA_FIFO_COUNTH] = (uint8_t)(fifo.size() >> 8);
+    registers[MPU6050_RA_FIFO_COUNTH + 1] = (uint8_t)fifo.size();
+    for (size_t i = 0; i < size; i++) data[i] = registers[(uint8_t)(reg + i)];
+
+    // INT_STATUS is cleared on read
+    if (reg <= MPU6050_RA_INT_STATUS && reg + size > MPU6050_RA_INT_STATUS) registers[MPU6050_RA_INT_STATUS] = 0;
+  }
+
+  // Output data rate: 8 kHz gyro clock with the DLPF off (0 or 7), 1 kHz otherwise
+  uint64_t samplePeriodMicros() const {
+    uint8_t dlpf = registers[MPU6050_RA_CONFIG] & 0x07;
+    uint64_t internalRateHz = (dlpf == 0 || dlpf == 7) ? 8000 : 1000;
+    return (1000000ULL * (1 + registers[MPU6050_RA_SMPLRT_DIV]) + internalRateHz - 1) / internalRateHz;
+  }
+
+private:
+  uint8_t registers[256] = {};
+  std::deque<uint8_t> fifo;
+  uint64_t nextSampleTime = 0;
+
+  bool fifoEnabled() const {
+    return (registers[MPU6050_RA_USER_CTRL] & (1 << MPU6050_USERCTRL_FIFO_EN_BIT)) &&
+           (registers[MPU6050_RA_FIFO_EN] & (1 << MPU6050_ACCEL_FIFO_EN_BIT));
+  }
+
+  // Queues one frame per sample period up to time `now`
+  void sampleUntil(uint64_t now) {
+    uint64_t period = samplePeriodMicros();
+    if (!fifoEnabled()) {
+      nextSampleTime = now + period;
+      return;
+    }
+    // Older samples would be overwritten anyway; skip them after long waits
+    const uint64_t framesToFill = MPU6050_FIFO_SIZE / 6 + 1;
+    if (nextSampleTime + framesToFill * period < now) {
+      nextSampleTime = now - framesToFill * period;
+      registers[MPU6050_RA_INT_STATUS] |= 1 << MPU6050_INTERRUPT_FIFO_OFLOW_BIT;
+    }
+    for (; nextSampleTime <= now; nextSampleTime += period) {
+      latchAccel(nextSampleTime);
+      for (int i = 0; i < 6; i++) fifo.push_back(registers[MPU6050_RA_ACCEL_XOUT_H + i]);
+      while (fifo.size() > MPU6050_FIFO_SIZE) {
+        fifo.pop_front();
+        registers[MPU6050_RA_INT_STATUS] |= 1 << MPU6050_INTERRUPT_FIFO_OFLOW_BIT;
+      }
+    }
+  }
+
+  void latchAccel(uint64_t time) {
+    int16_t z = imuSource->accelZ(time);
+    registers[MPU6050_RA_ACCEL_XOUT_H + 0] = 0;
+    registers[MPU6050_RA_ACCEL_XOUT_H + 1] = 0;
+    registers[MPU6050_RA_ACCEL_XOUT_H + 2] = 0;
+    registers[MPU6050_RA_ACCEL_XOUT_H + 3] = 0;
+    registers[MPU6050_RA_ACCEL_XOUT_H + 4] = (uint8_t)((uint16_t)z >> 8);
+    registers[MPU6050_RA_ACCEL_XOUT_H + 5] = (uint8_t)z;
+  }
+};
+
+inline MPU6050Device mpu6050Device;
+
+} // namespace shim
+
+class MPU6050 {
+public:
+  explicit MPU6050(uint8_t address = MPU6050_DEFAULT_ADDRESS) : address(address) {}
+
+  void initialize() { Wire.attach(address, &shim::mpu6050Device); }
+  bool testConnection() {
+    uint8_t whoAmI = 0;
+    Wire.readRegisters(address, MPU6050_RA_WHO_AM_I, &whoAmI, 1);
+    return whoAmI == MPU6050_DEFAULT_ADDRESS;
+  }
+
+  void setXAccelOffset(int16_t) {}
+  void setYAccelOffset(int16_t) {}
+  void setZAccelOffset(int16_t) {}
+  void setXGyroOffset(int16_t) {}
+  void setYGyroOffset(int16_t) {}
+  void setZGyroOffset(int16_t) {}
+  void CalibrateAccel(uint8_t) {}
+  void CalibrateGyro(uint8_t) {}
+  void PrintActiveOffsets() {}
+
+  void getAcceleration(int16_t* x, int16_t* y, int16_t* z) {
+    uint8_t buffer[6];
+    Wire.readRegisters(address, MPU6050_RA_ACCEL_XOUT_H, buffer, 6);
+    *x = (int16_t)((buffer[0] << 8) | buffer[1]);
+    *y = (int16_t)((buffer[2] << 8) | buffer[3]);
+    *z = (int16_t)((buffer[4] << 8) | buffer[5]);
+  }
+  int16_t getAccelerationZ() {
+    uint8_t buffer[2];
+    Wire.readRegisters(address, MPU6050_RA_ACCEL_ZOUT_H, buffer, 2);
+    return (int16_t)((buffer[0] << 8) | buffer[1]);
+  }
+
+  // Sample rate and FIFO
+  void setRate(uint8_t rate) { Wire.writeRegisters(address, MPU6050_RA_SMPLRT_DIV, &rate, 1); }
+  void setDLPFMode(uint8_t mode) { writeBits(MPU6050_RA_CONFIG, 0x07, mode); }
+  void setAccelFIFOEnabled(bool enabled) { writeBits(MPU6050_RA_FIFO_EN, 1 << MPU6050_ACCEL_FIFO_EN_BIT, enabled ? 0xFF : 0); }
+  void setFIFOEnabled(bool enabled) { writeBits(MPU6050_RA_USER_CTRL, 1 << MPU6050_USERCTRL_FIFO_EN_BIT, enabled ? 0xFF : 0); }
+  void resetFIFO() { writeBits(MPU6050_RA_USER_CTRL, 1 << MPU6050_USERCTRL_FIFO_RESET_BIT, 0xFF); }
+  uint16_t getFIFOCount() {
+    uint8_t buffer[2];
+    Wire.readRegisters(address, MPU6050_RA_FIFO_COUNTH, buffer, 2);
+    return (uint16_t)((buffer[0] << 8) | buffer[1]);
+  }
+  bool getIntFIFOBufferOverflowStatus() {
+    uint8_t status = 0;
+    Wire.readRegisters(address, MPU6050_RA_INT_STATUS, &status, 1);
+    return status & (1 << MPU6050_INTERRUPT_FIFO_OFLOW_BIT);
+  }
+  void getFIFOBytes(uint8_t* data, uint8_t length) {
+    if (length) Wire.readRegisters(address, MPU6050_RA_FIFO_R_W, data, length);
+  }
+
+private:
+  uint8_t address;
+
+  // Read-modify-write of the bits in `mask`
+  void writeBits(uint8_t reg, uint8_t mask, uint8_t value) {
+    uint8_t current = 0;
+    Wire.readRegisters(address, reg, &current, 1);
+    current = (uint8_t)((current & ~mask) | (value & mask));
+    Wire.writeRegisters(address, reg, &current, 1);
+  }
+};
@@ -0,0 +1,94 @@
+// Host stand-in for the PubSubClient MQTT library. Published messages are
+// handed to shim::broker, which counts them and can forward them to a sink.
+// The packet buffer is heap-allocated like in the library, so that its
+// reallocations show up in the heap counts (HostHeap.h).
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <functional>
+#include "HostHeap.h"
+
+#define MQTT_MAX_PACKET_SIZE 256
+#define MQTT_MAX_HEADER_SIZE 5
+
+#define MQTT_CONNECTION_LOST   -3
+#define MQTT_CONNECT_FAILED    -2
+#define MQTT_DISCONNECTED      -1
+#define MQTT_CONNECTED          0
+
+namespace shim {
+struct Broker {
+  uint64_t messages = 0;
+  uint64_t payloadBytes = 0;
+  uint64_t connects = 0;
+  std::function<void(const char* topic, const uint8_t* payload, unsigned int length)> sink;
+};
+inline Broker broker;
+} // namespace shim
+
+class PubSubClient {
+public:
+  explicit PubSubClient(Client& client) {
+    (void)client;
+    setBufferSize(MQTT_MAX_PACKET_SIZE);
+  }
+  ~PubSubClient() { shim::heapFree(buffer); }
+  PubSubClient(const PubSubClient&) = delete;
+  PubSubClient& operator=(const PubSubClient&) = delete;
+
+  PubSubClient& setServer(const char* domain, uint16_t port) {
+    (void)domain; (void)port;
+    return *this;
+  }
+  // Like the library, reallocs the buffer on every call, even to the same size
+  bool setBufferSize(uint16_t size) {
+    if (size == 0) return false;
+    uint8_t* newBuffer = (uint8_t*)shim::heapRealloc(buffer, size);
+    if (!newBuffer) return false;
+    buffer = newBuffer;
+    bufferSize = size;
+    return true;
+  }
+  uint16_t getBufferSize() const { return bufferSize; }
+
+  bool connect(const char* id, const char* user, const char* pass) {
+    (void)id; (void)user; (void)pass;
+    isConnected = shim::network.available;
+    connectionState = isConnected ? MQTT_CONNECTED : MQTT_CONNECT_FAILED;
+    if (isConnected) shim::broker.connects++;
+    return isConnected;
+  }
+  void disconnect() {
+    isConnected = false;
+    connectionState = MQTT_DISCONNECTED;
+  }
+  bool connected() {
+    if (isConnected && !shim::network.available) {
+      isConnected = false;
+      connectionState = MQTT_CONNECTION_LOST;
+    }
+    return isConnected;
+  }
+  int state() const { return connectionState; }
+  bool loop() { return connected(); }
+
+  bool publish(const char* topic, const char* payload) {
+    return publish(topic, (const uint8_t*)payload, (unsigned int)strlen(payload));
+  }
+  bool publish(const char* topic, const uint8_t* payload, unsigned int plength) {
+    if (!connected()) return false;
+    // Same limit as the library: header + topic + payload must fit the buffer
+    if (MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + plength > bufferSize) return false;
+    shim::broker.messages++;
+    shim::broker.payloadBytes += plength;
+    if (shim::broker.sink) shim::broker.sink(topic, payload, plength);
+    return true;
+  }
+
+private:
+  uint8_t* buffer = nullptr;
+  uint16_t bufferSize = 0;
+  bool isConnected = false;
+  int connectionState = MQTT_DISCONNECTED;
+};
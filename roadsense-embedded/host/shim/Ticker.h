@@ -0,0 +1,32 @@
+// Host stand-in for mbed::Ticker, backed by a periodic timer of the shim
+// virtual clock (see VirtualClock.h): the callback runs in "interrupt
+// context" whenever the clock passes the next deadline.
+#pragma once
+
+#include <Arduino.h>
+#include <chrono>
+#include <functional>
+
+namespace mbed {
+
+class Ticker {
+public:
+  Ticker() = default;
+  Ticker(const Ticker&) = delete;
+  Ticker& operator=(const Ticker&) = delete;
+  ~Ticker() { detach(); }
+
+  void attach(std::function<void()> func, std::chrono::microseconds period) {
+    detach();
+    timer = shim::virtualClock.addTimer((uint64_t)period.count(), std::move(func));
+  }
+  void detach() {
+    if (timer) shim::virtualClock.removeTimer(timer);
+    timer = 0;
+  }
+
+private:
+  int timer = 0;
+};
+
+} // namespace mbed
@@ -0,0 +1,270 @@
+// Host stand-in for the TinyGPS++ library (Mikal Hart).
+//
+// Implements the subset of the API used by the firmware with the same
+// semantics: sentences are parsed term by term, staged values are committed
+// only when the checksum matches, isUpdated() stays set until the value is
+// read, and TinyGPSCustom extracts any term of any sentence. Location, date
+// and time are taken from $--RMC and $--GGA.
+#pragma once
+
+#include <Arduino.h>
+
+#define _GPS_MAX_FIELD_SIZE 15
+
+class TinyGPSPlus;
+
+class TinyGPSLocation {
+  friend class TinyGPSPlus;
+public:
+  bool isValid() const { return valid; }
+  bool isUpdated() const { return updated; }
+  uint32_t age() const { return valid ? (uint32_t)(millis() - lastCommitTime) : (uint32_t)ULONG_MAX; }
+  double lat() { updated = false; return latitude; }
+  double lng() { updated = false; return longitude; }
+
+private:
+  bool valid = false;
+  bool updated = false;
+  unsigned long lastCommitTime = 0;
+  double latitude = 0.0, longitude = 0.0;
+  double stagedLatitude = 0.0, stagedLongitude = 0.0;
+
+  void commit() {
+    latitude = stagedLatitude;
+    longitude = stagedLongitude;
+    lastCommitTime = millis();
+    valid = updated = true;
+  }
+};
+
+class TinyGPSDate {
+  friend class TinyGPSPlus;
+public:
+  bool isValid() const { return valid; }
+  bool isUpdated() const { return updated; }
+  uint32_t value() { updated = false; return date; }
+  uint16_t year() { updated = false; return date % 100 + 2000; }
+  uint8_t month() { updated = false; return (date / 100) % 100; }
+  uint8_t day() { updated = false; return date / 10000; }
+
+private:
+  bool valid = false;
+  bool updated = false;
+  uint32_t date = 0, staged = 0; // ddmmyy
+
+  void commit() {
+    date = staged;
+    valid = updated = true;
+  }
+};
+
+class TinyGPSTime {
+  friend class TinyGPSPlus;
+public:
+  bool isValid() const { return valid; }
+  bool isUpdated() const { return updated; }
+  uint32_t value() { updated = false; return time; }
+  uint8_t hour() { updated = false; return time / 1000000; }
+  uint8_t minute() { updated = false; return (time / 10000) % 100; }
+  uint8_t second() { updated = false; return (time / 100) % 100; }
+
+private:
+  bool valid = false;
+  bool updated = false;
+  uint32_t time = 0, staged = 0; // hhmmsscc
+
+  void commit() {
+    time = staged;
+    valid = updated = true;
+  }
+};
+
+class TinyGPSCustom {
+  friend class TinyGPSPlus;
+public:
+  TinyGPSCustom(TinyGPSPlus& gps, const char* sentenceName, int termNumber);
+
+  bool isUpdated() const { return updated; }
+  bool isValid() const { return valid; }
+  uint32_t age() const { return valid ? (uint32_t)(millis() - lastCommitTime) : (uint32_t)ULONG_MAX; }
+  const char* value() { updated = false; return buffer; }
+
+private:
+  const char* sentenceName;
+  int termNumber;
+  bool valid = false;
+  bool updated = false;
+  unsigned long lastCommitTime = 0;
+  char buffer[_GPS_MAX_FIELD_SIZE + 1] = {};
+  char staging[_GPS_MAX_FIELD_SIZE + 1] = {};
+  TinyGPSCustom* next = nullptr;
+
+  void commit() {
+    strcpy(buffer, staging);
+    lastCommitTime = millis();
+    valid = updated = true;
+  }
+};
+
+class TinyGPSPlus {
+  friend class TinyGPSCustom;
+public:
+  bool encode(char c) {
+    encodedCharCount++;
+    switch (c) {
+      case ',':
+        parity ^= (uint8_t)c;
+        [[fallthrough]];
+      case '\r':
+      case '\n':
+      case '*': {
+        bool isValidSentence = false;
+        if (termOffset < sizeof(term)) {
+          term[termOffset] = '\0';
+          isValidSentence = endOfTermHandler();
+        }
+        ++curTermNumber;
+        termOffset = 0;
+        isChecksumTerm = c == '*';
+        return isValidSentence;
+      }
+      case '$':
+        curTermNumber = termOffset = 0;
+        parity = 0;
+        curSentenceType = SentenceOther;
+        isChecksumTerm = false;
+        sentenceHasFix = false;
+        customCandidates = nullptr;
+        return false;
+      default:
+        if (termOffset < sizeof(term) - 1) term[termOffset++] = c;
+        if (!isChecksumTerm) parity ^= (uint8_t)c;
+        return false;
+    }
+  }
+
+  uint32_t charsProcessed() const { return encodedCharCount; }
+  uint32_t sentencesWithFix() const { return sentencesWithFixCount; }
+  uint32_t failedChecksum() const { return failedChecksumCount; }
+  uint32_t passedChecksum() const { return passedChecksumCount; }
+
+  TinyGPSLocation location;
+  TinyGPSDate date;
+  TinyGPSTime time;
+
+private:
+  enum { SentenceGGA, SentenceRMC, SentenceOther };
+
+  uint8_t parity = 0;
+  bool isChecksumTerm = false;
+  char term[_GPS_MAX_FIELD_SIZE];
+  uint8_t curSentenceType = SentenceOther;
+  uint8_t curTermNumber = 0;
+  uint8_t termOffset = 0;
+  bool sentenceHasFix = false;
+  TinyGPSCustom* customElts = nullptr;
+  TinyGPSCustom* customCandidates = nullptr;
+
+  uint32_t encodedCharCount = 0;
+  uint32_t sentencesWithFixCount = 0;
+  uint32_t failedChecksumCount = 0;
+  uint32_t passedChecksumCount = 0;
+
+  static int fromHex(char a) {
+    if (a >= 'A' && a <= 'F') return a - 'A' + 10;
+    if (a >= 'a' && a <= 'f') return a - 'a' + 10;
+    return a - '0';
+  }
+
+  // "ddmm.mmmm" / "dddmm.mmmm" to signed degrees
+  static double parseDegrees(const char* term) {
+    double value = atof(term);
+    int degrees = (int)(value / 100);
+    return degrees + (value - degrees * 100) / 60.0;
+  }
+
+  static uint32_t parseTime(const char* term) {
+    // hhmmss.cc -> hhmmsscc
+    double value = atof(term);
+    return (uint32_t)(value * 100 + 0.5);
+  }
+
+  void insertCustom(TinyGPSCustom* custom) {
+    TinyGPSCustom** p = &customElts;
+    while (*p && (strcmp((*p)->sentenceName, custom->sentenceName) < 0 ||
+                  (strcmp((*p)->sentenceName, custom->sentenceName) == 0 && (*p)->termNumber < custom->termNumber)))
+      p = &(*p)->next;
+    custom->next = *p;
+    *p = custom;
+  }
+
+  bool endOfTermHandler() {
+    if (isChecksumTerm) {
+      uint8_t checksum = (uint8_t)(16 * fromHex(term[0]) + fromHex(term[1]));
+      if (checksum != parity) {
+        failedChecksumCount++;
+        return false;
+      }
+      passedChecksumCount++;
+      if (sentenceHasFix) sentencesWithFixCount++;
+
+      switch (curSentenceType) {
+        case SentenceRMC:
+          date.commit();
+          time.commit();
+          if (sentenceHasFix) location.commit();
+          break;
+        case SentenceGGA:
+          time.commit();
+          if (sentenceHasFix) location.commit();
+          break;
+      }
+      for (TinyGPSCustom* p = customCandidates; p && strcmp(p->sentenceName, customCandidates->sentenceName) == 0; p = p->next)
+        p->commit();
+      return true;
+    }
+
+    if (curTermNumber == 0) {
+      size_t length = strlen(term);
+      bool talkerOk = term[0] == 'G' && (term[1] == 'P' || term[1] == 'N');
+      if (talkerOk && length == 5 && !strcmp(term + 2, "RMC")) curSentenceType = SentenceRMC;
+      else if (talkerOk && length == 5 && !strcmp(term + 2, "GGA")) curSentenceType = SentenceGGA;
+      else curSentenceType = SentenceOther;
+
+      customCandidates = nullptr;
+      for (TinyGPSCustom* p = customElts; p; p = p->next) {
+        if (!strcmp(p->sentenceName, term)) {
+          customCandidates = p;
+          break;
+        }
+      }
+      return false;
+    }
+
+    if (curSentenceType != SentenceOther && term[0]) {
+      switch (curSentenceType == SentenceRMC ? 100 + curTermNumber : 200 + curTermNumber) {
+        case 101: case 201: time.staged = parseTime(term); break;
+        case 102: sentenceHasFix = term[0] == 'A'; break;
+        case 103: case 202: location.stagedLatitude = parseDegrees(term); break;
+        case 104: case 203: if (term[0] == 'S') location.stagedLatitude = -location.stagedLatitude; break;
+        case 105: case 204: location.stagedLongitude = parseDegrees(term); break;
+        case 106: case 205: if (term[0] == 'W') location.stagedLongitude = -location.stagedLongitude; break;
+        case 109: date.staged = (uint32_t)atol(term); break;
+        case 206: sentenceHasFix = term[0] > '0'; break;
+      }
+    }
+
+    for (TinyGPSCustom* p = customCandidates; p && strcmp(p->sentenceName, customCandidates->sentenceName) == 0; p = p->next) {
+      if (p->termNumber == curTermNumber) {
+        strncpy(p->staging, term, sizeof(p->staging) - 1);
+        p->staging[sizeof(p->staging) - 1] = '\0';
+      }
+    }
+    return false;
+  }
+};
+
+inline TinyGPSCustom::TinyGPSCustom(TinyGPSPlus& gps, const char* sentenceName, int termNumber)
+    : sentenceName(sentenceName), termNumber(termNumber) {
+  gps.insertCustom(this);
+}
@@ -0,0 +1,183 @@
+// Controllable clock behind millis()/micros()/delay() on host builds.
+//
+// In Virtual mode time only moves when the firmware waits (delay(),
+// ThisThread::sleep_for()) or when a shim models bus time, so code runs as
+// fast as the host allows while still seeing realistic timestamps.
+// Every millis()/micros() call also costs pollCostMicros of virtual time, so
+// loops that busy-wait on the clock terminate.
+// In Realtime mode the clock follows the host's monotonic clock.
+//
+// Periodic timers (see shim mbed::Ticker) stand in for timer interrupts:
+// whenever the clock is read or advanced past a deadline, the due callbacks
+// run on the calling thread with the clock set to their deadline, as if the
+// interrupt had fired there. Time spent inside a callback (e.g. bus time of
+// a woken sampler thread) moves the clock on without firing timers again.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace shim {
+
+class VirtualClock {
+public:
+  enum class Mode { Virtual, Realtime };
+
+  void setMode(Mode mode) {
+    this->mode = mode;
+    realtimeOrigin = std::chrono::steady_clock::now();
+    realtimeOffset = now.load();
+  }
+  Mode getMode() const { return mode; }
+
+  uint64_t nowMicros() const {
+    if (mode == Mode::Realtime) {
+      auto elapsed = std::chrono::steady_clock::now() - realtimeOrigin;
+      return realtimeOffset + std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    }
+    return now.load(std::memory_order_relaxed);
+  }
+
+  // Reads the clock on behalf of the firmware (millis()/micros())
+  uint64_t poll() {
+    if (mode == Mode::Virtual) {
+      uint64_t t = now.load(std::memory_order_relaxed) + pollCostMicros;
+      if (t >= nextDeadline.load(std::memory_order_relaxed) && fireTimers(t)) return now.load();
+      return now.fetch_add(pollCostMicros, std::memory_order_relaxed) + pollCostMicros;
+    }
+    fireTimers(nowMicros());
+    return nowMicros();
+  }
+
+  // Let time pass (sleeps in Realtime mode)
+  void advanceMicros(uint64_t us) {
+    if (mode == Mode::Realtime) {
+      std::this_thread::sleep_for(std::chrono::microseconds(us));
+      fireTimers(nowMicros());
+      return;
+    }
+    uint64_t target = now.load(std::memory_order_relaxed) + us;
+    if (target >= nextDeadline.load(std::memory_order_relaxed) && fireTimers(target)) return;
+    now.fetch_add(us, std::memory_order_relaxed);
+  }
+
+  // Waits for the next timer interrupt, at most until `limit` (idle thread)
+  void idleUntil(uint64_t limit) {
+    uint64_t deadline = nextDeadline.load();
+    uint64_t current = nowMicros();
+    if (limit > deadline) limit = deadline;
+    if (limit > current) advanceMicros(limit - current);
+    else fireTimers(current);
+  }
+
+  // ----- Periodic timers ----- //
+
+  // Calls callback every periodMicros from now on; returns a handle for removeTimer()
+  int addTimer(uint64_t periodMicros, std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(timerMutex);
+    int id = nextTimerId++;
+    timers.push_back({id, periodMicros ? periodMicros : 1, nowMicros() + periodMicros, std::move(callback)});
+    updateNextDeadline();
+    return id;
+  }
+
+  void removeTimer(int id) {
+    std::lock_guard<std::mutex> lock(timerMutex);
+    for (size_t i = 0; i < timers.size(); i++) {
+      if (timers[i].id == id) {
+        timers.erase(timers.begin() + i);
+        break;
+      }
+    }
+    updateNextDeadline();
+  }
+
+  // True while a timer callback runs on this thread ("interrupt context")
+  static bool inTimerCallback() { return timerContext(); }
+
+  // Jump forward to an absolute time (never moves backwards)
+  void advanceTo(uint64_t us) {
+    uint64_t current = nowMicros();
+    if (us > current) advanceMicros(us - current);
+  }
+
+  void reset(uint64_t us = 0) {
+    {
+      std::lock_guard<std::mutex> lock(timerMutex);
+      for (Timer& timer : timers) timer.deadline = us + timer.period;
+      updateNextDeadline();
+    }
+    now.store(us);
+    realtimeOrigin = std::chrono::steady_clock::now();
+    realtimeOffset = us;
+  }
+
+  uint64_t pollCostMicros = 1;
+
+private:
+  struct Timer {
+    int id;
+    uint64_t period;
+    uint64_t deadline;
+    std::function<void()> callback;
+  };
+
+  Mode mode = Mode::Virtual;
+  std::atomic<uint64_t> now{0};
+  std::mutex timerMutex;
+  std::vector<Timer> timers;
+  int nextTimerId = 1;
+  std::atomic<uint64_t> nextDeadline{UINT64_MAX};
+  std::atomic<bool> firing{false};
+
+  static bool& timerContext() {
+    static thread_local bool context = false;
+    return context;
+  }
+
+  void updateNextDeadline() {
+    uint64_t earliest = UINT64_MAX;
+    for (const Timer& timer : timers)
+      if (timer.deadline < earliest) earliest = timer.deadline;
+    nextDeadline.store(earliest);
+  }
+
+  // Runs every callback due at or before `target`, in deadline order, and
+  // moves the clock to `target` (returns false when nested in a callback,
+  // e.g. for bus time spent by a woken thread)
+  bool fireTimers(uint64_t target) {
+    bool expected = false;
+    if (!firing.compare_exchange_strong(expected, true)) return false;
+    while (true) {
+      std::function<void()> callback;
+      {
+        std::lock_guard<std::mutex> lock(timerMutex);
+        Timer* due = nullptr;
+        for (Timer& timer : timers)
+          if (timer.deadline <= target && (!due || timer.deadline < due->deadline)) due = &timer;
+        if (!due) break;
+        if (mode == Mode::Virtual && due->deadline > now.load()) now.store(due->deadline);
+        due->deadline += due->period;
+        callback = due->callback;
+        updateNextDeadline();
+      }
+      timerContext() = true;
+      callback();
+      timerContext() = false;
+    }
+    if (mode == Mode::Virtual && target > now.load()) now.store(target);
+    firing.store(false);
+    return true;
+  }
+  std::chrono::steady_clock::time_point realtimeOrigin = std::chrono::steady_clock::now();
+  uint64_t realtimeOffset = 0;
+};
+
+inline VirtualClock virtualClock;
+
+} // namespace shim
@@ -0,0 +1,110 @@
+// Host implementation of the Arduino String class.
+//
+// Like the Arduino core it keeps a heap buffer for every non-empty string
+// (no small-string optimisation), so heap traffic measured on the host
+// matches what the firmware does.
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+#include "HostHeap.h"
+
+class String {
+public:
+  String(const char* cstr = "") { copy(cstr, strlen(cstr)); }
+  String(const String& other) { copy(other.buffer, other.len); }
+  String(String&& other) noexcept : buffer(other.buffer), capacity(other.capacity), len(other.len) {
+    other.buffer = nullptr;
+    other.capacity = other.len = 0;
+  }
+  explicit String(char c) { char s[2] = {c, '\0'}; copy(s, 1); }
+  explicit String(unsigned char value, unsigned char base = 10) : String((unsigned long)value, base) {}
+  explicit String(int value, unsigned char base = 10) : String((long)value, base) {}
+  explicit String(unsigned int value, unsigned char base = 10) : String((unsigned long)value, base) {}
+  explicit String(long value, unsigned char base = 10) {
+    char s[34];
+    if (base == 16) snprintf(s, sizeof(s), "%lx", value);
+    else snprintf(s, sizeof(s), "%ld", value);
+    copy(s, strlen(s));
+  }
+  explicit String(unsigned long value, unsigned char base = 10) {
+    char s[34];
+    if (base == 16) snprintf(s, sizeof(s), "%lx", value);
+    else snprintf(s, sizeof(s), "%lu", value);
+    copy(s, strlen(s));
+  }
+  explicit String(float value, unsigned char decimalPlaces = 2) : String((double)value, decimalPlaces) {}
+  explicit String(double value, unsigned char decimalPlaces = 2) {
+    char s[64];
+    snprintf(s, sizeof(s), "%.*f", (int)decimalPlaces, value);
+    copy(s, strlen(s));
+  }
+  ~String() { shim::heapFree(buffer); }
+
+  String& operator=(const String& other) {
+    if (this != &other) copy(other.buffer, other.len);
+    return *this;
+  }
+  String& operator=(String&& other) noexcept {
+    if (this != &other) {
+      shim::heapFree(buffer);
+      buffer = other.buffer; capacity = other.capacity; len = other.len;
+      other.buffer = nullptr;
+      other.capacity = other.len = 0;
+    }
+    return *this;
+  }
+  String& operator=(const char* cstr) { copy(cstr, strlen(cstr)); return *this; }
+
+  String& operator+=(const String& rhs) { concat(rhs.c_str(), rhs.len); return *this; }
+  String& operator+=(const char* rhs) { concat(rhs, strlen(rhs)); return *this; }
+  String& operator+=(char c) { concat(&c, 1); return *this; }
+
+  friend String operator+(const String& lhs, const String& rhs) { String s(lhs); s += rhs; return s; }
+  friend String operator+(const String& lhs, const char* rhs) { String s(lhs); s += rhs; return s; }
+  friend String operator+(const char* lhs, const String& rhs) { String s(lhs); s += rhs; return s; }
+  friend String operator+(String&& lhs, const String& rhs) { lhs += rhs; return std::move(lhs); }
+  friend String operator+(String&& lhs, const char* rhs) { lhs += rhs; return std::move(lhs); }
+
+  bool operator==(const char* cstr) const { return strcmp(c_str(), cstr) == 0; }
+  bool operator==(const String& rhs) const { return len == rhs.len && strcmp(c_str(), rhs.c_str()) == 0; }
+
+  const char* c_str() const { return buffer ? buffer : ""; }
+  unsigned int length() const { return len; }
+  bool reserve(unsigned int size) {
+    if (buffer && capacity >= size) return true;
+    char* grown = (char*)shim::heapRealloc(buffer, size + 1);
+    if (!grown) return false;
+    if (!buffer) grown[0] = '\0';
+    buffer = grown;
+    capacity = size;
+    return true;
+  }
+
+private:
+  char* buffer = nullptr;
+  unsigned int capacity = 0;
+  unsigned int len = 0;
+
+  void copy(const char* cstr, unsigned int length) {
+    if (length == 0) {
+      if (buffer) buffer[0] = '\0';
+      len = 0;
+      return;
+    }
+    if (!reserve(length)) { len = 0; return; }
+    memcpy(buffer, cstr, length);
+    buffer[length] = '\0';
+    len = length;
+  }
+
+  void concat(const char* cstr, unsigned int length) {
+    if (length == 0) return;
+    if (!reserve(len + length)) return;
+    memcpy(buffer + len, cstr, length);
+    len += length;
+    buffer[len] = '\0';
+  }
+};
@@ -0,0 +1,40 @@
+// Host stand-in for the Portenta WiFi library. The link state is controlled
+// by the host tool through shim::network (e.g. to simulate outages).
+#pragma once
+
+#include <Arduino.h>
+
+#define WL_IDLE_STATUS    0
+#define WL_CONNECTED      3
+#define WL_CONNECT_FAILED 4
+#define WL_DISCONNECTED   6
+
+namespace shim {
+struct Network {
+  bool available = true;
+};
+inline Network network;
+} // namespace shim
+
+class Client {
+public:
+  virtual ~Client() = default;
+};
+
+class WiFiClient : public Client {};
+
+class WiFiClass {
+public:
+  int begin(const char* ssid, const char* passphrase) {
+    (void)ssid; (void)passphrase;
+    joined = shim::network.available;
+    return status();
+  }
+  int disconnect() { joined = false; return WL_DISCONNECTED; }
+  uint8_t status() { return joined && shim::network.available ? WL_CONNECTED : WL_DISCONNECTED; }
+
+private:
+  bool joined = false;
+};
+
+inline WiFiClass WiFi;
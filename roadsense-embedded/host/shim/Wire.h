@@ -0,0 +1,117 @@
+// Host stand-in for the Arduino Wire (I2C) library.
+//
+// Devices are attached per 7-bit address. Every transaction is counted and
+// charged to the virtual clock at the configured bus speed (9 clocks per
+// byte plus start/address overhead), so bus cost shows up in timings.
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+
+namespace shim {
+
+// A device on the emulated bus (see shim MPU6050)
+class I2CDevice {
+public:
+  virtual ~I2CDevice() = default;
+  virtual void writeRegisters(uint8_t reg, const uint8_t* data, size_t size) = 0;
+  virtual void readRegisters(uint8_t reg, uint8_t* data, size_t size) = 0;
+};
+
+struct I2CStats {
+  uint64_t transactions = 0;
+  uint64_t bytes = 0;
+};
+
+} // namespace shim
+
+class TwoWire {
+public:
+  void begin() {}
+  void end() {}
+  void setClock(uint32_t frequency) { clockHz = frequency; }
+  uint32_t getClock() const { return clockHz; }
+
+  void attach(uint8_t address, shim::I2CDevice* device) { devices[address] = device; }
+
+  void beginTransmission(uint8_t address) {
+    txAddress = address;
+    txSize = 0;
+  }
+  size_t write(uint8_t data) {
+    if (txSize >= sizeof(txBuffer)) return 0;
+    txBuffer[txSize++] = data;
+    return 1;
+  }
+  size_t write(const uint8_t* data, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*data++);
+    return n;
+  }
+  uint8_t endTransmission(bool stopBit = true) {
+    (void)stopBit;
+    shim::I2CDevice* device = find(txAddress);
+    chargeBus(txSize);
+    if (!device) return 2; // NACK on address
+    if (txSize > 1) device->writeRegisters(txBuffer[0], txBuffer + 1, txSize - 1);
+    registerPointer = txSize > 0 ? txBuffer[0] : registerPointer;
+    return 0;
+  }
+  uint8_t requestFrom(uint8_t address, size_t quantity, bool stopBit = true) {
+    (void)stopBit;
+    shim::I2CDevice* device = find(address);
+    if (quantity > sizeof(rxBuffer)) quantity = sizeof(rxBuffer);
+    chargeBus(quantity);
+    rxSize = rxIndex = 0;
+    if (!device) return 0;
+    device->readRegisters(registerPointer, rxBuffer, quantity);
+    rxSize = quantity;
+    return (uint8_t)quantity;
+  }
+  int available() { return (int)(rxSize - rxIndex); }
+  int read() { return rxIndex < rxSize ? rxBuffer[rxIndex++] : -1; }
+
+  // Register-level helpers used by shim device drivers
+  void writeRegisters(uint8_t address, uint8_t reg, const uint8_t* data, size_t size) {
+    beginTransmission(address);
+    write(reg);
+    write(data, size);
+    endTransmission();
+  }
+  size_t readRegisters(uint8_t address, uint8_t reg, uint8_t* data, size_t size) {
+    beginTransmission(address);
+    write(reg);
+    endTransmission(false);
+    size_t n = requestFrom(address, size);
+    for (size_t i = 0; i < n; i++) data[i] = (uint8_t)read();
+    return n;
+  }
+
+  shim::I2CStats stats;
+
+private:
+  std::map<uint8_t, shim::I2CDevice*> devices;
+  uint32_t clockHz = 100000;
+  uint8_t txAddress = 0;
+  uint8_t txBuffer[256];
+  size_t txSize = 0;
+  uint8_t rxBuffer[256];
+  size_t rxSize = 0;
+  size_t rxIndex = 0;
+  uint8_t registerPointer = 0;
+
+  shim::I2CDevice* find(uint8_t address) {
+    auto it = devices.find(address);
+    return it == devices.end() ? nullptr : it->second;
+  }
+
+  // One transfer = start + address byte + payload bytes, 9 clocks per byte
+  void chargeBus(size_t payloadBytes) {
+    stats.transactions++;
+    stats.bytes += payloadBytes;
+    uint64_t clocks = 9ULL * (payloadBytes + 1) + 2;
+    shim::virtualClock.advanceMicros((clocks * 1000000ULL + clockHz - 1) / clockHz);
+  }
+};
+
+inline TwoWire Wire;
@@ -0,0 +1,7 @@
+// Host stand-in for <mbed.h>: pulls in the shimmed mbed OS pieces.
+#pragma once
+
+#include <Arduino.h>
+#include "FlashIAP.h"
+#include "Ticker.h"
+#include "rtos.h"
@@ -0,0 +1,182 @@
+// Host stand-in for the mbed OS RTOS API (Thread, Mutex, EventFlags,
+// ThisThread). Threads are real host threads; sleeping advances the shim
+// virtual clock.
+//
+// Thread flags set from a timer callback (interrupt context, see
+// VirtualClock.h) emulate preemption: the woken thread runs until it waits
+// for flags again before the interrupted thread continues, as a
+// higher-priority thread would on the device. Waiting on EventFlags lets
+// virtual time pass until the next timer interrupt.
+#pragma once
+
+#include <Arduino.h>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+typedef enum {
+  osPriorityIdle = 1,
+  osPriorityLow = 8,
+  osPriorityBelowNormal = 16,
+  osPriorityNormal = 24,
+  osPriorityAboveNormal = 32,
+  osPriorityHigh = 40,
+  osPriorityRealtime = 48,
+} osPriority;
+
+typedef int32_t osStatus;
+#define osOK 0
+#define osErrorResource -3
+
+#define OS_STACK_SIZE 4096
+
+#define osWaitForever 0xFFFFFFFFU
+#define osFlagsError 0x80000000U
+#define osFlagsErrorTimeout 0xFFFFFFFEU
+
+namespace rtos {
+
+class Thread;
+
+namespace ThisThread {
+uint32_t flags_wait_any(uint32_t flags, bool clear = true);
+}
+
+class Thread {
+public:
+  Thread(osPriority priority = osPriorityNormal, uint32_t stack_size = OS_STACK_SIZE,
+         unsigned char* stack_mem = nullptr, const char* name = nullptr)
+      : threadPriority(priority) {
+    (void)stack_size; (void)stack_mem; (void)name;
+  }
+  ~Thread() {
+    if (worker.joinable()) worker.detach();
+  }
+
+  osStatus start(std::function<void()> task) {
+    if (worker.joinable()) return osErrorResource;
+    worker = std::thread([this, state = flags, task = std::move(task)] {
+      current() = this;
+      task();
+    });
+    return osOK;
+  }
+  osStatus join() {
+    if (worker.joinable()) worker.join();
+    return osOK;
+  }
+  osPriority get_priority() const { return threadPriority; }
+  osStatus set_priority(osPriority priority) { threadPriority = priority; return osOK; }
+
+  uint32_t flags_set(uint32_t flags) {
+    FlagsState& state = *this->flags;
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.flags |= flags;
+    uint32_t result = state.flags;
+    state.changed.notify_all();
+    // From interrupt context: let the woken thread run to its next wait
+    if (shim::VirtualClock::inTimerCallback() && current() != this) {
+      state.changed.wait(lock, [&state] { return state.waiting && !(state.flags & state.waitFlags); });
+    }
+    return result;
+  }
+
+  // The rtos::Thread running the caller (nullptr on the host main thread)
+  static Thread*& current() {
+    static thread_local Thread* thread = nullptr;
+    return thread;
+  }
+
+private:
+  std::thread worker;
+  osPriority threadPriority;
+
+  // Shared with the running thread, which may still wait on it after the
+  // Thread object is gone (detached at destruction)
+  struct FlagsState {
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint32_t flags = 0;
+    uint32_t waitFlags = 0;
+    bool waiting = false;
+  };
+  std::shared_ptr<FlagsState> flags = std::make_shared<FlagsState>();
+
+  friend uint32_t ThisThread::flags_wait_any(uint32_t flags, bool clear);
+};
+
+class EventFlags {
+public:
+  uint32_t set(uint32_t flags) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return eventFlags |= flags;
+  }
+  uint32_t clear(uint32_t flags = 0x7fffffff) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t previous = eventFlags;
+    eventFlags &= ~flags;
+    return previous;
+  }
+  uint32_t get() const { return eventFlags; }
+
+  // Idles on the virtual clock until one of `flags` is set or the timeout expires
+  uint32_t wait_any(uint32_t flags, uint32_t millisec = osWaitForever, bool clearFlags = true) {
+    uint64_t limit = millisec == osWaitForever ? UINT64_MAX : shim::virtualClock.nowMicros() + millisec * 1000ULL;
+    while (true) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (eventFlags & flags) {
+          uint32_t result = eventFlags;
+          if (clearFlags) eventFlags &= ~flags;
+          return result;
+        }
+      }
+      if (shim::virtualClock.nowMicros() >= limit) return osFlagsErrorTimeout;
+      shim::virtualClock.idleUntil(limit);
+    }
+  }
+
+private:
+  std::mutex mutex;
+  uint32_t eventFlags = 0;
+};
+
+class Mutex {
+public:
+  osStatus lock() { mutex.lock(); return osOK; }
+  bool trylock() { return mutex.try_lock(); }
+  osStatus unlock() { mutex.unlock(); return osOK; }
+
+private:
+  std::mutex mutex;
+};
+
+namespace ThisThread {
+inline void sleep_for(uint32_t millisec) { delay(millisec); }
+template <typename Rep, typename Period>
+inline void sleep_for(std::chrono::duration<Rep, Period> duration) {
+  delay((unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+}
+inline void yield() { std::this_thread::yield(); }
+
+// Only rtos::Thread threads have thread flags
+inline uint32_t flags_wait_any(uint32_t flags, bool clear) {
+  Thread* thread = Thread::current();
+  if (!thread) return osFlagsError;
+  std::shared_ptr<Thread::FlagsState> state = thread->flags;
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->waiting = true;
+  state->waitFlags = flags;
+  state->changed.notify_all();
+  state->changed.wait(lock, [&state, flags] { return (state->flags & flags) != 0; });
+  state->waiting = false;
+  uint32_t result = state->flags;
+  if (clear) state->flags &= ~flags;
+  return result;
+}
+} // namespace ThisThread
+
+} // namespace rtos
@@ -0,0 +1,245 @@
+// Synthetic drive trace generator (see TraceReplay.h for the format).
+//
+// Simulates a car driving a straight road at a varying speed. The road has
+// sections of different roughness and random potholes at fixed positions,
+// so the same road driven at different speeds produces different (but
+// reproducible) accelerometer signals. The GPS emits $GNGGA, $GNRMC, $GNVTG
+// and $GPTXT like the DFRobot receiver at 9600 baud, or with --ubx UBX-NAV-PVT
+// per fix and UBX-MON-HW once per second at UBX_BAUD, like a u-blox receiver
+// configured by UbxParser::begin().
+//
+// Usage: tracegen [--duration S] [--rate HZ] [--speed KMH] [--gps-rate HZ] [--ubx] [--seed N] [-o FILE]
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "../lib/UbxParser.h"
+#include "TraceReplay.h"
+
+namespace {
+
+uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+
+double uniform() {
+  rngState ^= rngState >> 12;
+  rngState ^= rngState << 25;
+  rngState ^= rngState >> 27;
+  return ((rngState * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double gaussian() {
+  double u1 = uniform() + 1e-12;
+  double u2 = uniform();
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+struct Pothole {
+  double position; // [m]
+  double depth;    // relative severity
+};
+
+// Road with 100 m sections of constant roughness and potholes
+class Road {
+public:
+  explicit Road(double length) {
+    for (double d = 0; d < length + 100.0; d += 100.0) roughness.push_back(0.2 + 1.3 * uniform());
+    for (double d = 20.0 * uniform(); d < length; d += 10.0 + 60.0 * uniform())
+      potholes.push_back({d, 0.5 + uniform()});
+  }
+  double roughnessAt(double distance) const { return roughness[(size_t)(distance / 100.0)]; }
+
+  std::vector<double> roughness;
+  std::vector<Pothole> potholes;
+};
+
+void sentence(std::vector<trace::Record>& out, uint64_t time, const char* body) {
+  char line[128];
+  snprintf(line, sizeof(line), "$%s*%02X", body, trace::nmeaChecksum(body));
+  trace::Record record;
+  record.type = 'G';
+  record.time = time;
+  record.sentence = line;
+  out.push_back(record);
+}
+
+void frame(std::vector<trace::Record>& out, uint64_t time, const std::string& ubx) {
+  trace::Record record;
+  record.type = 'U';
+  record.time = time;
+  record.frame = ubx;
+  out.push_back(record);
+}
+
+// Bytes a record occupies on the GPS UART
+size_t wireSize(const trace::Record& record) {
+  return record.type == 'U' ? record.frame.size() : record.sentence.size() + 2;
+}
+
+void formatCoordinate(char* out, size_t size, double value, int degreeDigits) {
+  double absolute = fabs(value);
+  int degrees = (int)absolute;
+  double minutes = (absolute - degrees) * 60.0;
+  snprintf(out, size, "%0*d%08.5f", degreeDigits, degrees, minutes);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  double duration = 600.0;
+  double rate = 1000.0;
+  double cruiseKmph = 30.0;
+  double gpsRate = 1.0;
+  bool ubx = false;
+  const char* outPath = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--duration") && i + 1 < argc) duration = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--rate") && i + 1 < argc) rate = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--speed") && i + 1 < argc) cruiseKmph = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--gps-rate") && i + 1 < argc) gpsRate = atof(argv[++i]);
+    else if (!strcmp(argv[i], "--ubx")) ubx = true;
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) rngState ^= strtoull(argv[++i], nullptr, 10) * 0xBF58476D1CE4E5B9ULL;
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc) outPath = argv[++i];
+    else {
+      fprintf(stderr, "usage: %s [--duration S] [--rate HZ] [--speed KMH] [--gps-rate HZ] [--ubx] [--seed N] [-o FILE]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  FILE* out = outPath ? fopen(outPath, "w") : stdout;
+  if (!out) {
+    perror(outPath);
+    return 1;
+  }
+  trace::TraceWriter writer(out);
+  const unsigned long gpsBaud = ubx ? UBX_BAUD : 9600;
+
+  const double heading = 30.0 * M_PI / 180.0;
+  const double metersPerDegree = 111139.0;
+  const uint64_t samplePeriod = (uint64_t)(1e6 / rate);
+  const uint64_t fixPeriod = (uint64_t)(1e6 / gpsRate);
+  const uint64_t end = (uint64_t)(duration * 1e6);
+  // 2024-12-02 09:53:47 UTC
+  const long startSecondOfDay = 9 * 3600 + 53 * 60 + 47;
+
+  Road road(duration * cruiseKmph / 3.6 * 1.5);
+  size_t nextPothole = 0;
+  double lastPotholeHit = -1.0, lastPotholeDepth = 0.0;
+
+  double lat = 46.012015, lng = 8.961104;
+  double distance = 0.0;
+  double speed = 0.0; // [m/s]
+  uint64_t nextFix = 0;
+  uint64_t nextHardwareStatus = 0;
+  std::vector<trace::Record> pendingSentences;
+  size_t sentenceIndex = 0;
+
+  for (uint64_t t = 0; t < end; t += samplePeriod) {
+    double seconds = t / 1e6;
+    // Speed: cruise with slow variations
+    speed = cruiseKmph / 3.6 * (1.0 + 0.2 * sin(2.0 * M_PI * seconds / 90.0));
+    double step = speed * samplePeriod / 1e6;
+    distance += step;
+    lat += step * cos(heading) / metersPerDegree;
+    lng += step * sin(heading) / (metersPerDegree * cos(lat * M_PI / 180.0));
+
+    // GPS fix: queue the sentences of this epoch, one after the other on the wire
+    if (t >= nextFix) {
+      long secondOfDay = startSecondOfDay + (long)(t / 1000000);
+      int millisecond = (int)((t / 1000) % 1000);
+      char time[16], latStr[32], lngStr[32], body[128];
+      snprintf(time, sizeof(time), "%02ld%02ld%02ld.%03d", secondOfDay / 3600 % 24, secondOfDay / 60 % 60, secondOfDay % 60, millisecond);
+      formatCoordinate(latStr, sizeof(latStr), lat, 2);
+      formatCoordinate(lngStr, sizeof(lngStr), lng, 3);
+      double knots = speed * 3.6 / 1.852;
+      double course = heading * 180.0 / M_PI;
+      double nmeaSpeed = speed * 3.6;
+
+      // Sentences of the previous epoch still on the wire stay queued
+      pendingSentences.erase(pendingSentences.begin(), pendingSentences.begin() + sentenceIndex);
+      sentenceIndex = 0;
+      size_t firstNew = pendingSentences.size();
+      uint64_t wire = firstNew ? pendingSentences.back().time : t + 50000; // receiver output latency
+      if (ubx) {
+        UbxNavPvt pvt = {};
+        pvt.iTOW = (uint32_t)((secondOfDay + 86400L) * 1000 + millisecond); // Monday
+        pvt.year = 2024;
+        pvt.month = 12;
+        pvt.day = 2;
+        pvt.hour = secondOfDay / 3600 % 24;
+        pvt.min = secondOfDay / 60 % 60;
+        pvt.sec = secondOfDay % 60;
+        pvt.valid = 0x07;
+        pvt.tAcc = 30;
+        pvt.nano = millisecond * 1000000;
+        pvt.fixType = 3;
+        pvt.flags = 0x01;
+        pvt.numSV = 11;
+        pvt.lon = (int32_t)lround(lng * 1e7);
+        pvt.lat = (int32_t)lround(lat * 1e7);
+        pvt.height = 367800;
+        pvt.hMSL = 320900;
+        pvt.hAcc = 2500;
+        pvt.vAcc = 4000;
+        pvt.velN = (int32_t)lround(speed * cos(heading) * 1000.0);
+        pvt.velE = (int32_t)lround(speed * sin(heading) * 1000.0);
+        pvt.gSpeed = (int32_t)lround(speed * 1000.0);
+        pvt.headMot = (int32_t)lround(course * 1e5);
+        pvt.sAcc = 300;
+        pvt.headAcc = 500000;
+        pvt.pDOP = 120;
+        frame(pendingSentences, t, trace::ubxFrame(UBX_CLASS_NAV, UBX_NAV_PVT, &pvt, sizeof(pvt)));
+        if (t >= nextHardwareStatus) {
+          uint8_t hardware[60] = {};
+          hardware[UBX_MON_HW_ASTATUS] = 2; // OK
+          hardware[UBX_MON_HW_ASTATUS + 1] = 1; // Antenna powered
+          frame(pendingSentences, t, trace::ubxFrame(UBX_CLASS_MON, UBX_MON_HW, hardware, sizeof(hardware)));
+          nextHardwareStatus += 1000000;
+        }
+      } else {
+        snprintf(body, sizeof(body), "GNGGA,%s,%s,N,%s,E,1,11,1.2,320.9,M,46.9,M,,", time, latStr, lngStr);
+        sentence(pendingSentences, t, body);
+        snprintf(body, sizeof(body), "GNRMC,%s,A,%s,N,%s,E,%.2f,%.2f,021224,,,A,V", time, latStr, lngStr, knots, course);
+        sentence(pendingSentences, t, body);
+        snprintf(body, sizeof(body), "GNVTG,%.2f,T,,M,%.2f,N,%.2f,K,A", course, knots, nmeaSpeed);
+        sentence(pendingSentences, t, body);
+        sentence(pendingSentences, t, "GPTXT,01,01,01,ANTENNA OK");
+      }
+
+      for (size_t i = firstNew; i < pendingSentences.size(); i++) {
+        if (i > 0) wire += wireSize(pendingSentences[i - 1]) * 10000000ULL / gpsBaud;
+        pendingSentences[i].time = wire;
+      }
+      nextFix += fixPeriod;
+    }
+    while (sentenceIndex < pendingSentences.size() && pendingSentences[sentenceIndex].time <= t) {
+      const trace::Record& record = pendingSentences[sentenceIndex];
+      if (record.type == 'U') writer.frame(record.time, record.frame);
+      else writer.sentence(record.time, record.sentence.c_str());
+      sentenceIndex++;
+    }
+
+    // Vertical acceleration: road roughness and potholes scale with speed
+    double speedFactor = speed / (30.0 / 3.6);
+    double vibration = road.roughnessAt(distance) * 900.0 * speedFactor * gaussian();
+    while (nextPothole < road.potholes.size() && road.potholes[nextPothole].position <= distance) {
+      lastPotholeHit = seconds;
+      lastPotholeDepth = road.potholes[nextPothole].depth;
+      nextPothole++;
+    }
+    if (lastPotholeHit >= 0.0) {
+      double tau = seconds - lastPotholeHit;
+      vibration += lastPotholeDepth * 9000.0 * speedFactor * exp(-tau / 0.04) * sin(2.0 * M_PI * 12.0 * tau);
+    }
+    double z = 16384.0 + vibration + 300.0 * gaussian();
+    if (z > 32767.0) z = 32767.0;
+    if (z < -32768.0) z = -32768.0;
+    writer.accel(t, (int16_t)z);
+  }
+
+  if (out != stdout) fclose(out);
+  return 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// Minimal micro-benchmark harness shared by the firmware (cycle counts via
+// the DWT, see CycleCounter.h) and the host build (nanoseconds, plus heap
+// allocations counted by the shim).
+
+#include <Arduino.h>
+#include "CycleCounter.h"
+
+#ifdef ROADSENSE_HOST
+#include <HostHeap.h>
+#endif
+
+struct BenchResult {
+  const char* name;
+  uint32_t iterations;
+  uint64_t ticks;        // total ticks for all iterations
+  int64_t allocations;   // heap allocations for all iterations (-1 if unknown)
+};
+
+// Keeps the compiler from optimizing away a benchmarked value
+template <typename T>
+inline void benchKeep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Hides a value from the optimizer, for lengths that are only known at run
+// time in the firmware
+template <typename T>
+inline T benchOpaque(T value) {
+  asm volatile("" : "+r"(value));
+  return value;
+}
+
+inline int64_t benchAllocationCount() {
+#ifdef ROADSENSE_HOST
+  return (int64_t)shim::heapStats.allocations.load();
+#else
+  return -1;
+#endif
+}
+
+// Runs body(i) for i in [0, iterations) after a short warm-up
+template <typename Body>
+BenchResult bench(const char* name, uint32_t iterations, Body body) {
+  for (uint32_t i = 0; i < iterations / 10 + 1; i++) body(i);
+
+  int64_t allocationsBefore = benchAllocationCount();
+  CycleCounter::Ticks start = CycleCounter::now();
+  for (uint32_t i = 0; i < iterations; i++) body(i);
+  CycleCounter::Ticks elapsed = CycleCounter::now() - start;
+  int64_t allocationsAfter = benchAllocationCount();
+
+  return {name, iterations, (uint64_t)elapsed, allocationsBefore < 0 ? -1 : allocationsAfter - allocationsBefore};
+}
+
+inline void printBenchHeader(Print& out) {
+  out.println(CycleCounter::countsCycles ? "benchmark                        cycles/op     ns/op  allocs/op"
+                                         : "benchmark                            ns/op  allocs/op");
+}
+
+inline void printBenchResult(Print& out, const BenchResult& result) {
+  char line[96];
+  double ticksPerOp = (double)result.ticks / result.iterations;
+  double nsPerOp = (double)CycleCounter::ticksToNanos(result.ticks) / result.iterations;
+  char allocations[16];
+  if (result.allocations < 0) snprintf(allocations, sizeof(allocations), "%9s", "n/a");
+  else snprintf(allocations, sizeof(allocations), "%9.2f", (double)result.allocations / result.iterations);
+
+  if (CycleCounter::countsCycles)
+    snprintf(line, sizeof(line), "%-32s %9.1f %9.1f  %s", result.name, ticksPerOp, nsPerOp, allocations);
+  else
+    snprintf(line, sizeof(line), "%-32s %9.1f  %s", result.name, nsPerOp, allocations);
+  out.println(line);
+}
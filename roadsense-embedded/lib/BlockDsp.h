@@ -0,0 +1,239 @@
+#pragma once
+
+// Block-processing kernels for frames of int16 accelerometer samples.
+//
+// The kernels run on CMSIS-DSP (q15) on the Cortex-M7 when the library is
+// available (arm_math.h, e.g. the Arduino_CMSIS-DSP library), on SSE2 on x86
+// hosts, and as plain loops everywhere else. All variants return the same
+// results:
+//   dspMaxAbsDifference  max |x[i] - x[i-1]|, saturated at INT16_MAX
+//   dspMinMax            minimum and maximum
+//   dspSum               sum of x
+//   dspSumSquares        sum of x^2 (x must not contain INT16_MIN)
+//   dspCountAbsAbove     number of |x| > threshold (x must not contain INT16_MIN)
+//   dspOffset            y = x - offset, for differences that fit int16
+// The CMSIS-DSP variants work through a stack buffer of DSP_FRAME_SIZE
+// samples, so longer inputs are processed in chunks.
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_MBED) && defined(__has_include)
+#if __has_include(<arm_math.h>)
+#define DSP_CMSIS 1
+#include <arm_math.h>
+#endif
+#endif
+#if !defined(DSP_CMSIS) && defined(__SSE2__)
+#define DSP_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define DSP_FRAME_SIZE 64 // Samples per frame (and CMSIS-DSP chunk)
+
+#ifdef DSP_SSE2
+// Largest of the eight lanes
+inline int16_t dspHorizontalMax(__m128i v) {
+  v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  v = _mm_max_epi16(v, _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (int16_t)_mm_cvtsi128_si32(v);
+}
+
+inline int16_t dspHorizontalMin(__m128i v) {
+  v = _mm_min_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_min_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  v = _mm_min_epi16(v, _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return (int16_t)_mm_cvtsi128_si32(v);
+}
+#endif
+
+inline int16_t dspSaturate(int32_t value) {
+  return value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : (int16_t)value);
+}
+
+// Largest absolute difference between consecutive samples, starting from
+// `previous` (the sample before x[0]); differences saturate at INT16_MAX
+inline int16_t dspMaxAbsDifference(const int16_t* x, size_t n, int16_t previous) {
+  if (n == 0) return 0;
+#if defined(DSP_CMSIS)
+  q15_t differences[DSP_FRAME_SIZE];
+  q15_t peak = 0;
+  for (size_t start = 0; start < n; start += DSP_FRAME_SIZE) {
+    size_t length = n - start < DSP_FRAME_SIZE ? n - start : DSP_FRAME_SIZE;
+    const int16_t* frame = x + start;
+    int16_t before = start == 0 ? previous : x[start - 1];
+    differences[0] = dspSaturate((int32_t)frame[0] - before);
+    arm_sub_q15(frame + 1, frame, differences + 1, length - 1);
+    arm_abs_q15(differences, differences, length);
+    q15_t framePeak;
+    uint32_t index;
+    arm_max_q15(differences, length, &framePeak, &index);
+    if (framePeak > peak) peak = framePeak;
+  }
+  return peak;
+#elif defined(DSP_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  int16_t peak = dspSaturate((int32_t)x[0] - previous);
+  if (peak < 0) peak = peak == INT16_MIN ? INT16_MAX : -peak;
+  size_t i = 1;
+  __m128i peaks = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8) {
+    __m128i current = _mm_loadu_si128((const __m128i*)(x + i));
+    __m128i before = _mm_loadu_si128((const __m128i*)(x + i - 1));
+    __m128i difference = _mm_subs_epi16(current, before);
+    __m128i absolute = _mm_max_epi16(difference, _mm_subs_epi16(zero, difference));
+    peaks = _mm_max_epi16(peaks, absolute);
+  }
+  int16_t vectorPeak = dspHorizontalMax(peaks);
+  if (vectorPeak > peak) peak = vectorPeak;
+  for (; i < n; i++) {
+    int32_t difference = abs((int32_t)x[i] - x[i - 1]);
+    if (difference > INT16_MAX) difference = INT16_MAX;
+    if (difference > peak) peak = (int16_t)difference;
+  }
+  return peak;
+#else
+  int32_t peak = 0;
+  int32_t before = previous;
+  for (size_t i = 0; i < n; i++) {
+    int32_t difference = abs((int32_t)x[i] - before);
+    if (difference > peak) peak = difference;
+    before = x[i];
+  }
+  return peak > INT16_MAX ? INT16_MAX : (int16_t)peak;
+#endif
+}
+
+inline void dspMinMax(const int16_t* x, size_t n, int16_t& minimum, int16_t& maximum) {
+  minimum = INT16_MAX;
+  maximum = INT16_MIN;
+#if defined(DSP_CMSIS)
+  for (size_t start = 0; start < n; start += DSP_FRAME_SIZE) {
+    size_t length = n - start < DSP_FRAME_SIZE ? n - start : DSP_FRAME_SIZE;
+    q15_t frameMin, frameMax;
+    uint32_t index;
+    arm_min_q15(x + start, length, &frameMin, &index);
+    arm_max_q15(x + start, length, &frameMax, &index);
+    if (frameMin < minimum) minimum = frameMin;
+    if (frameMax > maximum) maximum = frameMax;
+  }
+#else
+  size_t i = 0;
+#ifdef DSP_SSE2
+  if (n >= 8) {
+    __m128i minimums = _mm_set1_epi16(INT16_MAX);
+    __m128i maximums = _mm_set1_epi16(INT16_MIN);
+    for (; i + 8 <= n; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+      minimums = _mm_min_epi16(minimums, v);
+      maximums = _mm_max_epi16(maximums, v);
+    }
+    minimum = dspHorizontalMin(minimums);
+    maximum = dspHorizontalMax(maximums);
+  }
+#endif
+  for (; i < n; i++) {
+    if (x[i] < minimum) minimum = x[i];
+    if (x[i] > maximum) maximum = x[i];
+  }
+#endif
+}
+
+inline int64_t dspSum(const int16_t* x, size_t n) {
+  int64_t sum = 0;
+  size_t i = 0;
+#if defined(DSP_CMSIS)
+  static const q15_t ones[DSP_FRAME_SIZE] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+  for (; i + DSP_FRAME_SIZE <= n; i += DSP_FRAME_SIZE) {
+    q63_t frameSum;
+    arm_dot_prod_q15(x + i, ones, DSP_FRAME_SIZE, &frameSum); // Integer sum of products
+    sum += frameSum;
+  }
+#elif defined(DSP_SSE2)
+  // Pairs of samples times one, summed in 32-bit lanes per 64-sample frame
+  const __m128i ones = _mm_set1_epi16(1);
+  while (i + 8 <= n) {
+    __m128i sums = _mm_setzero_si128();
+    size_t end = n - i >= DSP_FRAME_SIZE ? i + DSP_FRAME_SIZE : i + ((n - i) & ~(size_t)7);
+    for (; i < end; i += 8) sums = _mm_add_epi32(sums, _mm_madd_epi16(_mm_loadu_si128((const __m128i*)(x + i)), ones));
+    int32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, sums);
+    sum += (int64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+#endif
+  for (; i < n; i++) sum += x[i];
+  return sum;
+}
+
+inline uint64_t dspSumSquares(const int16_t* x, size_t n) {
+  uint64_t sum = 0;
+  size_t i = 0;
+#if defined(DSP_CMSIS)
+  for (; i < n; i += DSP_FRAME_SIZE) {
+    size_t length = n - i < DSP_FRAME_SIZE ? n - i : DSP_FRAME_SIZE;
+    q63_t frameSum;
+    arm_power_q15(x + i, length, &frameSum); // Integer sum of squares
+    sum += (uint64_t)frameSum;
+  }
+#elif defined(DSP_SSE2)
+  // Each pair sum x[j]^2 + x[j+1]^2 < 2^31 (no INT16_MIN), widened to 64 bits
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sums = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+    __m128i pairs = _mm_madd_epi16(v, v);
+    sums = _mm_add_epi64(sums, _mm_unpacklo_epi32(pairs, zero));
+    sums = _mm_add_epi64(sums, _mm_unpackhi_epi32(pairs, zero));
+  }
+  uint64_t lanes[2];
+  _mm_storeu_si128((__m128i*)lanes, sums);
+  sum = lanes[0] + lanes[1];
+#endif
+  for (; i < n; i++) sum += (uint32_t)((int32_t)x[i] * x[i]);
+  return sum;
+}
+
+inline uint32_t dspCountAbsAbove(const int16_t* x, size_t n, int16_t threshold) {
+  uint32_t count = 0;
+  size_t i = 0;
+#if defined(DSP_SSE2)
+  // Comparisons give -1 per lane; lanes count up to 8 per 64-sample frame
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i thresholds = _mm_set1_epi16(threshold);
+  while (i + 8 <= n) {
+    __m128i counts = _mm_setzero_si128();
+    size_t end = n - i >= DSP_FRAME_SIZE ? i + DSP_FRAME_SIZE : i + ((n - i) & ~(size_t)7);
+    for (; i < end; i += 8) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+      __m128i absolute = _mm_max_epi16(v, _mm_sub_epi16(zero, v));
+      counts = _mm_sub_epi16(counts, _mm_cmpgt_epi16(absolute, thresholds));
+    }
+    int16_t lanes[8];
+    _mm_storeu_si128((__m128i*)lanes, counts);
+    for (int lane = 0; lane < 8; lane++) count += lanes[lane];
+  }
+#endif
+  for (; i < n; i++) count += abs(x[i]) > threshold;
+  return count;
+}
+
+// y[i] = x[i] - offset; the caller ensures every difference fits int16
+inline void dspOffset(const int16_t* x, size_t n, int32_t offset, int16_t* y) {
+  size_t i = 0;
+#if defined(DSP_SSE2)
+  // Wrapping arithmetic is exact for differences that fit
+  const __m128i offsets = _mm_set1_epi16((int16_t)offset);
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(x + i));
+    _mm_storeu_si128((__m128i*)(y + i), _mm_sub_epi16(v, offsets));
+  }
+#elif defined(DSP_CMSIS)
+  if (offset > INT16_MIN && offset <= INT16_MAX) {
+    arm_offset_q15(x, (q15_t)-offset, y, n);
+    return;
+  }
+#endif
+  for (; i < n; i++) y[i] = (int16_t)((int32_t)x[i] - offset);
+}
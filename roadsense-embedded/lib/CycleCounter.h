@@ -0,0 +1,50 @@
+#pragma once
+
+// Timestamp source for benchmarks and profiling probes.
+// On the Portenta M7 this is the DWT cycle counter (ticks = CPU cycles),
+// on host builds the monotonic clock (ticks = nanoseconds).
+
+#include <stdint.h>
+
+#if defined(__ARM_ARCH_7EM__) && !defined(ROADSENSE_HOST)
+
+#include <mbed.h> // CMSIS core registers (DWT, CoreDebug)
+
+struct CycleCounter {
+  typedef uint32_t Ticks; // wraps after ~8.9 s at 480 MHz, only use differences
+  static constexpr bool countsCycles = true;
+
+  static void begin() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->LAR = 0xC5ACCE55; // unlock DWT (required on Cortex-M7)
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  }
+
+  static inline Ticks now() { return DWT->CYCCNT; }
+
+  static inline uint64_t ticksToNanos(uint64_t ticks) {
+    return ticks * 1000ULL / (SystemCoreClock / 1000000UL);
+  }
+};
+
+#else
+
+#include <time.h>
+
+struct CycleCounter {
+  typedef uint64_t Ticks;
+  static constexpr bool countsCycles = false;
+
+  static void begin() {}
+
+  static inline Ticks now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+  }
+
+  static inline uint64_t ticksToNanos(uint64_t ticks) { return ticks; }
+};
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+// Position between GPS fixes from the distance driven since the last fix.
+//
+// The receiver reports a fix every second (at best ten times a second),
+// while segments are a metre long, so several segments start between two
+// fixes. Rather than giving all of them the coordinates of the last fix,
+// the position is moved from the last fix along the heading of the last
+// two fixes by the distance integrated from the speed since then. Fixes
+// closer together than DEAD_RECKONING_MIN_BASELINE do not give a reliable
+// heading (standing, GPS noise) and keep the previous one; without a
+// heading the position stays at the last fix.
+
+#include <math.h>
+
+#define DEAD_RECKONING_MIN_BASELINE 3.0  // Shortest distance between fixes for a heading [m]
+#define DEAD_RECKONING_METERS_PER_DEGREE 111139.0 // Meridian metres per degree of latitude
+
+class DeadReckoning {
+  public:
+    // A new fix at odometer reading odometer [m]
+    void fix(double latitude, double longitude, double odometer) {
+      if (haveFix) {
+        double north = (latitude - fixLatitude) * DEAD_RECKONING_METERS_PER_DEGREE;
+        double east = (longitude - fixLongitude) * DEAD_RECKONING_METERS_PER_DEGREE * cos(latitude * M_PI / 180.0);
+        double baseline = sqrt(north * north + east * east);
+        if (baseline >= DEAD_RECKONING_MIN_BASELINE) {
+          // Degrees per metre driven along the heading
+          latitudePerMeter = north / baseline / DEAD_RECKONING_METERS_PER_DEGREE;
+          longitudePerMeter = east / baseline / (DEAD_RECKONING_METERS_PER_DEGREE * cos(latitude * M_PI / 180.0));
+          haveHeading = true;
+        }
+      }
+      fixLatitude = latitude;
+      fixLongitude = longitude;
+      fixOdometer = odometer;
+      haveFix = true;
+    }
+
+    // Position at odometer reading odometer [m]
+    void position(double odometer, double& latitude, double& longitude) const {
+      double driven = odometer - fixOdometer;
+      if (!haveHeading || driven <= 0.0) driven = 0.0;
+      latitude = fixLatitude + driven * latitudePerMeter;
+      longitude = fixLongitude + driven * longitudePerMeter;
+    }
+
+  private:
+    double fixLatitude = 0.0;
+    double fixLongitude = 0.0;
+    double fixOdometer = 0.0;
+    double latitudePerMeter = 0.0;
+    double longitudePerMeter = 0.0;
+    bool haveFix = false;
+    bool haveHeading = false;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+// Quantization of the segment metric with a breakpoint table.
+//
+// quantizeWithThresholds() maps a value to the byte q such that
+// thresholds[q - 1] <= value < thresholds[q], by a branch-free binary search
+// over the 255 thresholds (8 compares, no divide). The table is built at
+// calibration time:
+// - equalizedThresholds() from the distribution of the metric observed
+//   during calibration (a PeakHistogram): every byte value gets the same
+//   share of it, so the 8 bits are used in full however skewed the
+//   distribution is
+// - linearThresholds() from a min/max range: the same bytes as
+//   RoadQualifier::quantifyToByte()
+//
+// PeakHistogram counts values in log-spaced bins, exact below 64 and with
+// 32 bins per octave above (3% wide), so its size does not depend on the
+// calibration time. When a bin is full, all counts are halved (rounding
+// up, so no value seen disappears): the shape, which is all the thresholds
+// need, stays while the bins make room.
+
+#include <Arduino.h>
+
+#define QUANTIZER_THRESHOLDS 255
+#define PEAK_HISTOGRAM_SUB_BITS 5 // 2^5 bins per octave
+#define PEAK_HISTOGRAM_BINS (2 * (1 << PEAK_HISTOGRAM_SUB_BITS) + (16 - PEAK_HISTOGRAM_SUB_BITS - 1) * (1 << PEAK_HISTOGRAM_SUB_BITS))
+
+inline uint8_t quantizeWithThresholds(const uint16_t (&thresholds)[QUANTIZER_THRESHOLDS], int32_t value) {
+  if (value < 0) value = 0;
+  uint32_t q = 0;
+  for (uint32_t step = 128; step > 0; step >>= 1) {
+    q += (uint32_t)(value >= (int32_t)thresholds[q + step - 1]) * step;
+  }
+  return (uint8_t)q;
+}
+
+// Thresholds that reproduce quantifyToByte(value, minValue, maxValue)
+inline void linearThresholds(uint16_t (&thresholds)[QUANTIZER_THRESHOLDS], int32_t minValue, int32_t maxValue) {
+  if (maxValue <= minValue) maxValue = minValue + 1;
+  uint32_t range = (uint32_t)(maxValue - minValue);
+  for (uint32_t i = 0; i < QUANTIZER_THRESHOLDS; i++) {
+    // Smallest value quantifyToByte() rounds to i + 1 or more
+    uint64_t offset = ((uint64_t)(i + 1) * range - range / 2 + 254) / 255;
+    uint64_t threshold = (uint64_t)minValue + offset;
+    thresholds[i] = threshold > UINT16_MAX ? UINT16_MAX : (uint16_t)threshold;
+  }
+}
+
+class PeakHistogram {
+  public:
+    void reset() {
+      for (size_t i = 0; i < PEAK_HISTOGRAM_BINS; i++) counts[i] = 0;
+      total = 0;
+    }
+
+    void add(int32_t value) {
+      size_t bin = binOf(value < 0 ? 0 : (value > UINT16_MAX ? UINT16_MAX : (uint32_t)value));
+      if (counts[bin] == UINT16_MAX) halve();
+      counts[bin]++;
+      total++;
+    }
+
+    uint32_t count() const { return total; }
+
+    // Thresholds at the quantiles i / 256 of the values, interpolated within
+    // bins (returns false without values)
+    bool equalizedThresholds(uint16_t (&thresholds)[QUANTIZER_THRESHOLDS]) const {
+      if (total == 0) return false;
+      size_t bin = 0;
+      uint32_t below = 0; // Values in the bins before `bin`
+      for (uint32_t i = 0; i < QUANTIZER_THRESHOLDS; i++) {
+        double rank = (double)(i + 1) * total / (QUANTIZER_THRESHOLDS + 1);
+        while (below + counts[bin] < rank) below += counts[bin++];
+        uint32_t low = lowerBound(bin), width = lowerBound(bin + 1) - low;
+        double threshold = low + (rank - below) / counts[bin] * width;
+        thresholds[i] = threshold >= UINT16_MAX ? UINT16_MAX : (uint16_t)ceil(threshold);
+      }
+      return true;
+    }
+
+  private:
+    static const uint32_t SUB_BINS = 1 << PEAK_HISTOGRAM_SUB_BITS;
+    uint16_t counts[PEAK_HISTOGRAM_BINS];
+    uint32_t total = 0;
+
+    void halve() {
+      total = 0;
+      for (size_t i = 0; i < PEAK_HISTOGRAM_BINS; i++) {
+        counts[i] = (uint16_t)((counts[i] + 1u) / 2);
+        total += counts[i];
+      }
+    }
+
+    static uint32_t highestBit(uint32_t value) {
+      uint32_t bit = 0;
+      while (value >>= 1) bit++;
+      return bit;
+    }
+
+    static size_t binOf(uint32_t value) {
+      if (value < 2 * SUB_BINS) return value;
+      uint32_t exponent = highestBit(value); // >= PEAK_HISTOGRAM_SUB_BITS + 1
+      uint32_t mantissa = value >> (exponent - PEAK_HISTOGRAM_SUB_BITS); // [SUB_BINS, 2 * SUB_BINS)
+      return 2 * SUB_BINS + (exponent - PEAK_HISTOGRAM_SUB_BITS - 1) * SUB_BINS + (mantissa - SUB_BINS);
+    }
+
+    // Smallest value of a bin (bin PEAK_HISTOGRAM_BINS: one past the largest value)
+    static uint32_t lowerBound(size_t bin) {
+      if (bin < 2 * SUB_BINS) return bin;
+      uint32_t octave = (bin - 2 * SUB_BINS) / SUB_BINS, sub = (bin - 2 * SUB_BINS) % SUB_BINS;
+      return (SUB_BINS + sub) << (octave + 1);
+    }
+};
@@ -48,7 +48,7 @@ FlashIAPLimits getFlashIAPLimits()
 
   result = flash.deinit();
 
-  int available_size = flash_start_address + flash_size - start_address;
+  uint32_t available_size = flash_start_address + flash_size - start_address;
   if (available_size % (sector_size * 2)) {
     available_size = align_down(available_size, sector_size * 2);
   }
@@ -0,0 +1,44 @@
+#pragma once
+
+// GPS protocol backends: NmeaParser and UbxParser (UBX NAV-PVT). The GNSS
+// policies of RoadQualifier and GpsReceiver take one as their Parser
+// parameter; both provide
+//   static void begin(HardwareSerial& serial, unsigned long baud)
+//   bool encode(char c)
+//   const GpsSnapshot& state() const
+//
+// GpsSnapshotBuffer hands the latest GpsSnapshot from the thread that
+// parses to readers on other threads.
+
+#include <atomic>
+#include "NmeaParser.h"
+#include "UbxParser.h"
+
+// Double-buffered snapshot: publish() writes the inactive copy and then
+// advances the publish count, whose low bit is the published copy. read()
+// copies the published one without locks and repeats the copy if a publish
+// happened meanwhile (the writer may then be filling the copy being read).
+// One writer, any number of readers.
+class GpsSnapshotBuffer {
+  public:
+    void publish(const GpsSnapshot& snapshot) {
+      uint32_t next = publishes.load(std::memory_order_relaxed) + 1;
+      snapshots[next & 1] = snapshot;
+      publishes.store(next, std::memory_order_release);
+    }
+
+    GpsSnapshot read() const {
+      GpsSnapshot snapshot;
+      uint32_t count;
+      do {
+        count = publishes.load(std::memory_order_acquire);
+        snapshot = snapshots[count & 1];
+        std::atomic_thread_fence(std::memory_order_acquire);
+      } while (publishes.load(std::memory_order_relaxed) != count);
+      return snapshot;
+    }
+
+  private:
+    GpsSnapshot snapshots[2];
+    std::atomic<uint32_t> publishes{0};
+};
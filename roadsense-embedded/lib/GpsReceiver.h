@@ -0,0 +1,65 @@
+#pragma once
+
+// GPS ingestion off the sampling path.
+//
+// The UART driver of the Arduino mbed core already receives Serial1 through
+// the RX interrupt into its own ring buffer. GpsReceiver drains that buffer
+// on a low-priority rtos::Thread, woken by an mbed::Ticker every
+// GPS_POLL_PERIOD_MS (well within the time the driver buffer takes to fill
+// at GPS_BAUD), feeds the Parser (NmeaParser or UbxParser, see GpsParser.h)
+// and publishes its GpsSnapshot (latest fix, speed, date and antenna
+// status).
+//
+// Snapshots are double-buffered (GpsSnapshotBuffer), so snapshot() is an
+// O(1) copy without locks.
+//
+// On host builds the Ticker is a timer of the shim virtual clock (see
+// host/shim/Ticker.h).
+
+#include <Arduino.h>
+#include <mbed.h>
+#include <rtos.h>
+#include "GpsParser.h"
+
+#define GPS_POLL_PERIOD_MS 20       // Receiver thread wake-up period
+#define GPS_RECEIVER_STACK_SIZE 2048 // Receiver thread stack [bytes]
+#define GPS_RECEIVER_TICK_FLAG 0x1   // Thread flag set by the ticker
+
+template <class Parser>
+class GpsReceiver {
+  public:
+    GpsReceiver() : thread(osPriorityLow, GPS_RECEIVER_STACK_SIZE, nullptr, "gps") {}
+
+    // Opens the GPS UART and starts the receiver thread
+    bool begin(unsigned long baud) {
+      if (running) return true;
+      Parser::begin(Serial1, baud);
+      if (thread.start([this] { run(); }) != osOK) return false;
+      ticker.attach([this] { thread.flags_set(GPS_RECEIVER_TICK_FLAG); }, std::chrono::milliseconds(GPS_POLL_PERIOD_MS));
+      running = true;
+      return true;
+    }
+
+    // Latest published state (O(1), safe from any thread)
+    GpsSnapshot snapshot() const { return snapshots.read(); }
+
+  private:
+    Parser parser;
+    rtos::Thread thread;
+    mbed::Ticker ticker;
+    bool running = false;
+    GpsSnapshotBuffer snapshots;
+
+    void run() {
+      while (true) {
+        rtos::ThisThread::flags_wait_any(GPS_RECEIVER_TICK_FLAG);
+
+        bool changed = false;
+        while (Serial1.available() > 0) {
+          if (parser.encode(Serial1.read())) changed = true;
+        }
+
+        if (changed) snapshots.publish(parser.state());
+      }
+    }
+};
@@ -0,0 +1,254 @@
+#pragma once
+
+// Micro-benchmarks of the per-sample and per-segment hot paths.
+// Runs on the Portenta (enable BENCH_HOT_PATHS in roadsense-embedded.ino,
+// reports DWT cycle counts) and on the host (host/bench, ns and heap
+// allocations per operation).
+
+#include "Bench.h"
+#include "SegmentQuality.h"
+#include "RabbitMQClient.h"
+#include "roadqualifier.h"
+#include "MyCircularBuffer.h"
+#include "PackedSegment.h"
+
+#define BENCH_ITERATIONS 20000
+#define BENCH_BUDGET_KMPH 130.0 // Speed of the CPU budget table (most segments per second)
+
+// Measured costs of the acquisition pipeline [ns]
+struct PipelineCosts {
+  double sample;  // Filter, peak and features per sample
+  double frame;   // One FFT frame (ROUGHNESS_SPECTRUM)
+  double segment; // Features and band values per segment
+};
+
+// Share of one core the per-sample pipeline takes: the kernels per sample,
+// an FFT frame every SPECTRUM_FFT_HOP samples plus one per segment (worst
+// case), and the per-segment work. I2C transfers, GPS parsing and
+// publishing come on top.
+inline void printCpuBudget(Print& out, const PipelineCosts& costs) {
+  static const float rates[] = {250.0f, 500.0f, 1000.0f, 2000.0f, 4000.0f};          // [Hz]
+  static const float segmentLengths[] = {0.25f, 0.5f, 1.0f, 2.0f, 5.0f};             // [m]
+  char line[96];
+  snprintf(line, sizeof(line), "CPU budget at %.0f km/h, %% of one core (sample rate / segment length):", BENCH_BUDGET_KMPH);
+  out.println(line);
+  out.print("          ");
+  for (float length : segmentLengths) {
+    snprintf(line, sizeof(line), " %6.2f m", length);
+    out.print(line);
+  }
+  out.println();
+  for (float rate : rates) {
+    snprintf(line, sizeof(line), "%7.0f Hz", rate);
+    out.print(line);
+    for (float length : segmentLengths) {
+      double segmentsPerSecond = BENCH_BUDGET_KMPH / 3.6 / length;
+      double framesPerSecond = rate / SPECTRUM_FFT_HOP + segmentsPerSecond;
+      double ns = rate * costs.sample + framesPerSecond * costs.frame + segmentsPerSecond * costs.segment;
+      snprintf(line, sizeof(line), " %7.2f%%", ns / 1e7);
+      out.print(line);
+    }
+    out.println();
+  }
+}
+
+// Prints the benchmark table and returns the pipeline costs for printCpuBudget()
+inline PipelineCosts runHotPathBenchmarks(Print& out, RabbitMQClient& client) {
+  CycleCounter::begin();
+  printBenchHeader(out);
+
+  // Per segment: linear quantization with a 64-bit divide
+  printBenchResult(out, bench("quantifyToByte", BENCH_ITERATIONS, [](uint32_t i) {
+    uint8_t q = RoadQualifier::quantifyToByte((int32_t)((i * 7919u) % 40000u), 2000, 27000);
+    benchKeep(q);
+  }));
+
+  // Per segment with EQUALIZED_QUANTIZER: binary search over the thresholds
+  static uint16_t thresholds[QUANTIZER_THRESHOLDS];
+  linearThresholds(thresholds, 2000, 27000);
+  printBenchResult(out, bench("quantizeWithThresholds", BENCH_ITERATIONS, [](uint32_t i) {
+    uint8_t q = quantizeWithThresholds(thresholds, (int32_t)((i * 7919u) % 40000u));
+    benchKeep(q);
+  }));
+
+  // Per published segment: GPS date/time to Unix time
+  printBenchResult(out, bench("dateTimeToUnix", BENCH_ITERATIONS, [](uint32_t i) {
+    time_t t = dateTimeToUnix(2024, 1 + i % 12, 1 + i % 28, i % 24, i % 60, (i / 60) % 60);
+    benchKeep(t);
+  }));
+
+  // Per sample: vibration feature accumulation (reset every 500 samples, about a segment)
+  static SegmentFeatureAccumulator features;
+  printBenchResult(out, bench("SegmentFeatureAccumulator add", BENCH_ITERATIONS, [](uint32_t i) {
+    if (i % 500 == 0) features.reset();
+    features.add((int16_t)(16384 + (int32_t)((i * 7919u) % 4001u) - 2000));
+    benchKeep(features);
+  }));
+
+  // Per FIFO burst (40 samples, 40 ms at 1 kHz): the per-sample loop
+  // qualifySegment() used against the block kernels
+  static int16_t frame[FIFO_BURST_FRAMES];
+  for (uint32_t i = 0; i < FIFO_BURST_FRAMES; i++) frame[i] = (int16_t)(16384 + (int32_t)((i * 7919u) % 4001u) - 2000);
+  printBenchResult(out, bench("peak difference, per sample (40)", BENCH_ITERATIONS / 10, [](uint32_t i) {
+    int32_t peak = 0;
+    int16_t last = (int16_t)(16384 + i % 7);
+    for (uint32_t j = 0; j < FIFO_BURST_FRAMES; j++) {
+      int32_t diff = abs((int32_t)frame[j] - (int32_t)last);
+      if (diff > peak) peak = diff;
+      last = frame[j];
+    }
+    benchKeep(peak);
+  }));
+  BenchResult peakBlock = bench("peak difference, block (40)", BENCH_ITERATIONS / 10, [](uint32_t i) {
+    int32_t peak = dspMaxAbsDifference(frame, FIFO_BURST_FRAMES, (int16_t)(16384 + i % 7));
+    benchKeep(peak);
+  });
+  printBenchResult(out, peakBlock);
+  printBenchResult(out, bench("features, per sample (40)", BENCH_ITERATIONS / 10, [](uint32_t i) {
+    if (i % 16 == 0) features.reset();
+    for (uint32_t j = 0; j < FIFO_BURST_FRAMES; j++) features.add(frame[j]);
+    benchKeep(features);
+  }));
+  BenchResult featuresBlock = bench("features, block (40)", BENCH_ITERATIONS / 10, [](uint32_t i) {
+    if (i % 16 == 0) features.reset();
+    features.addBlock(frame, benchOpaque<size_t>(FIFO_BURST_FRAMES));
+    benchKeep(features);
+  });
+  printBenchResult(out, featuresBlock);
+
+  // Per FIFO burst with IMU_FILTER: 3 Hz high-pass + 80 Hz low-pass at 1 kHz
+  static constexpr BiquadCoefficients filterStages[2] = {butterworthHighPass(3.0, 1000.0), butterworthLowPass(80.0, 1000.0)};
+  static BiquadCascade<2> filter(filterStages);
+  filter.reset(16384);
+  BenchResult filterBlock = bench("BiquadCascade<2> (40)", BENCH_ITERATIONS / 10, [](uint32_t) {
+    int16_t filtered[FIFO_BURST_FRAMES];
+    filter.process(frame, filtered, FIFO_BURST_FRAMES);
+    benchKeep(filtered);
+  });
+  printBenchResult(out, filterBlock);
+
+  // Per SPECTRUM_FFT_HOP samples with ROUGHNESS_SPECTRUM: one FFT frame
+  // (but the first of a segment)
+  static int16_t spectrumFrame[SPECTRUM_FFT_HOP];
+  for (uint32_t i = 0; i < SPECTRUM_FFT_HOP; i++) spectrumFrame[i] = frame[i % FIFO_BURST_FRAMES];
+  static RoughnessSpectrum spectrum(1000.0f);
+  BenchResult spectrumFrameResult = bench("RoughnessSpectrum frame (128)", BENCH_ITERATIONS / 100, [](uint32_t i) {
+    if (i % 16 == 0) {
+      spectrum.reset();
+      spectrum.addBlock(spectrumFrame, SPECTRUM_FFT_HOP);
+    }
+    spectrum.addBlock(spectrumFrame, SPECTRUM_FFT_HOP);
+    benchKeep(spectrum);
+  });
+  printBenchResult(out, spectrumFrameResult);
+
+  // Per segment: vibration features from the sums, band values from the bins
+  BenchResult featuresFinish = bench("SegmentFeatureAccumulator finish", BENCH_ITERATIONS / 10, [](uint32_t) {
+    SegmentFeatures result = features.finish();
+    benchKeep(result);
+  });
+  printBenchResult(out, featuresFinish);
+  BenchResult spectrumFinish = bench("RoughnessSpectrum finish", BENCH_ITERATIONS / 10, [](uint32_t i) {
+    SegmentSpectrum result = spectrum.finish(30.0 + i % 50);
+    benchKeep(result);
+  });
+  printBenchResult(out, spectrumFinish);
+
+  // Per segment: producer/consumer hand-over between the tasks
+  static MyCircularBuffer buffer;
+  printBenchResult(out, bench("MyCircularBuffer put+get", BENCH_ITERATIONS, [](uint32_t i) {
+    SegmentQuality in = {46.0 + i * 1e-6, 8.9, (uint8_t)i};
+    SegmentQuality item;
+    buffer.put(in);
+    buffer.get(item);
+    benchKeep(item);
+  }));
+  printBenchResult(out, bench("packSegment+unpackSegment", BENCH_ITERATIONS, [](uint32_t i) {
+    SegmentQuality in = {46.0 + i * 1e-6, 8.9, (uint8_t)i};
+    PackedSegment packed = packSegment(in, i * 1000u);
+    SegmentQuality item = unpackSegment(packed);
+    benchKeep(item);
+  }));
+  static SpscRingBuffer<PackedSegment, 2048, RingOverflow::DropOldest> segmentQueue;
+  printBenchResult(out, bench("SpscRingBuffer push+pop (seg)", BENCH_ITERATIONS, [](uint32_t i) {
+    PackedSegment in = {460000000 + (int32_t)i * 10, 89000000, (uint16_t)i, (uint8_t)i};
+    PackedSegment item;
+    segmentQueue.push(in);
+    segmentQueue.pop(item);
+    benchKeep(item);
+  }));
+  printBenchResult(out, bench("SpscRingBuffer pushN+popN (8)", BENCH_ITERATIONS / 8, [](uint32_t i) {
+    PackedSegment in[8], items[8];
+    for (uint32_t k = 0; k < 8; k++) in[k] = {460000000 + (int32_t)(i * 8 + k) * 10, 89000000, (uint16_t)i, (uint8_t)k};
+    segmentQueue.pushN(in, 8);
+    segmentQueue.popN(items, 8);
+    benchKeep(items[7]);
+  }));
+
+  // Per sample (IMU_SAMPLER): sampler thread to qualifySegment() hand-over
+  static SpscRingBuffer<ImuSample, IMU_SAMPLER_QUEUE_SIZE> sampleQueue;
+  printBenchResult(out, bench("SpscRingBuffer push+pop (sample)", BENCH_ITERATIONS, [](uint32_t i) {
+    ImuSample sample;
+    sampleQueue.push({i * IMU_SAMPLER_PERIOD_US, (int16_t)i});
+    sampleQueue.pop(sample);
+    benchKeep(sample);
+  }));
+
+  // Per published segment: JSON payload building
+  static char json[MQTT_BUFFER_SIZE];
+  printBenchResult(out, bench("buildSegmentQualityPayload", BENCH_ITERATIONS / 10, [&client](uint32_t i) {
+    SegmentQuality segment = {46.012015 + i * 9e-6, 8.961104, (uint8_t)i};
+    size_t length = client.buildSegmentQualityPayload(json, sizeof(json), segment, 1733133227 + i);
+    benchKeep(length);
+    benchKeep(json);
+  }));
+
+  // Per published batch: one message for SEGMENT_BATCH_SIZE segments
+  static SegmentQuality batch[SEGMENT_BATCH_SIZE];
+  static time_t batchTimes[SEGMENT_BATCH_SIZE];
+  for (uint32_t k = 0; k < SEGMENT_BATCH_SIZE; k++) {
+    batch[k] = {46.012015 + k * 9e-6, 8.961104, (uint8_t)k};
+    batchTimes[k] = 1733133227 + k;
+  }
+  printBenchResult(out, bench("buildSegmentBatchPayload (24)", BENCH_ITERATIONS / 100, [&client](uint32_t) {
+    size_t length = client.buildSegmentBatchPayload(json, sizeof(json), batch, batchTimes, SEGMENT_BATCH_SIZE);
+    benchKeep(length);
+    benchKeep(json);
+  }));
+  printBenchResult(out, bench("encodeSegmentPayload (24)", BENCH_ITERATIONS / 10, [](uint32_t) {
+    uint8_t payload[segmentPayloadSize(sizeof(DEVICE_ID) - 1, SEGMENT_BATCH_SIZE)];
+    size_t length = encodeSegmentPayload(payload, sizeof(payload), DEVICE_ID, batch, batchTimes, SEGMENT_BATCH_SIZE);
+    benchKeep(length);
+    benchKeep(payload);
+  }));
+  printBenchResult(out, bench("encodeSegmentDeltaPayload (24)", BENCH_ITERATIONS / 10, [](uint32_t) {
+    uint8_t payload[segmentDeltaPayloadMaxSize(sizeof(DEVICE_ID) - 1, SEGMENT_BATCH_SIZE)];
+    size_t length = encodeSegmentDeltaPayload(payload, sizeof(payload), DEVICE_ID, batch, batchTimes, SEGMENT_BATCH_SIZE);
+    benchKeep(length);
+    benchKeep(payload);
+  }));
+  // The delta encoding and the LZSS pass on top
+  printBenchResult(out, bench("compressSegmentPayload (24)", BENCH_ITERATIONS / 10, [](uint32_t) {
+    uint8_t delta[segmentDeltaPayloadMaxSize(sizeof(DEVICE_ID) - 1, SEGMENT_BATCH_SIZE)];
+    uint8_t payload[sizeof(delta)];
+    size_t length = encodeSegmentDeltaPayload(delta, sizeof(delta), DEVICE_ID, batch, batchTimes, SEGMENT_BATCH_SIZE);
+    length = compressSegmentPayload(delta, length, payload, sizeof(payload));
+    benchKeep(length);
+    benchKeep(payload);
+  }));
+
+  // Per sample (dummy sensor): Box-Muller normal generator
+  static DUMMY_MPU6050 dummyMpu;
+  printBenchResult(out, bench("DUMMY_MPU6050::getAcceleration", BENCH_ITERATIONS, [](uint32_t) {
+    int16_t x, y, z;
+    dummyMpu.getAcceleration(&x, &y, &z);
+    benchKeep(z);
+  }));
+
+  // Everything qualifySegment() may run per sample (filter, peak, features)
+  auto nsPerOp = [](const BenchResult& result) {
+    return (double)CycleCounter::ticksToNanos(result.ticks) / result.iterations;
+  };
+  return {(nsPerOp(peakBlock) + nsPerOp(featuresBlock) + nsPerOp(filterBlock)) / FIFO_BURST_FRAMES,
+          nsPerOp(spectrumFrameResult), nsPerOp(featuresFinish) + nsPerOp(spectrumFinish)};
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+// Accelerometer acquisition strategies for RoadQualifier.
+//
+// PolledAcquisition reads the acceleration registers once per call (one
+// 6-byte I2C transaction per sample, sample rate set by the caller's loop).
+//
+// FifoAcquisition lets the MPU6050 sample at a fixed output data rate into
+// its 1 KB FIFO and drains it in bursts over fast-mode I2C. The FIFO can only
+// capture all three accelerometer axes (ACCEL_FIFO_EN), so each frame is 6
+// bytes and only Z is kept. Per drain that is one FIFO_COUNT read plus one
+// burst per FIFO_BURST_FRAMES samples, instead of one transaction per sample.
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define I2C_FAST_MODE_CLOCK 400000 // I2C clock for FIFO bursts [Hz]
+#define FIFO_DLPF_MODE 1           // MPU6050_DLPF_BW_188: 1 kHz internal sample rate
+#define FIFO_RATE_DIVIDER 0        // Output data rate = 1 kHz / (1 + divider)
+#define FIFO_FRAME_SIZE 6          // Accel X/Y/Z, big-endian
+#define FIFO_SIZE 1024             // MPU6050 FIFO size in bytes
+#define FIFO_BURST_FRAMES 40       // Frames per I2C burst read (240 bytes, fits the 256 byte Wire buffer)
+
+#define IMU_MAX_SAMPLES_PER_READ (FIFO_SIZE / FIFO_FRAME_SIZE) // Largest read() a full FIFO can satisfy
+
+template <typename Mpu>
+class PolledAcquisition {
+  public:
+    explicit PolledAcquisition(Mpu& mpu) : mpu(mpu) {}
+
+    bool begin() { return true; }
+
+    // Starts a new measurement window and returns the reference sample
+    int16_t start() {
+      int16_t z;
+      mpu.getAcceleration(&dummyAcc, &dummyAcc, &z);
+      return z;
+    }
+
+    // Reads one sample
+    size_t read(int16_t* z, size_t maxSamples) {
+      if (maxSamples == 0) return 0;
+      mpu.getAcceleration(&dummyAcc, &dummyAcc, z);
+      return 1;
+    }
+
+    // Spacing of the samples returned by one read() (0: one sample per read)
+    uint32_t samplePeriodMicros() const { return 0; }
+
+  private:
+    Mpu& mpu;
+    int16_t dummyAcc;
+};
+
+template <typename Mpu>
+class FifoAcquisition {
+  public:
+    explicit FifoAcquisition(Mpu& mpu) : mpu(mpu) {}
+
+    // Configures sample rate, DLPF and FIFO (call after mpu.initialize())
+    bool begin() {
+      Wire.setClock(I2C_FAST_MODE_CLOCK);
+      mpu.setDLPFMode(FIFO_DLPF_MODE);
+      mpu.setRate(FIFO_RATE_DIVIDER);
+      mpu.setAccelFIFOEnabled(true);
+      mpu.setFIFOEnabled(true);
+      mpu.resetFIFO();
+      return true;
+    }
+
+    // Discards stale FIFO content and returns the current sample as reference
+    int16_t start() {
+      mpu.resetFIFO();
+      return mpu.getAccelerationZ();
+    }
+
+    // Drains up to maxSamples Z samples from the FIFO in bursts
+    size_t read(int16_t* z, size_t maxSamples) {
+      uint16_t count = mpu.getFIFOCount();
+
+      // On overflow the FIFO drops bytes, not frames, so alignment is lost.
+      // The count saturates at FIFO_SIZE, which saves reading INT_STATUS.
+      if (count >= FIFO_SIZE) {
+        mpu.resetFIFO();
+        overflows++;
+        return 0;
+      }
+
+      size_t frames = count / FIFO_FRAME_SIZE;
+      if (frames > maxSamples) frames = maxSamples;
+
+      size_t n = 0;
+      while (n < frames) {
+        size_t burst = frames - n;
+        if (burst > FIFO_BURST_FRAMES) burst = FIFO_BURST_FRAMES;
+        mpu.getFIFOBytes(buffer, (uint8_t)(burst * FIFO_FRAME_SIZE));
+        for (size_t f = 0; f < burst; f++) {
+          const uint8_t* frame = buffer + f * FIFO_FRAME_SIZE;
+          z[n++] = (int16_t)((frame[4] << 8) | frame[5]);
+        }
+      }
+      return n;
+    }
+
+    // Spacing of the samples returned by one read() (output data rate)
+    uint32_t samplePeriodMicros() const { return 1000 * (1 + FIFO_RATE_DIVIDER); }
+
+    uint32_t getOverflowCount() const { return overflows; }
+
+  private:
+    Mpu& mpu;
+    uint8_t buffer[FIFO_BURST_FRAMES * FIFO_FRAME_SIZE];
+    uint32_t overflows = 0;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+// Fixed-point biquad cascade for the Z acceleration.
+//
+// Each stage is a direct form I biquad with Q2.30 coefficients and a 64-bit
+// accumulator (one SMLAL per tap on the M7). Samples enter with
+// IMU_FILTER_FRACTION_BITS fractional bits so that rounding errors stay
+// well below one sensor LSB, even for a high-pass whose poles sit close to
+// z = 1. The coefficients are Butterworth sections from the bilinear
+// transform (RBJ cookbook), computed by constexpr functions: the cutoffs and
+// the sample rate are compile-time constants, and so are the coefficients.
+//
+// The implementation is plain C++ rather than CMSIS-DSP so that the host
+// replay and the device produce the same samples.
+
+#include <Arduino.h>
+
+#define IMU_FILTER_COEFFICIENT_BITS 30 // Q2.30 coefficients
+#define IMU_FILTER_FRACTION_BITS 12    // Fractional bits of the samples inside the cascade
+
+struct BiquadCoefficients {
+  int32_t b0, b1, b2, a1, a2; // y = b0 x + b1 x1 + b2 x2 - a1 y1 - a2 y2 (Q2.30)
+  int32_t dcGain;             // Output / input for a constant input (Q2.30)
+};
+
+namespace biquad {
+
+constexpr double PI = 3.14159265358979323846;
+
+// sin(x) and cos(x) for x in [0, PI] by Taylor series (std::sin is not constexpr)
+constexpr double sinSeries(double x) {
+  double term = x, sum = x;
+  for (int k = 1; k < 20; k++) {
+    term *= -x * x / ((2 * k) * (2 * k + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double cosSeries(double x) {
+  double term = 1.0, sum = 1.0;
+  for (int k = 1; k < 20; k++) {
+    term *= -x * x / ((2 * k - 1) * (2 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double sin(double x) { return x > PI / 2 ? sinSeries(PI - x) : sinSeries(x); }
+constexpr double cos(double x) { return x > PI / 2 ? -cosSeries(PI - x) : cosSeries(x); }
+
+constexpr int32_t toQ30(double value) {
+  return (int32_t)(value * (double)(1L << IMU_FILTER_COEFFICIENT_BITS) + (value < 0 ? -0.5 : 0.5));
+}
+
+constexpr BiquadCoefficients normalize(double b0, double b1, double b2, double a0, double a1, double a2) {
+  return {toQ30(b0 / a0), toQ30(b1 / a0), toQ30(b2 / a0), toQ30(a1 / a0), toQ30(a2 / a0),
+          toQ30((b0 + b1 + b2) / (a0 + a1 + a2))};
+}
+
+} // namespace biquad
+
+// Second-order Butterworth high-pass (Q = 1/sqrt(2))
+constexpr BiquadCoefficients butterworthHighPass(double cutoffHz, double sampleRateHz) {
+  double w0 = 2.0 * biquad::PI * cutoffHz / sampleRateHz;
+  double c = biquad::cos(w0);
+  double alpha = biquad::sin(w0) * 0.70710678118654752;
+  return biquad::normalize((1.0 + c) / 2.0, -(1.0 + c), (1.0 + c) / 2.0, 1.0 + alpha, -2.0 * c, 1.0 - alpha);
+}
+
+// Second-order Butterworth low-pass (Q = 1/sqrt(2))
+constexpr BiquadCoefficients butterworthLowPass(double cutoffHz, double sampleRateHz) {
+  double w0 = 2.0 * biquad::PI * cutoffHz / sampleRateHz;
+  double c = biquad::cos(w0);
+  double alpha = biquad::sin(w0) * 0.70710678118654752;
+  return biquad::normalize((1.0 - c) / 2.0, 1.0 - c, (1.0 - c) / 2.0, 1.0 + alpha, -2.0 * c, 1.0 - alpha);
+}
+
+template <size_t Stages>
+class BiquadCascade {
+  public:
+    explicit BiquadCascade(const BiquadCoefficients (&coefficients)[Stages]) : coefficients(coefficients) {}
+
+    // Settles every stage as if `z` had been the input forever, so that the
+    // gravity offset of the first sample does not ring through the cascade
+    void reset(int16_t z) {
+      int32_t value = (int32_t)z << IMU_FILTER_FRACTION_BITS;
+      for (size_t s = 0; s < Stages; s++) {
+        State& state = states[s];
+        state.x1 = state.x2 = value;
+        value = (int32_t)(((int64_t)value * coefficients[s].dcGain) >> IMU_FILTER_COEFFICIENT_BITS);
+        state.y1 = state.y2 = value;
+      }
+    }
+
+    // Filters n samples (in and out may be the same buffer)
+    void process(const int16_t* in, int16_t* out, size_t n) {
+      const int64_t round = 1LL << (IMU_FILTER_COEFFICIENT_BITS - 1);
+      for (size_t i = 0; i < n; i++) {
+        int32_t value = (int32_t)in[i] << IMU_FILTER_FRACTION_BITS;
+        for (size_t s = 0; s < Stages; s++) {
+          const BiquadCoefficients& c = coefficients[s];
+          State& state = states[s];
+          int64_t acc = round + (int64_t)c.b0 * value + (int64_t)c.b1 * state.x1 + (int64_t)c.b2 * state.x2 -
+                        (int64_t)c.a1 * state.y1 - (int64_t)c.a2 * state.y2;
+          int32_t y = saturate32(acc >> IMU_FILTER_COEFFICIENT_BITS);
+          state.x2 = state.x1;
+          state.x1 = value;
+          state.y2 = state.y1;
+          state.y1 = y;
+          value = y;
+        }
+        int32_t sample = (value + (1 << (IMU_FILTER_FRACTION_BITS - 1))) >> IMU_FILTER_FRACTION_BITS;
+        out[i] = sample > INT16_MAX ? INT16_MAX : (sample < INT16_MIN ? INT16_MIN : (int16_t)sample);
+      }
+    }
+
+  private:
+    struct State {
+      int32_t x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+    };
+
+    const BiquadCoefficients (&coefficients)[Stages];
+    State states[Stages];
+
+    static int32_t saturate32(int64_t value) {
+      return value > INT32_MAX ? INT32_MAX : (value < INT32_MIN ? INT32_MIN : (int32_t)value);
+    }
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+// Fixed-rate accelerometer sampler for RoadQualifier.
+//
+// An mbed::Ticker fires every IMU_SAMPLER_PERIOD_US and wakes a
+// high-priority rtos::Thread through a thread flag (I2C cannot be used from
+// the interrupt itself). The thread reads the sensor through the
+// acquisition strategy (see ImuAcquisition.h) and pushes timestamped
+// samples into a lock-free queue, from which qualifySegment() consumes them.
+// Timestamps are nominal: the tick count times the sample period, so sample
+// spacing is constant regardless of thread latency.
+//
+// With FifoAcquisition the MPU6050 keeps its own sample clock; every tick
+// drains the FIFO and the samples are stamped backwards from the tick at
+// the FIFO output data rate.
+//
+// On host builds the Ticker is a timer of the shim virtual clock (see
+// host/shim/Ticker.h).
+
+#include <Arduino.h>
+#include <mbed.h>
+#include <rtos.h>
+#include "ImuAcquisition.h"
+#include "SpscRingBuffer.h"
+
+#define IMU_SAMPLER_PERIOD_US 2000     // Sampler tick (500 Hz: one polled read, or one FIFO drain)
+#define IMU_SAMPLER_QUEUE_SIZE 512     // Queued samples (power of two, ~1 s at 500 Hz)
+#define IMU_SAMPLER_STACK_SIZE 2048    // Sampler thread stack [bytes]
+#define IMU_SAMPLER_WAIT_TIMEOUT 100   // Longest wait for samples in waitForSamples() [ms]
+
+#define IMU_SAMPLER_TICK_FLAG 0x1      // Thread flag set by the ticker
+#define IMU_SAMPLER_READY_FLAG 0x1     // Event flag set when samples were queued
+
+struct ImuSample {
+  uint32_t time; // [us], wraps after ~71 minutes
+  int16_t z;
+};
+
+template <typename Acquisition>
+class ImuSampler {
+  public:
+    explicit ImuSampler(Acquisition& acquisition)
+      : acquisition(acquisition), thread(osPriorityRealtime, IMU_SAMPLER_STACK_SIZE, nullptr, "imu") {}
+
+    // Starts the sample clock and the sampler thread (call after acquisition.begin())
+    bool start() {
+      if (running) return true;
+      startTime = micros();
+      ticks = 0;
+      acquisition.start();
+      if (thread.start([this] { run(); }) != osOK) return false;
+      ticker.attach([this] { onTick(); }, std::chrono::microseconds(IMU_SAMPLER_PERIOD_US));
+      running = true;
+      return true;
+    }
+
+    // Takes the oldest queued sample (returns false if none is queued)
+    bool pop(ImuSample& sample) { return queue.pop(sample); }
+
+    // Drops every queued sample
+    void discard() {
+      ImuSample sample;
+      while (queue.pop(sample)) {}
+    }
+
+    // Blocks until new samples are queued or IMU_SAMPLER_WAIT_TIMEOUT expires
+    void waitForSamples() {
+      if (!queue.isEmpty()) return;
+      ready.wait_any(IMU_SAMPLER_READY_FLAG, IMU_SAMPLER_WAIT_TIMEOUT);
+    }
+
+    // Samples lost because the consumer fell behind
+    uint32_t getDroppedCount() const { return queue.getDroppedCount(); }
+
+  private:
+    Acquisition& acquisition;
+    rtos::Thread thread;
+    rtos::EventFlags ready;
+    mbed::Ticker ticker;
+    SpscRingBuffer<ImuSample, IMU_SAMPLER_QUEUE_SIZE> queue;
+    volatile uint32_t ticks = 0;
+    uint32_t startTime = 0;
+    bool running = false;
+    int16_t z[IMU_MAX_SAMPLES_PER_READ];
+
+    // Interrupt context: only wake the sampler thread
+    void onTick() {
+      ticks = ticks + 1;
+      thread.flags_set(IMU_SAMPLER_TICK_FLAG);
+    }
+
+    void run() {
+      while (true) {
+        rtos::ThisThread::flags_wait_any(IMU_SAMPLER_TICK_FLAG);
+        uint32_t tickTime = startTime + ticks * (uint32_t)IMU_SAMPLER_PERIOD_US;
+
+        size_t n = acquisition.read(z, IMU_MAX_SAMPLES_PER_READ);
+        uint32_t spacing = acquisition.samplePeriodMicros();
+        for (size_t i = 0; i < n; i++) {
+          queue.push({tickTime - (uint32_t)(n - 1 - i) * spacing, z[i]});
+        }
+        if (n > 0) ready.set(IMU_SAMPLER_READY_FLAG);
+      }
+    }
+};
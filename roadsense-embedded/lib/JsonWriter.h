@@ -0,0 +1,122 @@
+#pragma once
+
+// Heap-free JSON formatting into a caller-provided buffer.
+//
+// Replaces the String concatenation of the segment messages, which made
+// about ten temporary Strings per segment and fragments the heap over days
+// of uptime. Numbers are formatted from integers: decimals such as
+// coordinates are passed as fixed-point values (fixedPoint(460120150, 7)
+// is 46.0120150), so neither String(double) nor the printf float path is
+// involved. A write that does not fit sets the overflow flag and leaves the
+// output at the last complete write; the buffer stays NUL-terminated.
+
+#include <Arduino.h>
+#include <string.h>
+
+class JsonWriter {
+  public:
+    JsonWriter(char* buffer, size_t capacity) : buffer(buffer), capacity(capacity) {
+      if (capacity > 0) buffer[0] = '\0';
+      else overflow = true;
+    }
+
+    // Literal text (keys, punctuation), copied as is
+    JsonWriter& raw(const char* text) {
+      append(text, strlen(text));
+      return *this;
+    }
+
+    JsonWriter& raw(char c) {
+      append(&c, 1);
+      return *this;
+    }
+
+    // Quoted string with '"', '\' and control characters escaped
+    JsonWriter& string(const char* value) {
+      size_t start = length;
+      raw('"');
+      for (const char* c = value; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+          char escaped[2] = {'\\', *c};
+          append(escaped, 2);
+        } else if ((uint8_t)*c < 0x20) {
+          static const char hex[] = "0123456789abcdef";
+          char escaped[6] = {'\\', 'u', '0', '0', hex[(uint8_t)*c >> 4], hex[*c & 0xF]};
+          append(escaped, 6);
+        } else {
+          append(c, 1);
+        }
+      }
+      raw('"');
+      if (overflow) truncate(start);
+      return *this;
+    }
+
+    JsonWriter& unsignedInteger(uint64_t value) {
+      char digits[20];
+      size_t n = 0;
+      do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + value % 10);
+        value /= 10;
+      } while (value);
+      append(digits + sizeof(digits) - n, n);
+      return *this;
+    }
+
+    JsonWriter& integer(int64_t value) {
+      size_t start = length;
+      if (value < 0) raw('-');
+      unsignedInteger(value < 0 ? (uint64_t)0 - (uint64_t)value : (uint64_t)value);
+      if (overflow) truncate(start);
+      return *this;
+    }
+
+    // value / 10^decimals with all decimals (at most 18), e.g. (-5, 3) is -0.005
+    JsonWriter& fixedPoint(int64_t value, uint8_t decimals) {
+      size_t start = length;
+      if (decimals > 18) decimals = 18;
+      uint64_t magnitude = value < 0 ? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+      uint64_t scale = 1;
+      for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+      if (value < 0) raw('-');
+      unsignedInteger(magnitude / scale);
+      if (decimals > 0) {
+        char fraction[20];
+        uint64_t rest = magnitude % scale;
+        for (uint8_t i = 0; i < decimals; i++) {
+          fraction[decimals - 1 - i] = (char)('0' + rest % 10);
+          rest /= 10;
+        }
+        raw('.');
+        append(fraction, decimals);
+      }
+      if (overflow) truncate(start);
+      return *this;
+    }
+
+    bool hasOverflowed() const { return overflow; }
+    size_t size() const { return length; }  // Without the NUL
+    const char* c_str() const { return buffer; }
+
+  private:
+    char* buffer;
+    size_t capacity;
+    size_t length = 0;
+    bool overflow = false;
+
+    void append(const char* text, size_t n) {
+      if (overflow || length + n >= capacity) {
+        overflow = true;
+        return;
+      }
+      memcpy(buffer + length, text, n);
+      length += n;
+      buffer[length] = '\0';
+    }
+
+    // Drops a partly written value
+    void truncate(size_t size) {
+      length = size;
+      buffer[length] = '\0';
+    }
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+// Small-window LZSS, in the spirit of heatshrink: no heap, the window is
+// the input itself. Matches are found through hash chains on the first
+// LZSS_MIN_MATCH bytes (1 KB of tables on the stack), which give the same
+// matches as searching the whole window. Meant for payloads of a few
+// hundred bytes.
+//
+// The output is a bit stream, most significant bit first:
+// - 1, then 8 bits: a literal byte
+// - 0, then LZSS_OFFSET_BITS bits of offset - 1 and LZSS_LENGTH_BITS bits
+//   of length - LZSS_MIN_MATCH: a copy of length bytes from offset bytes
+//   back (the copy may overlap its own output)
+// The last byte is padded with zero bits. Every token is at least 9 bits,
+// so a decoder stops when fewer than 9 bits are left.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LZSS_OFFSET_BITS 8 // Window of 256 bytes
+#define LZSS_LENGTH_BITS 4
+#define LZSS_MIN_MATCH 2   // A match token (13 bits) beats two literals (18)
+#define LZSS_MAX_MATCH (LZSS_MIN_MATCH + (1 << LZSS_LENGTH_BITS) - 1)
+#define LZSS_WINDOW (1 << LZSS_OFFSET_BITS)
+#define LZSS_HASH_BITS 8 // Chains of the compressor
+#define LZSS_NO_POSITION 0xFFFF // End of a chain
+
+// Largest output for length input bytes (all literals)
+constexpr size_t lzssMaxCompressedSize(size_t length) {
+  return (length * 9 + 7) / 8;
+}
+
+class LzssBitWriter {
+  public:
+    LzssBitWriter(uint8_t* out, size_t capacity) : out(out), capacity(capacity) {}
+
+    // Appends the low count bits of value; false once the output is full
+    bool write(uint32_t value, uint8_t count) {
+      while (count > 0) {
+        if (bit == 0) {
+          if (length == capacity) return false;
+          out[length++] = 0;
+        }
+        uint8_t take = count < 8 - bit ? count : 8 - bit;
+        uint8_t chunk = (uint8_t)((value >> (count - take)) & ((1u << take) - 1));
+        out[length - 1] |= (uint8_t)(chunk << (8 - bit - take));
+        bit = (uint8_t)((bit + take) & 7);
+        count -= take;
+      }
+      return true;
+    }
+
+    size_t size() const { return length; }
+
+  private:
+    uint8_t* out;
+    size_t capacity;
+    size_t length = 0;
+    uint8_t bit = 0; // Bits used in the last byte, 0 when it is full
+};
+
+// Hash of the LZSS_MIN_MATCH bytes at in
+inline uint8_t lzssHash(const uint8_t* in) {
+  return (uint8_t)((in[0] << 3) ^ in[1] ^ (in[0] >> 5));
+}
+
+// Compresses length bytes of in (at most 64 KB) into out; returns the
+// compressed size, or 0 if it does not fit capacity
+inline size_t lzssCompress(const uint8_t* in, size_t length, uint8_t* out, size_t capacity) {
+  static_assert(LZSS_MIN_MATCH == 2, "lzssHash() hashes two bytes");
+  if (length >= LZSS_NO_POSITION) return 0;
+  // Latest position of each hash, and per position (modulo the window) the
+  // previous one with the same hash
+  uint16_t heads[1 << LZSS_HASH_BITS];
+  uint16_t chain[LZSS_WINDOW];
+  for (uint16_t& head : heads) head = LZSS_NO_POSITION;
+  size_t inserted = 0; // Positions before this are in the chains
+  auto insertUpTo = [&](size_t end) {
+    for (; inserted < end && inserted + 1 < length; inserted++) {
+      uint8_t hash = lzssHash(in + inserted);
+      chain[inserted % LZSS_WINDOW] = heads[hash];
+      heads[hash] = (uint16_t)inserted;
+    }
+  };
+
+  LzssBitWriter writer(out, capacity);
+  size_t position = 0;
+  while (position < length) {
+    // Longest match in the window, the nearest one of equal length. The
+    // chain runs from the nearest candidate; one more than the window
+    // back, its entries have been overwritten.
+    size_t bestLength = 0, bestOffset = 0;
+    size_t maxLength = length - position < LZSS_MAX_MATCH ? length - position : LZSS_MAX_MATCH;
+    if (maxLength >= LZSS_MIN_MATCH) {
+      for (size_t candidate = heads[lzssHash(in + position)];
+           candidate != LZSS_NO_POSITION && position - candidate <= LZSS_WINDOW && bestLength < maxLength;
+           candidate = chain[candidate % LZSS_WINDOW]) {
+        if (in[candidate] != in[position] || in[candidate + 1] != in[position + 1]) continue; // Hash collision
+        size_t n = LZSS_MIN_MATCH;
+        while (n < maxLength && in[candidate + n] == in[position + n]) n++;
+        if (n > bestLength) {
+          bestLength = n;
+          bestOffset = position - candidate;
+        }
+      }
+    }
+
+    bool ok;
+    if (bestLength >= LZSS_MIN_MATCH) {
+      ok = writer.write(0, 1) && writer.write((uint32_t)(bestOffset - 1), LZSS_OFFSET_BITS) &&
+           writer.write((uint32_t)(bestLength - LZSS_MIN_MATCH), LZSS_LENGTH_BITS);
+      position += bestLength;
+    } else {
+      ok = writer.write(1, 1) && writer.write(in[position], 8);
+      position++;
+    }
+    if (!ok) return 0;
+    insertUpTo(position);
+  }
+  return writer.size();
+}
+
+// Decompresses length bytes of in into out; returns the decompressed size,
+// or 0 if the stream is invalid or does not fit capacity
+inline size_t lzssDecompress(const uint8_t* in, size_t length, uint8_t* out, size_t capacity) {
+  size_t bitPosition = 0, bits = length * 8, produced = 0;
+  auto read = [&](uint8_t count) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < count; i++, bitPosition++) {
+      value = (value << 1) | ((in[bitPosition / 8] >> (7 - bitPosition % 8)) & 1);
+    }
+    return value;
+  };
+  while (bits - bitPosition >= 9) {
+    if (read(1)) {
+      if (produced == capacity) return 0;
+      out[produced++] = (uint8_t)read(8);
+      continue;
+    }
+    if (bits - bitPosition < LZSS_OFFSET_BITS + LZSS_LENGTH_BITS) return 0;
+    size_t offset = read(LZSS_OFFSET_BITS) + 1;
+    size_t count = read(LZSS_LENGTH_BITS) + LZSS_MIN_MATCH;
+    if (offset > produced || count > capacity - produced) return 0;
+    for (size_t i = 0; i < count; i++, produced++) out[produced] = out[produced - offset];
+  }
+  return produced;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <mbed.h>
+#include <rtos.h>
+#include <mutex>
+#include "SegmentQuality.h"
+
+#ifndef BUFFER_SIZE
+#define BUFFER_SIZE 1000
+#endif
+
+// Circular buffer for segment qualities shared between the qualifier task
+// (producer) and the publisher task (consumer). When full, put() overwrites
+// the oldest entry.
+class MyCircularBuffer {
+public:
+    MyCircularBuffer() : head(0), tail(0), full(false) {}
+
+    bool put(const SegmentQuality& item) {
+        std::lock_guard<rtos::Mutex> lock(buffer_mutex); // mutex gets released automatically when lock goes out of scope
+        buffer[head] = item;
+        if (full) {
+            tail = (tail + 1) % BUFFER_SIZE;
+        }
+        head = (head + 1) % BUFFER_SIZE;
+        full = head == tail;
+        return true;
+    }
+
+    bool get(SegmentQuality& item) {
+        std::lock_guard<rtos::Mutex> lock(buffer_mutex);
+        if (isEmpty()) {
+            return false;
+        }
+        item = buffer[tail];
+        full = false;
+        tail = (tail + 1) % BUFFER_SIZE;
+        return true;
+    }
+
+    bool isEmpty() const {
+        return (!full && (head == tail));
+    }
+
+    bool isFull() const {
+        return full;
+    }
+
+private:
+    SegmentQuality buffer[BUFFER_SIZE];
+    size_t head;
+    size_t tail;
+    bool full;
+    rtos::Mutex buffer_mutex;
+};
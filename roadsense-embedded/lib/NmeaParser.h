@@ -0,0 +1,295 @@
+#pragma once
+
+// Purpose-built NMEA 0183 parser for the fields RoadQualifier uses.
+//
+// Extracts, in a single pass over the characters:
+//   $--RMC  time, status, latitude, longitude, date
+//   $--GGA  time, latitude, longitude, fix quality
+//   $--VTG  speed over ground in km/h (term 7)
+//   $--TXT  antenna status text (term 4, "ANTENNA OK")
+// for any talker ID. Which term of which sentence carries which field is a
+// lookup table (NMEA_FIELDS). Values are fixed-point integers (1e-7 degrees,
+// mm/s), parsed without heap or libc number conversion, staged while the
+// sentence is read and committed into a GpsSnapshot only when the checksum
+// matches.
+
+#include <Arduino.h>
+
+struct GpsSnapshot {
+  // Location and speed; the counters increase with every new value
+  int32_t latitudeE7 = 0;   // [1e-7 degrees]
+  int32_t longitudeE7 = 0;  // [1e-7 degrees]
+  uint32_t speedMmps = 0;   // [mm/s]
+  uint32_t locationUpdates = 0;
+  uint32_t speedUpdates = 0;
+  unsigned long locationTime = 0; // millis() when the location was received
+  unsigned long speedTime = 0;    // millis() when the speed was received
+  // UTC date and time of the last fix
+  bool dateTimeValid = false;
+  uint16_t year = 0;
+  uint8_t month = 0, day = 0, hour = 0, minute = 0, second = 0;
+  // $--TXT antenna status
+  uint32_t antennaUpdates = 0;
+  bool antennaOk = false;
+};
+
+#define NMEA_MAX_TERM_SIZE 16 // Longest term kept (longer terms are truncated)
+#define NMEA_MAX_TERMS 10     // Terms 0..9 can carry a field
+
+enum NmeaSentence : uint8_t {
+  NMEA_OTHER,
+  NMEA_RMC,
+  NMEA_GGA,
+  NMEA_VTG,
+  NMEA_TXT,
+  NMEA_SENTENCE_COUNT
+};
+
+enum NmeaField : uint8_t {
+  FIELD_NONE,
+  FIELD_TIME,        // hhmmss.sss
+  FIELD_STATUS,      // 'A' = valid
+  FIELD_LATITUDE,    // ddmm.mmmmm
+  FIELD_NORTH_SOUTH, // 'N' / 'S'
+  FIELD_LONGITUDE,   // dddmm.mmmmm
+  FIELD_EAST_WEST,   // 'E' / 'W'
+  FIELD_DATE,        // ddmmyy
+  FIELD_FIX_QUALITY, // '0' = no fix
+  FIELD_SPEED_KMPH,  // km/h
+  FIELD_TEXT         // free text
+};
+
+// Field carried by term t of each sentence type
+static const uint8_t NMEA_FIELDS[NMEA_SENTENCE_COUNT][NMEA_MAX_TERMS] = {
+  /* OTHER */ {},
+  /* RMC   */ {FIELD_NONE, FIELD_TIME, FIELD_STATUS, FIELD_LATITUDE, FIELD_NORTH_SOUTH,
+               FIELD_LONGITUDE, FIELD_EAST_WEST, FIELD_NONE, FIELD_NONE, FIELD_DATE},
+  /* GGA   */ {FIELD_NONE, FIELD_TIME, FIELD_LATITUDE, FIELD_NORTH_SOUTH, FIELD_LONGITUDE,
+               FIELD_EAST_WEST, FIELD_FIX_QUALITY},
+  /* VTG   */ {FIELD_NONE, FIELD_NONE, FIELD_NONE, FIELD_NONE, FIELD_NONE,
+               FIELD_NONE, FIELD_NONE, FIELD_SPEED_KMPH},
+  /* TXT   */ {FIELD_NONE, FIELD_NONE, FIELD_NONE, FIELD_NONE, FIELD_TEXT},
+};
+
+class NmeaParser {
+  public:
+    // Opens `serial` for the receiver's NMEA output at its default baud rate
+    static void begin(HardwareSerial& serial, unsigned long baud) { serial.begin(baud); }
+
+    // Feeds one character; returns true when it completed a valid sentence
+    bool encode(char c) {
+      switch (c) {
+        case '$':
+          startSentence();
+          return false;
+        case ',':
+          if (inSentence && !inChecksum) {
+            parity ^= (uint8_t)c;
+            endTerm();
+            termNumber++;
+            termLength = 0;
+          }
+          return false;
+        case '*':
+          if (inSentence && !inChecksum) {
+            endTerm();
+            inChecksum = true;
+            termLength = 0;
+          }
+          return false;
+        case '\r':
+        case '\n':
+          inSentence = false;
+          return false;
+      }
+      if (!inSentence) return false;
+
+      if (inChecksum) {
+        int digit = hexDigit(c);
+        if (digit < 0) {
+          inSentence = false;
+          return false;
+        }
+        received = (uint8_t)(received << 4 | digit);
+        if (++termLength < 2) return false;
+        inSentence = false;
+        if (received != parity) {
+          checksumErrors++;
+          return false;
+        }
+        sentences++;
+        return commit();
+      }
+
+      parity ^= (uint8_t)c;
+      if (termLength < NMEA_MAX_TERM_SIZE - 1) term[termLength++] = c;
+      return false;
+    }
+
+    const GpsSnapshot& state() const { return current; }
+
+    uint32_t sentences = 0;      // Sentences with a valid checksum
+    uint32_t checksumErrors = 0; // Sentences dropped for a bad checksum
+
+  private:
+    GpsSnapshot current;
+
+    // Sentence being read
+    bool inSentence = false;
+    bool inChecksum = false;
+    uint8_t parity = 0;
+    uint8_t received = 0;
+    uint8_t sentence = NMEA_OTHER;
+    uint8_t termNumber = 0;
+    uint8_t termLength = 0;
+    char term[NMEA_MAX_TERM_SIZE];
+
+    // Values staged until the checksum is verified
+    bool hasTime = false, hasDate = false, hasLatitude = false, hasLongitude = false, hasSpeed = false, hasText = false;
+    bool fixValid = false;
+    uint32_t timeMillis = 0; // hhmmss.sss as hhmmsssss
+    uint32_t date = 0;       // ddmmyy
+    int32_t latitudeE7 = 0, longitudeE7 = 0;
+    uint32_t speedMmps = 0;
+    bool antennaOk = false;
+
+    void startSentence() {
+      inSentence = true;
+      inChecksum = false;
+      parity = 0;
+      received = 0;
+      sentence = NMEA_OTHER;
+      termNumber = 0;
+      termLength = 0;
+      hasTime = hasDate = hasLatitude = hasLongitude = hasSpeed = hasText = false;
+      fixValid = false;
+    }
+
+    void endTerm() {
+      if (termNumber == 0) {
+        sentence = sentenceType();
+        return;
+      }
+      if (termNumber >= NMEA_MAX_TERMS || termLength == 0) return;
+
+      switch (NMEA_FIELDS[sentence][termNumber]) {
+        case FIELD_TIME:
+          timeMillis = (uint32_t)parseDecimal(3);
+          hasTime = true;
+          break;
+        case FIELD_STATUS:
+          fixValid = term[0] == 'A';
+          break;
+        case FIELD_FIX_QUALITY:
+          fixValid = term[0] > '0';
+          break;
+        case FIELD_LATITUDE:
+          latitudeE7 = parseDegreesE7();
+          hasLatitude = true;
+          break;
+        case FIELD_NORTH_SOUTH:
+          if (term[0] == 'S') latitudeE7 = -latitudeE7;
+          break;
+        case FIELD_LONGITUDE:
+          longitudeE7 = parseDegreesE7();
+          hasLongitude = true;
+          break;
+        case FIELD_EAST_WEST:
+          if (term[0] == 'W') longitudeE7 = -longitudeE7;
+          break;
+        case FIELD_DATE:
+          date = (uint32_t)parseDecimal(0);
+          hasDate = true;
+          break;
+        case FIELD_SPEED_KMPH:
+          // [m/h] / 3.6 = [mm/s]
+          speedMmps = (uint32_t)((parseDecimal(3) * 10 + 18) / 36);
+          hasSpeed = true;
+          break;
+        case FIELD_TEXT:
+          antennaOk = termLength == 10 && memcmp(term, "ANTENNA OK", 10) == 0;
+          hasText = true;
+          break;
+      }
+    }
+
+    // "$ttRMC" etc. with any two-character talker ID
+    uint8_t sentenceType() const {
+      if (termLength != 5) return NMEA_OTHER;
+      const char* type = term + 2;
+      if (type[0] == 'R' && type[1] == 'M' && type[2] == 'C') return NMEA_RMC;
+      if (type[0] == 'G' && type[1] == 'G' && type[2] == 'A') return NMEA_GGA;
+      if (type[0] == 'V' && type[1] == 'T' && type[2] == 'G') return NMEA_VTG;
+      if (type[0] == 'T' && type[1] == 'X' && type[2] == 'T') return NMEA_TXT;
+      return NMEA_OTHER;
+    }
+
+    bool commit() {
+      unsigned long now = millis();
+      switch (sentence) {
+        case NMEA_RMC:
+        case NMEA_GGA:
+          if (hasTime) {
+            current.hour = timeMillis / 10000000;
+            current.minute = (timeMillis / 100000) % 100;
+            current.second = (timeMillis / 1000) % 100;
+          }
+          if (hasDate) {
+            current.day = date / 10000;
+            current.month = (date / 100) % 100;
+            current.year = 2000 + date % 100;
+            current.dateTimeValid = true;
+          }
+          if (fixValid && hasLatitude && hasLongitude) {
+            current.latitudeE7 = latitudeE7;
+            current.longitudeE7 = longitudeE7;
+            current.locationTime = now;
+            current.locationUpdates++;
+          }
+          return true;
+        case NMEA_VTG:
+          if (hasSpeed) {
+            current.speedMmps = speedMmps;
+            current.speedTime = now;
+            current.speedUpdates++;
+          }
+          return true;
+        case NMEA_TXT:
+          if (hasText) {
+            current.antennaOk = antennaOk;
+            current.antennaUpdates++;
+          }
+          return true;
+      }
+      return false;
+    }
+
+    // Term as a fixed-point number with `decimals` fractional digits (sign ignored)
+    int64_t parseDecimal(uint8_t decimals) const {
+      int64_t value = 0;
+      uint8_t i = 0;
+      for (; i < termLength && term[i] != '.'; i++) {
+        if (term[i] >= '0' && term[i] <= '9') value = value * 10 + (term[i] - '0');
+      }
+      if (i < termLength) i++; // '.'
+      for (uint8_t d = 0; d < decimals; d++, i++) {
+        value = value * 10 + (i < termLength && term[i] >= '0' && term[i] <= '9' ? term[i] - '0' : 0);
+      }
+      return value;
+    }
+
+    // "ddmm.mmmmm" / "dddmm.mmmmm" to 1e-7 degrees
+    int32_t parseDegreesE7() const {
+      int64_t minutesE7 = parseDecimal(7); // dddmm.mmmmmmm * 1e7
+      int64_t degrees = minutesE7 / 1000000000LL;
+      int64_t minutes = minutesE7 % 1000000000LL;
+      return (int32_t)(degrees * 10000000LL + (minutes + 30) / 60);
+    }
+
+    static int hexDigit(char c) {
+      if (c >= '0' && c <= '9') return c - '0';
+      if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+      if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+      return -1;
+    }
+};
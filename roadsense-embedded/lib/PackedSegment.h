@@ -0,0 +1,79 @@
+#pragma once
+
+// Packed segment record for the segment buffer and persistent storage.
+//
+// SegmentQuality is two doubles and a byte, 24 bytes with padding. A
+// PackedSegment is 11: the position as int32 in 1e-7 degrees (1.1 cm, well
+// below the 6 decimals published), the quality byte, and the time it was
+// qualified as a 16-bit uptime stamp in ticks of 1024 ms. The stamp is
+// relative: packedSegmentTime() turns it into Unix time from the uptime and
+// Unix time at the consumer, so segments qualified before the GPS had a date
+// still get theirs, as long as they are published within 18 hours. Ticks of
+// 1024 ms are millis() >> 10, so the stamp wraps together with millis().
+//
+// Positions are absolute rather than delta-coded: a full buffer discards its
+// oldest records, which would take the reference of a delta chain with them.
+
+#include <Arduino.h>
+#include <math.h>
+#include <time.h>
+#include "SegmentQuality.h"
+
+#define PACKED_SEGMENT_SCALE 1e7      // Position units per degree
+#define PACKED_SEGMENT_TICK_SHIFT 10  // Uptime stamp tick: 2^10 ms
+
+struct __attribute__((packed)) PackedSegment {
+  int32_t latitude;  // [1e-7 deg]
+  int32_t longitude; // [1e-7 deg]
+  uint16_t uptime;   // millis() >> PACKED_SEGMENT_TICK_SHIFT when qualified (wraps)
+  uint8_t quality;
+};
+
+static_assert(sizeof(PackedSegment) == 11, "PackedSegment must stay packed");
+
+// Producer side: pack a segment qualified at uptime nowMillis
+inline PackedSegment packSegment(const SegmentQuality& segment, unsigned long nowMillis) {
+  PackedSegment packed;
+  packed.latitude = (int32_t)lround(segment.latitude * PACKED_SEGMENT_SCALE);
+  packed.longitude = (int32_t)lround(segment.longitude * PACKED_SEGMENT_SCALE);
+  packed.uptime = (uint16_t)(nowMillis >> PACKED_SEGMENT_TICK_SHIFT);
+  packed.quality = segment.quality;
+  return packed;
+}
+
+// Consumer side: the segment back (position rounded to 1e-7 degrees)
+inline SegmentQuality unpackSegment(const PackedSegment& packed) {
+  SegmentQuality segment;
+  segment.latitude = packed.latitude / PACKED_SEGMENT_SCALE;
+  segment.longitude = packed.longitude / PACKED_SEGMENT_SCALE;
+  segment.quality = packed.quality;
+  return segment;
+}
+
+// Unix time the segment was qualified, from the uptime nowMillis and Unix
+// time nowUnix of the consumer (0 while nowUnix is unknown)
+inline time_t packedSegmentTime(const PackedSegment& packed, unsigned long nowMillis, time_t nowUnix) {
+  if (nowUnix == 0) return 0;
+  uint16_t ticks = (uint16_t)((uint16_t)(nowMillis >> PACKED_SEGMENT_TICK_SHIFT) - packed.uptime);
+  return nowUnix - (time_t)(((uint32_t)ticks << PACKED_SEGMENT_TICK_SHIFT) / 1000);
+}
+
+// A segment with its vibration features, for the feature buffer of
+// PUBLISH_FEATURES (the features are not kept in the flash log)
+struct PackedDetailedSegment {
+  PackedSegment segment;
+  SegmentFeatures features;
+  SegmentSpectrum spectrum;
+};
+
+inline PackedDetailedSegment packDetailedSegment(const DetailedSegmentQuality& segment, unsigned long nowMillis) {
+  return {packSegment(segment, nowMillis), segment.features, segment.spectrum};
+}
+
+inline DetailedSegmentQuality unpackDetailedSegment(const PackedDetailedSegment& packed) {
+  DetailedSegmentQuality segment;
+  static_cast<SegmentQuality&>(segment) = unpackSegment(packed.segment);
+  segment.features = packed.features;
+  segment.spectrum = packed.spectrum;
+  return segment;
+}
@@ -6,6 +6,8 @@
 #include <PubSubClient.h>  // MQTT library for communication
 #include <stdint.h>        // For uint8_t
 #include "SegmentQuality.h"
+#include "SegmentPayload.h"
+#include "JsonWriter.h"
 
 struct WiFiCredentials {
     const char* ssid;
@@ -25,14 +27,51 @@ const WiFiCredentials wifiCredentials[] = {
 #define user "roadsense"
 #define mqtt_password "roadsense" // Renamed to avoid conflict
 #define TOPIC "roadsense"
+#define FEATURE_TOPIC "roadsense/features" // Version 4 payloads of PUBLISH_FEATURES
 
 #define DEVICE_ID "abcd"
 
+// Segments go out as binary payloads (lib/SegmentPayload.h) in the format
+// SEGMENT_PAYLOAD_FORMAT: SEGMENT_PAYLOAD_VERSION (13 bytes per segment),
+// SEGMENT_PAYLOAD_DELTA (varint deltas, about 5) or SEGMENT_PAYLOAD_DELTA_LZ
+// (deltas compressed with lib/Lzss.h, about 3.5). Define SEGMENT_PAYLOAD_JSON
+// to publish the JSON messages instead.
+#ifndef SEGMENT_PAYLOAD_FORMAT
+#define SEGMENT_PAYLOAD_FORMAT SEGMENT_PAYLOAD_DELTA_LZ
+#endif
+// #define SEGMENT_PAYLOAD_JSON
+
+// Batched publishing: one message carries up to SEGMENT_BATCH_SIZE segments,
+// in JSON {"device_id":"abcd","segments":[[lat,lon,timestamp,bumpiness],...]}
+#define MQTT_BUFFER_SIZE 1024  // PubSubClient buffer [bytes] (the library default is 256)
+#define SEGMENT_BATCH_SIZE 24  // Segments per batched message
+#define SEGMENT_BATCH_ENTRY_MAX 40 // Longest entry: [-90.000000,-180.000000,4294967295,255],
+#define SEGMENT_BATCH_PREFIX "{\"device_id\":\"" DEVICE_ID "\",\"segments\":["
+#define SEGMENT_BATCH_SUFFIX "]}"
+#define SEGMENT_JSON_DECIMALS 6    // Coordinate decimals in the JSON messages
+#define SEGMENT_JSON_SCALE 1e6     // 10^SEGMENT_JSON_DECIMALS
+
+#define SEGMENT_PAYLOAD_OVERFLOW -100 // getErrorCode() after a payload did not fit its buffer
+
+// The longest batch fits the MQTT header, the topic and the buffer
+static_assert(MQTT_MAX_HEADER_SIZE + 2 + sizeof(TOPIC) - 1 + sizeof(SEGMENT_BATCH_PREFIX SEGMENT_BATCH_SUFFIX) - 1 +
+              SEGMENT_BATCH_SIZE * SEGMENT_BATCH_ENTRY_MAX <= MQTT_BUFFER_SIZE, "SEGMENT_BATCH_SIZE too large for MQTT_BUFFER_SIZE");
+static_assert(segmentPayloadSize(sizeof(DEVICE_ID) - 1, SEGMENT_BATCH_SIZE) <= MQTT_BUFFER_SIZE - MQTT_MAX_HEADER_SIZE - 2 - (sizeof(TOPIC) - 1),
+              "SEGMENT_BATCH_SIZE too large for MQTT_BUFFER_SIZE");
+static_assert(segmentDeltaPayloadMaxSize(sizeof(DEVICE_ID) - 1, SEGMENT_BATCH_SIZE) <= MQTT_BUFFER_SIZE - MQTT_MAX_HEADER_SIZE - 2 - (sizeof(TOPIC) - 1),
+              "SEGMENT_BATCH_SIZE too large for MQTT_BUFFER_SIZE");
+static_assert(segmentFeaturePayloadSize(sizeof(DEVICE_ID) - 1, SEGMENT_BATCH_SIZE) <= MQTT_BUFFER_SIZE - MQTT_MAX_HEADER_SIZE - 2 - (sizeof(FEATURE_TOPIC) - 1),
+              "SEGMENT_BATCH_SIZE too large for MQTT_BUFFER_SIZE");
+
 class RabbitMQClient {
 public:
     // Constructor with server, port, user, password
     RabbitMQClient()
-        : _host(host), _port(port), _user(user), _password(mqtt_password), _wifiClient(), _mqttClient(_wifiClient), _errorCode(0) {}
+        : _host(host), _port(port), _user(user), _password(mqtt_password), _wifiClient(), _mqttClient(_wifiClient), _errorCode(0) {
+        _mqttClient.setServer(_host, _port);
+        // Once: PubSubClient reallocs its buffer on every call
+        _mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+    }
 
     // Connect to the WiFi
     void connectWiFi() {
@@ -64,7 +103,6 @@ public:
 
     // Connect to RabbitMQ
     bool connect() {
-        _mqttClient.setServer(_host, _port);
         if (!ensureConnected()) {
             _errorCode = _mqttClient.state();  // Store the error code when connection fails
             return false;
@@ -74,13 +112,18 @@ public:
 
     // Publish a message to a topic
     bool publish(const char* topic, const char* message) {
+        return publish(topic, (const uint8_t*)message, strlen(message));
+    }
+
+    // Publish length bytes of binary payload to a topic
+    bool publish(const char* topic, const uint8_t* payload, size_t length) {
         if (!ensureConnected()) {
             Serial.println("Failed to publish: Not connected to RabbitMQ.");
             _errorCode = _mqttClient.state();  // Store error code on failure
             return false;
         }
 
-        if (_mqttClient.publish(topic, message)) {
+        if (_mqttClient.publish(topic, payload, (unsigned int)length)) {
             Serial.println("Message published successfully.");
             return true;
         } else {
@@ -90,15 +133,79 @@ public:
         }
     }
 
-    // Send SegmentQuality data as a JSON string to a RabbitMQ queue
+    // Write the JSON payload for a SegmentQuality into out; returns its
+    // length, or 0 if it does not fit capacity
+    size_t buildSegmentQualityPayload(char* out, size_t capacity, const SegmentQuality& segment, time_t timestamp=0) {
+        JsonWriter json(out, capacity);
+        json.raw("{\"lat\": ").fixedPoint(llround(segment.latitude * SEGMENT_JSON_SCALE), SEGMENT_JSON_DECIMALS)
+            .raw(", \"lon\": ").fixedPoint(llround(segment.longitude * SEGMENT_JSON_SCALE), SEGMENT_JSON_DECIMALS)
+            .raw(", \"timestamp\": ").unsignedInteger((unsigned long)timestamp)
+            .raw(", \"bumpiness\": ").unsignedInteger(segment.quality)
+            .raw(", \"device_id\": ").string(DEVICE_ID).raw(" }");
+        return json.hasOverflowed() ? 0 : json.size();
+    }
+
+    // Send SegmentQuality data to a RabbitMQ queue (binary, or a JSON string
+    // with SEGMENT_PAYLOAD_JSON)
     bool publishSegmentQuality(const char* topic, const SegmentQuality& segment, time_t timestamp=0) {
-        String payload = "{\"lat\": " + String(segment.latitude, 6) +
-                         ", \"lon\": " + String(segment.longitude, 6) +
-			 ", \"timestamp\": " + String((unsigned long)timestamp) +
-                         ", \"bumpiness\": " + String(segment.quality) + 
-			", \"device_id\": \"" + DEVICE_ID +	"\" }";
+#ifdef SEGMENT_PAYLOAD_JSON
+        return publishPayload(topic, buildSegmentQualityPayload((char*)_payload, sizeof(_payload), segment, timestamp));
+#else
+        return publishSegmentBatchBinary(topic, &segment, &timestamp, 1);
+#endif
+    }
+
+    // Write the JSON payload for a batch of count segments into out; returns
+    // its length, or 0 if it does not fit capacity
+    size_t buildSegmentBatchPayload(char* out, size_t capacity, const SegmentQuality* segments, const time_t* timestamps, size_t count) {
+        JsonWriter json(out, capacity);
+        json.raw(SEGMENT_BATCH_PREFIX);
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0) json.raw(',');
+            json.raw('[').fixedPoint(llround(segments[i].latitude * SEGMENT_JSON_SCALE), SEGMENT_JSON_DECIMALS)
+                .raw(',').fixedPoint(llround(segments[i].longitude * SEGMENT_JSON_SCALE), SEGMENT_JSON_DECIMALS)
+                .raw(',').unsignedInteger((unsigned long)timestamps[i])
+                .raw(',').unsignedInteger(segments[i].quality)
+                .raw(']');
+        }
+        json.raw(SEGMENT_BATCH_SUFFIX);
+        return json.hasOverflowed() ? 0 : json.size();
+    }
 
-        return publish(topic, payload.c_str());
+    // Send up to SEGMENT_BATCH_SIZE segments in one message
+    bool publishSegmentBatch(const char* topic, const SegmentQuality* segments, const time_t* timestamps, size_t count) {
+#ifdef SEGMENT_PAYLOAD_JSON
+        return publishSegmentBatchJson(topic, segments, timestamps, count);
+#else
+        return publishSegmentBatchBinary(topic, segments, timestamps, count);
+#endif
+    }
+
+    // Send count segments as one JSON message
+    bool publishSegmentBatchJson(const char* topic, const SegmentQuality* segments, const time_t* timestamps, size_t count) {
+        if (count == 0 || count > SEGMENT_BATCH_SIZE) return false;
+        return publishPayload(topic, buildSegmentBatchPayload((char*)_payload, sizeof(_payload), segments, timestamps, count));
+    }
+
+    // Send count segments as one binary payload in SEGMENT_PAYLOAD_FORMAT
+    bool publishSegmentBatchBinary(const char* topic, const SegmentQuality* segments, const time_t* timestamps, size_t count) {
+        if (count == 0 || count > SEGMENT_BATCH_SIZE) return false;
+#if SEGMENT_PAYLOAD_FORMAT == SEGMENT_PAYLOAD_DELTA_LZ
+        uint8_t delta[segmentDeltaPayloadMaxSize(sizeof(DEVICE_ID) - 1, SEGMENT_BATCH_SIZE)];
+        size_t length = encodeSegmentDeltaPayload(delta, sizeof(delta), DEVICE_ID, segments, timestamps, count);
+        return publishPayload(topic, length ? compressSegmentPayload(delta, length, _payload, sizeof(_payload)) : 0);
+#elif SEGMENT_PAYLOAD_FORMAT == SEGMENT_PAYLOAD_DELTA
+        return publishPayload(topic, encodeSegmentDeltaPayload(_payload, sizeof(_payload), DEVICE_ID, segments, timestamps, count));
+#else
+        return publishPayload(topic, encodeSegmentPayload(_payload, sizeof(_payload), DEVICE_ID, segments, timestamps, count));
+#endif
+    }
+
+    // Send up to SEGMENT_BATCH_SIZE segments with their features as one
+    // version 4 payload
+    bool publishFeatureBatch(const char* topic, const DetailedSegmentQuality* segments, const time_t* timestamps, size_t count) {
+        if (count == 0 || count > SEGMENT_BATCH_SIZE) return false;
+        return publishPayload(topic, encodeSegmentFeaturePayload(_payload, sizeof(_payload), DEVICE_ID, segments, timestamps, count));
     }
 
     // Disconnect from RabbitMQ
@@ -113,7 +220,8 @@ public:
     }
 
     // Send data in a callback function
-    void sendDataCallback(SegmentQuality& segmentData, time_t timestamp=0) {
+    // Returns whether the segment was published
+    bool sendDataCallback(SegmentQuality& segmentData, time_t timestamp=0) {
         // Attempt to connect to RabbitMQ if not connected
         if (connect()) {
             Serial.println("Connected to RabbitMQ");
@@ -121,12 +229,41 @@ public:
             // Publish data to RabbitMQ
             if (publishSegmentQuality(TOPIC, segmentData, timestamp)) {
                 Serial.println("SegmentQuality data sent successfully.");
+                return true;
             } else {
                 Serial.println("Failed to send SegmentQuality data.");
             }
         } else {
             Serial.println("Failed to connect to RabbitMQ");
         }
+        return false;
+    }
+
+    // Batched sendDataCallback(): connects once for up to
+    // SEGMENT_BATCH_SIZE segments; returns whether they were published
+    bool sendBatchCallback(const SegmentQuality* segments, const time_t* timestamps, size_t count) {
+        if (!connect()) {
+            Serial.println("Failed to connect to RabbitMQ");
+            return false;
+        }
+        if (!publishSegmentBatch(TOPIC, segments, timestamps, count)) {
+            Serial.println("Failed to send SegmentQuality batch.");
+            return false;
+        }
+        return true;
+    }
+
+    // sendBatchCallback() for segments with their features, on FEATURE_TOPIC
+    bool sendFeatureBatchCallback(const DetailedSegmentQuality* segments, const time_t* timestamps, size_t count) {
+        if (!connect()) {
+            Serial.println("Failed to connect to RabbitMQ");
+            return false;
+        }
+        if (!publishFeatureBatch(FEATURE_TOPIC, segments, timestamps, count)) {
+            Serial.println("Failed to send feature batch.");
+            return false;
+        }
+        return true;
     }
 
 private:
@@ -136,6 +273,17 @@ private:
     const char* _password;
     WiFiClient _wifiClient;      // WiFi client for Portenta
     PubSubClient _mqttClient;    // MQTT client for communication
+    uint8_t _payload[MQTT_BUFFER_SIZE]; // Payload being published, built in place
+
+    // Publish the length bytes built in _payload; 0 means they did not fit
+    bool publishPayload(const char* topic, size_t length) {
+        if (length == 0) {
+            Serial.println("Failed to publish: payload does not fit its buffer.");
+            _errorCode = SEGMENT_PAYLOAD_OVERFLOW;
+            return false;
+        }
+        return publish(topic, _payload, length);
+    }
 
     bool ensureConnected() {
         if (!_mqttClient.connected()) {
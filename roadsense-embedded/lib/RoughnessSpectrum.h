@@ -0,0 +1,217 @@
+#pragma once
+
+// Roughness spectrum of a segment: RMS Z acceleration in bands of spatial
+// frequency, from a fixed-point real FFT.
+//
+// Only the samples of the segment itself go into its spectrum (Welch's
+// method): frames of SPECTRUM_FFT_SIZE samples overlapping by half, plus
+// at the end one frame over the last SPECTRUM_FFT_SIZE samples if at least
+// half a hop has arrived since the last frame. The power per bin is
+// averaged over the frames. A segment shorter than a frame (a 1 m segment
+// above 28 km/h at 1 kHz) is one frame with its window stretched over the
+// samples it has and zero-padded to SPECTRUM_FFT_SIZE; below
+// SPECTRUM_MIN_SAMPLES samples the bands are 0.
+//
+// Each frame has its mean removed, a Hann window applied and is shifted to
+// use the q15 range (block floating point) before the FFT; the shift is
+// undone on the powers. The FFT is arm_rfft_q15 on the M7 when CMSIS-DSP is
+// available (see BlockDsp.h) and a radix-2 q15 FFT with the same scaling
+// (1/N) everywhere else.
+//
+// The bands are octaves of spatial frequency (cycles per metre), mapped to
+// bins with the speed of the segment, so that a road feature lands in the
+// same band at any speed. Band values are scaled by
+// SPECTRUM_REFERENCE_KMPH / speed, as the acceleration a given road
+// produces grows with speed. A band narrower than the bins it falls
+// between (low spatial frequencies at low speed) reports 0.
+
+#include <Arduino.h>
+#include <math.h>
+#include "SegmentQuality.h"
+#include "BlockDsp.h"
+
+#define SPECTRUM_FFT_BITS 7
+#define SPECTRUM_FFT_SIZE (1 << SPECTRUM_FFT_BITS) // Samples per FFT frame
+#define SPECTRUM_FFT_HOP (SPECTRUM_FFT_SIZE / 2) // Samples between frames (50% overlap)
+#define SPECTRUM_MIN_SAMPLES 16 // Fewest samples of a segment for a spectrum
+#define SPECTRUM_REFERENCE_KMPH 30.0 // Band values are scaled to this speed
+
+// Band edges [cycles/m]: wavelengths of 1 m down to 6 cm
+static const float SPECTRUM_BAND_EDGES[SPECTRUM_BANDS + 1] = {1.0f, 2.0f, 4.0f, 8.0f, 16.0f};
+
+class RoughnessSpectrum {
+  public:
+    static const bool enabled = true; // Spectrum policy of the RoadQualifier (NoSpectrum: none)
+
+    explicit RoughnessSpectrum(float sampleRateHz) : sampleRateHz(sampleRateHz) {
+      for (size_t i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+        window[i] = toQ15(0.5 - 0.5 * cos(2.0 * M_PI * i / SPECTRUM_FFT_SIZE)); // Periodic Hann
+      }
+#ifdef DSP_CMSIS
+      arm_rfft_init_q15(&fft, SPECTRUM_FFT_SIZE, 0, 1);
+#else
+      for (size_t k = 0; k < SPECTRUM_FFT_SIZE / 2; k++) {
+        cosTable[k] = toQ15(cos(2.0 * M_PI * k / SPECTRUM_FFT_SIZE));
+        sinTable[k] = toQ15(sin(2.0 * M_PI * k / SPECTRUM_FFT_SIZE));
+      }
+#endif
+      reset();
+    }
+
+    // Starts a new segment
+    void reset() {
+      for (size_t k = 0; k < SPECTRUM_FFT_SIZE / 2; k++) powerSums[k] = 0.0;
+      frames = 0;
+      windowPower = 0.0;
+      samples = 0;
+      pending = 0;
+    }
+
+    void addBlock(const int16_t* z, size_t n) {
+      for (size_t i = 0; i < n; i++) {
+        history[head] = z[i];
+        head = (head + 1) % SPECTRUM_FFT_SIZE;
+        samples++;
+        if (++pending >= SPECTRUM_FFT_HOP && samples >= SPECTRUM_FFT_SIZE) transform(SPECTRUM_FFT_SIZE);
+      }
+    }
+
+    // Band values of the segment driven at speedKmph
+    SegmentSpectrum finish(double speedKmph) {
+      if (samples < SPECTRUM_FFT_SIZE) {
+        if (samples >= SPECTRUM_MIN_SAMPLES) transform(samples);
+      } else if (pending >= SPECTRUM_FFT_HOP / 2) {
+        transform(SPECTRUM_FFT_SIZE);
+      }
+
+      SegmentSpectrum result = {};
+      result.frames = frames;
+      if (speedKmph <= 0.0 || windowPower == 0.0) return result;
+      double binsPerCycle = speedKmph / 3.6 * SPECTRUM_FFT_SIZE / sampleRateHz; // Bin of 1 cycle/m
+      // One-sided spectrum, mean over the frames weighted by their window power
+      double scale = 2.0 / windowPower;
+      double speedScale = SPECTRUM_REFERENCE_KMPH / speedKmph;
+      for (uint8_t b = 0; b < SPECTRUM_BANDS; b++) {
+        long low = lround(SPECTRUM_BAND_EDGES[b] * binsPerCycle);
+        long high = lround(SPECTRUM_BAND_EDGES[b + 1] * binsPerCycle);
+        if (low < 1) low = 1; // Bin 0 is the mean
+        if (high > SPECTRUM_FFT_SIZE / 2) high = SPECTRUM_FFT_SIZE / 2;
+        double power = 0.0;
+        for (long k = low; k < high; k++) power += powerSums[k];
+        double rms = sqrt(power * scale) * speedScale;
+        result.bands[b] = rms > UINT16_MAX ? UINT16_MAX : (uint16_t)lround(rms);
+      }
+      return result;
+    }
+
+  private:
+    float sampleRateHz;
+    int16_t history[SPECTRUM_FFT_SIZE] = {}; // Last SPECTRUM_FFT_SIZE samples, oldest at head
+    size_t head = 0;
+    size_t samples = 0; // Samples of the segment
+    size_t pending = 0; // Samples of the segment since the last frame
+    double powerSums[SPECTRUM_FFT_SIZE / 2]; // Power per bin summed over the frames of the segment
+    double windowPower = 0.0; // Hann window power (3/8 of a full frame) summed over the frames
+    uint16_t frames = 0;
+    int16_t window[SPECTRUM_FFT_SIZE];
+#ifdef DSP_CMSIS
+    arm_rfft_instance_q15 fft;
+    q15_t input[SPECTRUM_FFT_SIZE];
+    q15_t output[2 * SPECTRUM_FFT_SIZE]; // Interleaved real and imaginary parts
+#else
+    int16_t cosTable[SPECTRUM_FFT_SIZE / 2];
+    int16_t sinTable[SPECTRUM_FFT_SIZE / 2];
+    int16_t real[SPECTRUM_FFT_SIZE];
+    int16_t imag[SPECTRUM_FFT_SIZE];
+#endif
+
+    static int16_t toQ15(double value) {
+      long q = lround(value * 32768.0);
+      return q > INT16_MAX ? INT16_MAX : (int16_t)q;
+    }
+
+    // FFT of the last length samples, zero-padded to SPECTRUM_FFT_SIZE,
+    // into powerSums
+    void transform(size_t length) {
+      pending = 0;
+      if (frames < UINT16_MAX) frames++;
+      else return;
+      windowPower += 0.375 * length / SPECTRUM_FFT_SIZE;
+
+      size_t first = head + SPECTRUM_FFT_SIZE - length; // Oldest sample of the frame
+      int32_t sum = 0;
+      for (size_t i = 0; i < length; i++) sum += history[(first + i) % SPECTRUM_FFT_SIZE];
+      int32_t mean = sum / (int32_t)length;
+
+      // Windowed deviations, the window stretched over length samples, then
+      // the shift that brings the largest into [2^13, 2^14): one bit of
+      // headroom for the butterflies
+      int32_t windowed[SPECTRUM_FFT_SIZE] = {};
+      int32_t largest = 0;
+      for (size_t i = 0; i < length; i++) {
+        int32_t x = history[(first + i) % SPECTRUM_FFT_SIZE] - mean;
+        windowed[i] = (int32_t)(((int64_t)x * window[i * SPECTRUM_FFT_SIZE / length]) >> 15);
+        int32_t magnitude = abs(windowed[i]);
+        if (magnitude > largest) largest = magnitude;
+      }
+      if (largest == 0) return;
+      int shift = 0;
+      while (largest << shift < (1 << 13)) shift++;
+      while (largest >> -shift >= (1 << 14)) shift--;
+
+#ifdef DSP_CMSIS
+      for (size_t i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+        input[i] = (q15_t)(shift >= 0 ? windowed[i] << shift : windowed[i] >> -shift);
+      }
+      arm_rfft_q15(&fft, input, output);
+      const q15_t* re = output;
+      const q15_t* im = output + 1;
+      const size_t stride = 2;
+#else
+      for (size_t i = 0; i < SPECTRUM_FFT_SIZE; i++) {
+        size_t j = reverseBits(i);
+        real[j] = (int16_t)(shift >= 0 ? windowed[i] << shift : windowed[i] >> -shift);
+        imag[j] = 0;
+      }
+      radix2();
+      const int16_t* re = real;
+      const int16_t* im = imag;
+      const size_t stride = 1;
+#endif
+      double unshift = ldexp(1.0, -2 * shift);
+      for (size_t k = 1; k < SPECTRUM_FFT_SIZE / 2; k++) {
+        int32_t r = re[k * stride], i = im[k * stride];
+        uint32_t power = (uint32_t)(r * r) + (uint32_t)(i * i);
+        powerSums[k] += power * unshift;
+      }
+    }
+
+#ifndef DSP_CMSIS
+    static size_t reverseBits(size_t i) {
+      size_t reversed = 0;
+      for (int bit = 0; bit < SPECTRUM_FFT_BITS; bit++) reversed |= ((i >> bit) & 1) << (SPECTRUM_FFT_BITS - 1 - bit);
+      return reversed;
+    }
+
+    // In-place decimation-in-time FFT of real/imag (bit-reversed input),
+    // halving every stage like the CMSIS q15 transforms: X[k] / N
+    void radix2() {
+      for (size_t size = 2, step = SPECTRUM_FFT_SIZE / 2; size <= SPECTRUM_FFT_SIZE; size <<= 1, step >>= 1) {
+        size_t half = size / 2;
+        for (size_t start = 0; start < SPECTRUM_FFT_SIZE; start += size) {
+          for (size_t k = 0; k < half; k++) {
+            int32_t wr = cosTable[k * step], wi = -sinTable[k * step]; // e^(-2 pi j k / size)
+            size_t a = start + k, b = a + half;
+            int32_t tr = (real[b] * wr - imag[b] * wi) >> 15;
+            int32_t ti = (real[b] * wi + imag[b] * wr) >> 15;
+            int32_t ar = real[a], ai = imag[a];
+            real[a] = (int16_t)((ar + tr) >> 1);
+            imag[a] = (int16_t)((ai + ti) >> 1);
+            real[b] = (int16_t)((ar - tr) >> 1);
+            imag[b] = (int16_t)((ai - ti) >> 1);
+          }
+        }
+      }
+    }
+#endif
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+// Streaming vibration features of a segment (RMS, peak-to-peak, crest
+// factor, kurtosis, exceedance counts), updated per accelerometer sample
+// with integer arithmetic in O(1) memory.
+//
+// Welford's update divides by the sample count on every sample, which does
+// not fit integer arithmetic. Instead the samples are taken relative to an
+// assumed mean (the mean of the previous segment, as segments follow each
+// other) and their power sums are accumulated exactly: the fourth powers in
+// 128 bits held in two 64-bit words. As the assumed mean is close to the
+// actual one, the central moments computed from these sums do not suffer
+// from cancellation, which is what Welford's update achieves. finish()
+// derives the features once per segment.
+//
+// addBlock() takes a frame of samples at once: minimum, maximum, sum and
+// sum of squares and the exceedance counts run as vector kernels
+// (BlockDsp.h) on the deviations from the assumed mean, the third and
+// fourth powers in one scalar pass. It gives the same sums as add() per
+// sample.
+
+#include <Arduino.h>
+#include <math.h>
+#include "SegmentQuality.h"
+#include "BlockDsp.h"
+
+// Exceedance levels: deviation from the assumed mean in raw units (16384 = 1 g)
+static const int32_t SEGMENT_EXCEEDANCE_THRESHOLDS[SEGMENT_EXCEEDANCE_LEVELS] = {1638, 4096, 8192};
+
+class SegmentFeatureAccumulator {
+  public:
+    // Starts a new segment; the mean of the last one becomes the assumed mean
+    void reset() {
+      if (count > 0) reference += (int32_t)lround((double)sum1 / count);
+      count = 0;
+      sum1 = sum3 = 0;
+      sum2 = sum4Low = sum4High = 0;
+      minimum = INT16_MAX;
+      maximum = INT16_MIN;
+      for (uint8_t i = 0; i < SEGMENT_EXCEEDANCE_LEVELS; i++) exceedances[i] = 0;
+    }
+
+    void add(int16_t z) {
+      if (!haveReference) {
+        reference = z;
+        haveReference = true;
+      }
+      int32_t d = (int32_t)z - reference;
+      uint32_t deviation = (uint32_t)abs(d);
+      uint32_t d2 = deviation * deviation; // deviation <= 65535
+      uint64_t d4 = (uint64_t)d2 * d2;
+      sum1 += d;
+      sum2 += d2;
+      sum3 += (int64_t)d * d2;
+      sum4Low += d4;
+      sum4High += sum4Low < d4; // Carry
+      count++;
+
+      if (z < minimum) minimum = z;
+      if (z > maximum) maximum = z;
+      for (uint8_t i = 0; i < SEGMENT_EXCEEDANCE_LEVELS; i++) {
+        if (deviation > (uint32_t)SEGMENT_EXCEEDANCE_THRESHOLDS[i] && exceedances[i] < UINT16_MAX) exceedances[i]++;
+      }
+    }
+
+    void addBlock(const int16_t* z, size_t n) {
+      if (n == 0) return;
+      if (!haveReference) {
+        reference = z[0];
+        haveReference = true;
+      }
+      int16_t frameMin, frameMax;
+      dspMinMax(z, n, frameMin, frameMax);
+      // Deviations must fit int16 (without INT16_MIN) for the kernels
+      if (frameMax - reference > INT16_MAX || reference - frameMin > INT16_MAX) {
+        for (size_t i = 0; i < n; i++) add(z[i]);
+        return;
+      }
+      if (frameMin < minimum) minimum = frameMin;
+      if (frameMax > maximum) maximum = frameMax;
+
+      int16_t deviations[DSP_FRAME_SIZE];
+      for (size_t start = 0; start < n; start += DSP_FRAME_SIZE) {
+        size_t length = n - start < DSP_FRAME_SIZE ? n - start : DSP_FRAME_SIZE;
+        dspOffset(z + start, length, reference, deviations);
+        sum1 += dspSum(deviations, length);
+        sum2 += dspSumSquares(deviations, length);
+        for (uint8_t level = 0; level < SEGMENT_EXCEEDANCE_LEVELS; level++) {
+          uint32_t above = exceedances[level] + dspCountAbsAbove(deviations, length, (int16_t)SEGMENT_EXCEEDANCE_THRESHOLDS[level]);
+          exceedances[level] = above > UINT16_MAX ? UINT16_MAX : (uint16_t)above;
+        }
+        for (size_t i = 0; i < length; i++) {
+          int32_t d = deviations[i];
+          uint32_t d2 = (uint32_t)(d * d); // |d| <= INT16_MAX
+          uint64_t d4 = (uint64_t)d2 * d2;
+          sum3 += (int64_t)d * d2;
+          sum4Low += d4;
+          sum4High += sum4Low < d4;
+        }
+      }
+      count += n;
+    }
+
+    SegmentFeatures finish() const {
+      SegmentFeatures features = {};
+      if (count == 0) return features;
+
+      // Central moments from the sums around the assumed mean
+      double n = (double)count;
+      double mean = sum1 / n;
+      double m2 = sum2 / n - mean * mean;
+      double sum4 = ldexp((double)sum4High, 64) + (double)sum4Low;
+      double m4 = sum4 / n - 4.0 * mean * (sum3 / n) + 6.0 * mean * mean * (sum2 / n) - 3.0 * mean * mean * mean * mean;
+
+      features.peakToPeak = (uint16_t)((int32_t)maximum - minimum);
+      features.samples = count > UINT16_MAX ? UINT16_MAX : (uint16_t)count;
+      for (uint8_t i = 0; i < SEGMENT_EXCEEDANCE_LEVELS; i++) features.exceedances[i] = exceedances[i];
+      if (m2 <= 0.0) return features;
+
+      double rms = sqrt(m2);
+      double absoluteMean = reference + mean;
+      double peak = fmax(maximum - absoluteMean, absoluteMean - minimum);
+      features.rms = toFixed(rms, 1.0);
+      features.crestFactor = toFixed(peak / rms, 256.0);
+      features.kurtosis = toFixed(m4 / (m2 * m2), 256.0);
+      return features;
+    }
+
+  private:
+    bool haveReference = false;
+    int32_t reference = 0; // Assumed mean
+    uint32_t count = 0;
+    int64_t sum1 = 0;      // Sum of d
+    uint64_t sum2 = 0;     // Sum of d^2
+    int64_t sum3 = 0;      // Sum of d^3
+    uint64_t sum4Low = 0;  // Sum of d^4, low and high 64 bits
+    uint64_t sum4High = 0;
+    int16_t minimum = INT16_MAX;
+    int16_t maximum = INT16_MIN;
+    uint16_t exceedances[SEGMENT_EXCEEDANCE_LEVELS] = {};
+
+    static uint16_t toFixed(double value, double scale) {
+      double scaled = value * scale + 0.5;
+      return scaled >= UINT16_MAX ? UINT16_MAX : (uint16_t)scaled;
+    }
+};
@@ -0,0 +1,502 @@
+#pragma once
+
+// Persistent store-and-forward queue of segments in flash.
+//
+// Segments that cannot be published (no WiFi, broker down) are appended to
+// a log in the flash region after the calibration area and published from
+// there, oldest first, once the connection is back. The read cursor only
+// moves when a segment has been published (advance()). The log survives
+// resets: begin() finds the newest sector, the end of the data and the last
+// persisted cursor.
+//
+// The region is a ring of erase sectors, written in order. Each sector
+// starts with a header page (magic, sequence number, erase count) followed
+// by entries aligned to the program size:
+// - segment blocks of up to 40 segments: the first one absolute (position
+//   in 1e-7 degrees, Unix time, quality), the others as 6 byte deltas to
+//   the previous one (int16 latitude and longitude, uint8 seconds,
+//   quality). A block is collected in RAM and programmed in one write of
+//   at most SEGMENT_LOG_BLOCK_SIZE bytes when it is full or on sync().
+// - cursor entries: the position of the oldest unpublished segment, written
+//   whenever a block has been published
+// Every entry has a checksum; one torn by a reset while programming is
+// skipped page by page.
+//
+// Sectors are reused round-robin, so all wear at the same rate (the header
+// keeps the erase count). When the writer reaches the sector that holds the
+// oldest unpublished segments the log is full: that sector is erased anyway
+// and its segments are counted as dropped.
+//
+// An unclean reset loses the block not yet programmed (sync() bounds its
+// age) and the cursor progress within the block being published, whose
+// segments are published again.
+
+#include <Arduino.h>
+#include <FlashIAPBlockDevice.h>
+#include <string.h>
+#include <time.h>
+#include "PackedSegment.h"
+
+#define SEGMENT_LOG_BLOCK_SIZE 256    // Largest entry [bytes] (a multiple of the program size)
+#define SEGMENT_LOG_MAX_SECTORS 16
+#define SEGMENT_LOG_SYNC_MS 5000      // Longest a segment waits in RAM for its block to be programmed
+#define SEGMENT_LOG_FORWARD_BATCHES 4 // Batches of logged segments published per call of forwardSegments()
+#define SEGMENT_LOG_MAGIC 0x474F4C52  // "RLOG"
+
+struct SegmentLogStats {
+  uint32_t appended;        // Segments appended
+  uint32_t consumed;        // Segments published from the log
+  uint32_t dropped;         // Segments lost: erased unpublished because the log was full, or not stored
+  uint32_t segmentBlocks;   // Segment blocks programmed
+  uint32_t cursorEntries;   // Cursor entries programmed
+  uint64_t bytesProgrammed; // Bytes programmed, headers and padding included
+  uint32_t sectorErases;    // Sectors erased
+};
+
+class SegmentLog {
+  public:
+    // Mounts the log on size bytes of device from start (whole erase
+    // sectors, at least two), formatting it if it holds no log
+    bool begin(FlashIAPBlockDevice* blockDevice, bd_addr_t start, bd_size_t size) {
+      device = nullptr;
+      base = start;
+      programSize = (uint32_t)blockDevice->get_program_size();
+      sectorSize = (uint32_t)blockDevice->get_erase_size(start);
+      sectorCount = (uint32_t)(size / sectorSize);
+      if (sectorCount > SEGMENT_LOG_MAX_SECTORS) sectorCount = SEGMENT_LOG_MAX_SECTORS;
+      if (sectorCount < 2 || programSize > SEGMENT_LOG_BLOCK_SIZE || SEGMENT_LOG_BLOCK_SIZE % programSize) return false;
+      device = blockDevice;
+      dataStart = roundUp(sizeof(SectorHeader));
+      pendingCount = pendingBytes = 0;
+      cacheValid = false;
+      stored = 0;
+      memset(&stats, 0, sizeof(stats));
+
+      // Sector headers
+      uint32_t newest = sectorCount;
+      for (uint32_t s = 0; s < sectorCount; s++) {
+        SectorHeader header;
+        device->read(&header, address(s, 0), sizeof(header));
+        bool valid = header.magic == SEGMENT_LOG_MAGIC && header.checksum == checksum(&header, offsetof(SectorHeader, checksum));
+        sequences[s] = valid ? header.sequence : 0;
+        eraseCounts[s] = valid ? header.eraseCount : 0;
+        if (valid && (newest == sectorCount || header.sequence > sequences[newest])) newest = s;
+      }
+      if (newest == sectorCount) {
+        // No log yet
+        writeSector = sectorCount - 1;
+        if (!startSector(0, 1)) {
+          device = nullptr;
+          return false;
+        }
+        writeSector = 0;
+        writeOffset = dataStart;
+        cursor = {0, dataStart, 0};
+        return true;
+      }
+
+      // The log is the run of consecutive sequence numbers ending at the
+      // newest sector, the other sectors are free
+      uint32_t oldest = newest;
+      for (uint32_t k = 1; k < sectorCount; k++) {
+        uint32_t previous = (oldest + sectorCount - 1) % sectorCount;
+        if (sequences[previous] == 0 || sequences[previous] != sequences[oldest] - 1) break;
+        oldest = previous;
+      }
+      for (uint32_t s = 0; s < sectorCount; s++) {
+        if (!inLog(s, oldest, newest)) sequences[s] = 0;
+      }
+
+      // End of the data and the last cursor
+      cursor = {oldest, dataStart, 0};
+      for (uint32_t s = oldest;; s = (s + 1) % sectorCount) {
+        uint32_t offset = dataStart;
+        EntryHeader header;
+        while (readEntry(s, offset, header)) {
+          if (header.type == ENTRY_CURSOR) {
+            CursorRecord record;
+            memcpy(&record, scratch + sizeof(EntryHeader), sizeof(record));
+            for (uint32_t c = 0; c < sectorCount; c++) {
+              if (sequences[c] != 0 && sequences[c] == record.sequence) cursor = {c, record.offset, record.index};
+            }
+          }
+          offset += roundUp(sizeof(EntryHeader) + header.length);
+        }
+        if (s == newest) {
+          writeSector = s;
+          writeOffset = offset;
+          break;
+        }
+      }
+
+      // Unpublished segments
+      for (uint32_t s = cursor.sector;; s = (s + 1) % sectorCount) {
+        stored += countSegments(s, s == cursor.sector ? cursor.offset : dataStart, s == cursor.sector ? cursor.index : 0);
+        if (s == writeSector) break;
+      }
+      return true;
+    }
+
+    bool isMounted() const { return device != nullptr; }
+
+    // Appends a segment qualified at unixTime (0 if unknown)
+    bool append(const PackedSegment& segment, time_t unixTime) {
+      if (!device) {
+        stats.dropped++;
+        return false;
+      }
+      LoggedSegment logged = {segment.latitude, segment.longitude, (uint32_t)unixTime, segment.quality};
+      if (pendingCount > 0 && !deltaFits(logged) && !sync()) {
+        stats.dropped++;
+        return false;
+      }
+      uint8_t* payload = pending + sizeof(EntryHeader) + pendingBytes;
+      if (pendingCount == 0) {
+        memcpy(payload, &logged.latitude, 4);
+        memcpy(payload + 4, &logged.longitude, 4);
+        memcpy(payload + 8, &logged.time, 4);
+        payload[12] = logged.quality;
+        pendingBytes = ANCHOR_SIZE;
+        pendingSince = millis();
+      } else {
+        int16_t latitude = (int16_t)(logged.latitude - last.latitude);
+        int16_t longitude = (int16_t)(logged.longitude - last.longitude);
+        memcpy(payload, &latitude, 2);
+        memcpy(payload + 2, &longitude, 2);
+        payload[4] = (uint8_t)(logged.time - last.time);
+        payload[5] = logged.quality;
+        pendingBytes += DELTA_SIZE;
+      }
+      last = logged;
+      pendingCount++;
+      stored++;
+      stats.appended++;
+      if (sizeof(EntryHeader) + pendingBytes + DELTA_SIZE > SEGMENT_LOG_BLOCK_SIZE) sync();
+      return true;
+    }
+
+    // Programs the segments collected in RAM as a block
+    bool sync() {
+      if (!device) return false;
+      if (pendingCount == 0) return true;
+      if (!writeEntry(pending, ENTRY_SEGMENTS, (uint8_t)pendingCount, pendingBytes)) return false;
+      stats.segmentBlocks++;
+      pendingCount = pendingBytes = 0;
+      return true;
+    }
+
+    // Programs the block in RAM once it is older than SEGMENT_LOG_SYNC_MS
+    bool syncIfDue() {
+      if (pendingCount == 0 || millis() - pendingSince < SEGMENT_LOG_SYNC_MS) return true;
+      return sync();
+    }
+
+    // Oldest unpublished segment and its Unix time (0 if unknown); the
+    // uptime stamp of the segment is not kept
+    bool peek(PackedSegment& segment, time_t& unixTime) {
+      return peek(&segment, &unixTime, 1) == 1;
+    }
+
+    // Up to max of the oldest unpublished segments (from one block) and
+    // their Unix times; returns how many
+    size_t peek(PackedSegment* segments, time_t* unixTimes, size_t max) {
+      if (!device || stored == 0) return 0;
+      if (!loadCursorEntry()) {
+        // The rest is in RAM
+        if (!sync() || !loadCursorEntry()) return 0;
+      }
+      size_t count = cacheCount - cursor.index;
+      if (count > max) count = max;
+      for (size_t i = 0; i < count; i++) {
+        const LoggedSegment& logged = cache[cursor.index + i];
+        segments[i] = {logged.latitude, logged.longitude, 0, logged.quality};
+        unixTimes[i] = (time_t)logged.time;
+      }
+      return count;
+    }
+
+    // Consumes count segments returned by peek() after they have been published
+    void advance(size_t count = 1) {
+      if (!cacheValid || cacheSector != cursor.sector || cacheOffset != cursor.offset) return;
+      if (count > cacheCount - cursor.index) count = cacheCount - cursor.index;
+      stored -= count;
+      stats.consumed += count;
+      cursor.index += count;
+      if (cursor.index == cacheCount) {
+        cursor.offset += cacheSize;
+        cursor.index = 0;
+        cacheValid = false;
+        writeCursor();
+      }
+    }
+
+    uint32_t size() const { return stored; } // Unpublished segments, the ones in RAM included
+    uint32_t getPendingCount() const { return pendingCount; } // Segments in RAM, not yet programmed
+    bool isEmpty() const { return stored == 0; }
+    uint32_t getSectorCount() const { return device ? sectorCount : 0; }
+    uint32_t getEraseCount(uint32_t sector) const { return eraseCounts[sector]; }
+    const SegmentLogStats& getStats() const { return stats; }
+
+  private:
+    static const uint8_t ENTRY_SEGMENTS = 0x01;
+    static const uint8_t ENTRY_CURSOR = 0x02;
+    static const uint32_t ANCHOR_SIZE = 13; // int32 latitude, int32 longitude, uint32 time, quality
+    static const uint32_t DELTA_SIZE = 6;   // int16 latitude, int16 longitude, uint8 seconds, quality
+    static const uint32_t MAX_BLOCK_SEGMENTS = 1 + (SEGMENT_LOG_BLOCK_SIZE - 8 - ANCHOR_SIZE) / DELTA_SIZE;
+
+    struct SectorHeader {
+      uint32_t magic;
+      uint32_t sequence;   // Increases by one per sector started, 0 is never used
+      uint32_t eraseCount;
+      uint32_t checksum;
+    };
+    struct EntryHeader {
+      uint8_t type;
+      uint8_t count;       // Segments in a segment block
+      uint16_t length;     // Payload bytes after the header
+      uint32_t checksum;   // Of the header fields and the payload
+    };
+    struct CursorRecord {
+      uint32_t sequence;   // Of the sector
+      uint32_t offset;     // Of the entry
+      uint32_t index;      // Segments of the entry already published
+    };
+    struct Position {
+      uint32_t sector;
+      uint32_t offset;
+      uint32_t index;
+    };
+    struct LoggedSegment {
+      int32_t latitude;
+      int32_t longitude;
+      uint32_t time;
+      uint8_t quality;
+    };
+
+    FlashIAPBlockDevice* device = nullptr;
+    bd_addr_t base = 0;
+    uint32_t programSize = 0;
+    uint32_t sectorSize = 0;
+    uint32_t sectorCount = 0;
+    uint32_t dataStart = 0;  // Offset of the first entry of a sector
+    uint32_t sequences[SEGMENT_LOG_MAX_SECTORS] = {};   // 0: not part of the log
+    uint32_t eraseCounts[SEGMENT_LOG_MAX_SECTORS] = {};
+    uint32_t writeSector = 0;
+    uint32_t writeOffset = 0;
+    Position cursor = {};
+    uint32_t stored = 0;
+
+    // Block collected in RAM (header space first)
+    uint8_t pending[SEGMENT_LOG_BLOCK_SIZE];
+    uint32_t pendingCount = 0;
+    uint32_t pendingBytes = 0;
+    unsigned long pendingSince = 0;
+    LoggedSegment last = {};
+
+    // Decoded block at the cursor
+    LoggedSegment cache[MAX_BLOCK_SEGMENTS];
+    uint32_t cacheCount = 0;
+    uint32_t cacheSector = 0;
+    uint32_t cacheOffset = 0;
+    uint32_t cacheSize = 0;
+    bool cacheValid = false;
+
+    uint8_t scratch[SEGMENT_LOG_BLOCK_SIZE]; // Entry read by readEntry(), cursor entry and sector header writes
+    SegmentLogStats stats = {};
+
+    static uint32_t checksum(const void* data, size_t length, uint32_t hash = 2166136261u) {
+      // FNV-1a
+      const uint8_t* bytes = (const uint8_t*)data;
+      for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+      }
+      return hash;
+    }
+
+    static uint32_t entryChecksum(const EntryHeader& header, const uint8_t* payload) {
+      return checksum(payload, header.length, checksum(&header, offsetof(EntryHeader, checksum)));
+    }
+
+    uint32_t roundUp(uint32_t bytes) const { return (bytes + programSize - 1) / programSize * programSize; }
+    bd_addr_t address(uint32_t sector, uint32_t offset) const { return base + (bd_addr_t)sector * sectorSize + offset; }
+
+    bool inLog(uint32_t sector, uint32_t oldest, uint32_t newest) const {
+      return (sector + sectorCount - oldest) % sectorCount <= (newest + sectorCount - oldest) % sectorCount;
+    }
+
+    bool deltaFits(const LoggedSegment& logged) const {
+      int32_t latitude = logged.latitude - last.latitude, longitude = logged.longitude - last.longitude;
+      return latitude >= INT16_MIN && latitude <= INT16_MAX && longitude >= INT16_MIN && longitude <= INT16_MAX &&
+             (logged.time == 0) == (last.time == 0) && logged.time >= last.time && logged.time - last.time <= UINT8_MAX;
+    }
+
+    // Reads the first valid entry at or after offset in sector into scratch,
+    // skipping torn ones (returns false at the end of the sector's data)
+    bool readEntry(uint32_t sector, uint32_t& offset, EntryHeader& header) {
+      while (offset + programSize <= sectorSize) {
+        device->read(&header, address(sector, offset), sizeof(header));
+        if (header.type == 0xFF && header.count == 0xFF && header.length == 0xFFFF) return false; // Erased
+        if (header.length <= SEGMENT_LOG_BLOCK_SIZE - sizeof(EntryHeader) && offset + roundUp(sizeof(EntryHeader) + header.length) <= sectorSize) {
+          device->read(scratch + sizeof(EntryHeader), address(sector, offset) + sizeof(EntryHeader), header.length);
+          if (header.checksum == entryChecksum(header, scratch + sizeof(EntryHeader))) return true;
+        }
+        offset += programSize;
+      }
+      return false;
+    }
+
+    // Segments in sector from the entry at offset on, less the first index
+    uint32_t countSegments(uint32_t sector, uint32_t offset, uint32_t index) {
+      uint32_t count = 0;
+      EntryHeader header;
+      while (readEntry(sector, offset, header)) {
+        if (header.type == ENTRY_SEGMENTS) {
+          count += header.count > index ? header.count - index : 0;
+          index = 0;
+        }
+        offset += roundUp(sizeof(EntryHeader) + header.length);
+      }
+      return count;
+    }
+
+    // Decodes the segment block at the cursor into the cache, moving the
+    // cursor past other entries and into the next sectors (returns false at
+    // the end of the programmed data)
+    bool loadCursorEntry() {
+      if (cacheValid && cacheSector == cursor.sector && cacheOffset == cursor.offset) return true;
+      while (true) {
+        EntryHeader header;
+        while (readEntry(cursor.sector, cursor.offset, header)) {
+          if (header.type == ENTRY_SEGMENTS && cursor.index < header.count) {
+            decodeBlock(header);
+            cacheSector = cursor.sector;
+            cacheOffset = cursor.offset;
+            cacheSize = roundUp(sizeof(EntryHeader) + header.length);
+            cacheValid = true;
+            return true;
+          }
+          cursor.offset += roundUp(sizeof(EntryHeader) + header.length);
+          cursor.index = 0;
+        }
+        if (cursor.sector == writeSector) return false;
+        cursor = {(cursor.sector + 1) % sectorCount, dataStart, 0};
+      }
+    }
+
+    void decodeBlock(const EntryHeader& header) {
+      const uint8_t* payload = scratch + sizeof(EntryHeader);
+      LoggedSegment logged;
+      memcpy(&logged.latitude, payload, 4);
+      memcpy(&logged.longitude, payload + 4, 4);
+      memcpy(&logged.time, payload + 8, 4);
+      logged.quality = payload[12];
+      cacheCount = header.count < MAX_BLOCK_SEGMENTS ? header.count : MAX_BLOCK_SEGMENTS;
+      cache[0] = logged;
+      for (uint32_t i = 1; i < cacheCount; i++) {
+        const uint8_t* delta = payload + ANCHOR_SIZE + (i - 1) * DELTA_SIZE;
+        int16_t latitude, longitude;
+        memcpy(&latitude, delta, 2);
+        memcpy(&longitude, delta + 2, 2);
+        logged.latitude += latitude;
+        logged.longitude += longitude;
+        logged.time += delta[4];
+        logged.quality = delta[5];
+        cache[i] = logged;
+      }
+    }
+
+    // Erases sector and starts it with sequence
+    bool startSector(uint32_t sector, uint32_t sequence) {
+      if (device->erase(address(sector, 0), sectorSize) != 0) return false;
+      stats.sectorErases++;
+      SectorHeader header = {SEGMENT_LOG_MAGIC, sequence, eraseCounts[sector] + 1, 0};
+      header.checksum = checksum(&header, offsetof(SectorHeader, checksum));
+      memset(scratch, 0xFF, dataStart);
+      memcpy(scratch, &header, sizeof(header));
+      sequences[sector] = sequence;
+      eraseCounts[sector] = header.eraseCount;
+      if (device->program(scratch, address(sector, 0), dataStart) != 0) return false;
+      stats.bytesProgrammed += dataStart;
+      return true;
+    }
+
+    // Room for an entry of size bytes, moving to the next sector if needed
+    bool reserve(uint32_t size) {
+      if (writeOffset + size <= sectorSize) return true;
+      uint32_t next = (writeSector + 1) % sectorCount;
+      if (sequences[next] != 0 && cursor.sector == next) {
+        // Full: the oldest unpublished segments go
+        uint32_t dropped = countSegments(next, cursor.offset, cursor.index);
+        stored -= dropped;
+        stats.dropped += dropped;
+        cursor = {(next + 1) % sectorCount, dataStart, 0};
+        cacheValid = false;
+      }
+      if (!startSector(next, sequences[writeSector] + 1)) return false;
+      writeSector = next;
+      writeOffset = dataStart;
+      return writeOffset + size <= sectorSize;
+    }
+
+    // Programs buffer (header space, then length bytes of payload) as an entry
+    bool writeEntry(uint8_t* buffer, uint8_t type, uint8_t count, uint32_t length) {
+      uint32_t size = roundUp(sizeof(EntryHeader) + length);
+      if (!reserve(size)) return false;
+      EntryHeader header = {type, count, (uint16_t)length, 0};
+      header.checksum = entryChecksum(header, buffer + sizeof(EntryHeader));
+      memcpy(buffer, &header, sizeof(header));
+      memset(buffer + sizeof(EntryHeader) + length, 0xFF, size - sizeof(EntryHeader) - length);
+      int err = device->program(buffer, address(writeSector, writeOffset), size);
+      writeOffset += size; // Also past pages a failed write may have programmed
+      if (err != 0) return false;
+      stats.bytesProgrammed += size;
+      return true;
+    }
+
+    bool writeCursor() {
+      if (!reserve(roundUp(sizeof(EntryHeader) + sizeof(CursorRecord)))) return false;
+      CursorRecord record = {sequences[cursor.sector], cursor.offset, cursor.index};
+      memcpy(scratch + sizeof(EntryHeader), &record, sizeof(record));
+      if (!writeEntry(scratch, ENTRY_CURSOR, 0, sizeof(record))) return false;
+      stats.cursorEntries++;
+      return true;
+    }
+};
+
+// One round of the publisher: publishes up to SEGMENT_LOG_FORWARD_BATCHES
+// batches of logged segments, oldest first, then takes the new segments
+// from buffer: they are published directly while the log is empty and
+// publishing works, and appended to the log otherwise. Batches hold up to
+// Batch segments. timeOf(segment) gives the Unix time of a new segment,
+// publish(segments, unixTimes, count) publishes a batch and returns false
+// if it failed. Returns the number of segments published.
+template <size_t Batch, typename Buffer, typename TimeOf, typename Publish>
+uint32_t forwardSegments(SegmentLog& log, Buffer& buffer, bool online, TimeOf timeOf, Publish publish) {
+  uint32_t published = 0;
+  PackedSegment segments[Batch];
+  time_t unixTimes[Batch];
+  for (uint32_t i = 0; online && i < SEGMENT_LOG_FORWARD_BATCHES; i++) {
+    size_t count = log.peek(segments, unixTimes, Batch);
+    if (count == 0) break;
+    if (!publish(segments, unixTimes, count)) {
+      online = false;
+      break;
+    }
+    log.advance(count);
+    published += count;
+  }
+  while (size_t count = buffer.popN(segments, Batch)) {
+    for (size_t i = 0; i < count; i++) unixTimes[i] = timeOf(segments[i]);
+    if (online && log.isEmpty()) {
+      if (publish(segments, unixTimes, count)) {
+        published += count;
+        continue;
+      }
+      online = false;
+    }
+    for (size_t i = 0; i < count; i++) log.append(segments[i], unixTimes[i]);
+  }
+  log.syncIfDue();
+  return published;
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+// Binary segment payload, the compact alternative to the JSON messages.
+//
+// MQTT 3.1.1 (PubSubClient) has no message properties, so the payload
+// describes itself with a small header; the consumer tells it from JSON by
+// the magic bytes. Little-endian, version 1:
+//
+//   offset  size  field
+//   0       2     magic "RS"
+//   2       1     version (SEGMENT_PAYLOAD_VERSION)
+//   3       1     record count
+//   4       1     device id length n
+//   5       n     device id (ASCII)
+//   5+n     13    per record: int32 latitude, int32 longitude [1e-7 deg],
+//                 uint32 timestamp [Unix s], uint8 bumpiness
+//
+// Version 2 (SEGMENT_PAYLOAD_DELTA) has the same header. Consecutive
+// segments are about a metre apart, so after the first record, which is
+// written as above (the anchor), each record holds the differences to the
+// previous one: latitude, longitude and timestamp as zig-zag varints
+// (LEB128 of (d << 1) ^ (d >> 63), small differences of either sign take
+// one or two bytes), then the bumpiness byte as is.
+//
+// Version 3 (SEGMENT_PAYLOAD_DELTA_LZ) compresses the version 2 records,
+// the anchor included, with lib/Lzss.h; the decompressed bytes must parse
+// into exactly count records. The encoder falls back to version 2 when
+// the pass does not make the payload smaller.
+//
+// Version 4 (SEGMENT_PAYLOAD_FEATURES) carries the vibration features of
+// the segments (DetailedSegmentQuality) next to them. Each record is the
+// version 1 record followed by 13 uint16: rms, peak-to-peak, crest factor,
+// kurtosis, the 3 exceedance counts and the sample count (SegmentFeatures),
+// then the 4 spectrum bands and the FFT frame count (SegmentSpectrum, zero
+// without ROUGHNESS_SPECTRUM), 39 bytes in all. The firmware publishes it
+// on its own topic, so the segments also arrive in the formats above.
+//
+// A later version may add fields at the end of the records or change the
+// layout; the consumer rejects versions it does not know.
+
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "SegmentQuality.h"
+#include "Lzss.h"
+
+#define SEGMENT_PAYLOAD_MAGIC "RS"
+#define SEGMENT_PAYLOAD_VERSION 1
+#define SEGMENT_PAYLOAD_DELTA 2
+#define SEGMENT_PAYLOAD_DELTA_LZ 3
+#define SEGMENT_PAYLOAD_FEATURES 4
+#define SEGMENT_PAYLOAD_RECORD_SIZE 13
+#define SEGMENT_PAYLOAD_FEATURE_SIZE 26 // Features and spectrum after each version 4 record
+#define SEGMENT_PAYLOAD_SCALE 1e7 // Position units per degree
+#define SEGMENT_PAYLOAD_DELTA_MAX 16 // Longest delta record: three 5 byte varints and the bumpiness
+
+static_assert(SEGMENT_EXCEEDANCE_LEVELS == 3 && SPECTRUM_BANDS == 4, "Version 4 records have 3 exceedance levels and 4 bands");
+
+// Bytes of a payload with count records from deviceIdLength bytes of device id
+constexpr size_t segmentPayloadSize(size_t deviceIdLength, size_t count) {
+  return 5 + deviceIdLength + count * SEGMENT_PAYLOAD_RECORD_SIZE;
+}
+
+// Encodes count segments into out; returns the payload size, or 0 if it
+// does not fit capacity (or count or the device id are too long)
+inline size_t encodeSegmentPayload(uint8_t* out, size_t capacity, const char* deviceId,
+                                   const SegmentQuality* segments, const time_t* timestamps, size_t count) {
+  size_t idLength = strlen(deviceId);
+  if (count > 255 || idLength > 255 || segmentPayloadSize(idLength, count) > capacity) return 0;
+  out[0] = SEGMENT_PAYLOAD_MAGIC[0];
+  out[1] = SEGMENT_PAYLOAD_MAGIC[1];
+  out[2] = SEGMENT_PAYLOAD_VERSION;
+  out[3] = (uint8_t)count;
+  out[4] = (uint8_t)idLength;
+  memcpy(out + 5, deviceId, idLength);
+  uint8_t* record = out + 5 + idLength;
+  for (size_t i = 0; i < count; i++) {
+    int32_t latitude = (int32_t)lround(segments[i].latitude * SEGMENT_PAYLOAD_SCALE);
+    int32_t longitude = (int32_t)lround(segments[i].longitude * SEGMENT_PAYLOAD_SCALE);
+    uint32_t timestamp = (uint32_t)timestamps[i];
+    // The Portenta and the host are little-endian
+    memcpy(record, &latitude, 4);
+    memcpy(record + 4, &longitude, 4);
+    memcpy(record + 8, &timestamp, 4);
+    record[12] = segments[i].quality;
+    record += SEGMENT_PAYLOAD_RECORD_SIZE;
+  }
+  return segmentPayloadSize(idLength, count);
+}
+
+// Bytes of a version 4 payload with count records
+constexpr size_t segmentFeaturePayloadSize(size_t deviceIdLength, size_t count) {
+  return 5 + deviceIdLength + count * (SEGMENT_PAYLOAD_RECORD_SIZE + SEGMENT_PAYLOAD_FEATURE_SIZE);
+}
+
+// Encodes count segments with their features as a version 4 payload into
+// out; returns the payload size, or 0 if it does not fit capacity (or count
+// or the device id are too long)
+inline size_t encodeSegmentFeaturePayload(uint8_t* out, size_t capacity, const char* deviceId,
+                                          const DetailedSegmentQuality* segments, const time_t* timestamps, size_t count) {
+  size_t idLength = strlen(deviceId);
+  if (count > 255 || idLength > 255 || segmentFeaturePayloadSize(idLength, count) > capacity) return 0;
+  out[0] = SEGMENT_PAYLOAD_MAGIC[0];
+  out[1] = SEGMENT_PAYLOAD_MAGIC[1];
+  out[2] = SEGMENT_PAYLOAD_FEATURES;
+  out[3] = (uint8_t)count;
+  out[4] = (uint8_t)idLength;
+  memcpy(out + 5, deviceId, idLength);
+  uint8_t* record = out + 5 + idLength;
+  for (size_t i = 0; i < count; i++) {
+    const DetailedSegmentQuality& segment = segments[i];
+    int32_t latitude = (int32_t)lround(segment.latitude * SEGMENT_PAYLOAD_SCALE);
+    int32_t longitude = (int32_t)lround(segment.longitude * SEGMENT_PAYLOAD_SCALE);
+    uint32_t timestamp = (uint32_t)timestamps[i];
+    const uint16_t features[SEGMENT_PAYLOAD_FEATURE_SIZE / 2] = {
+      segment.features.rms, segment.features.peakToPeak, segment.features.crestFactor, segment.features.kurtosis,
+      segment.features.exceedances[0], segment.features.exceedances[1], segment.features.exceedances[2],
+      segment.features.samples,
+      segment.spectrum.bands[0], segment.spectrum.bands[1], segment.spectrum.bands[2], segment.spectrum.bands[3],
+      segment.spectrum.frames,
+    };
+    memcpy(record, &latitude, 4);
+    memcpy(record + 4, &longitude, 4);
+    memcpy(record + 8, &timestamp, 4);
+    record[12] = segment.quality;
+    memcpy(record + SEGMENT_PAYLOAD_RECORD_SIZE, features, sizeof(features));
+    record += SEGMENT_PAYLOAD_RECORD_SIZE + SEGMENT_PAYLOAD_FEATURE_SIZE;
+  }
+  return segmentFeaturePayloadSize(idLength, count);
+}
+
+// Largest version 2 payload with count records (all differences at the
+// extreme); version 3 payloads are never larger
+constexpr size_t segmentDeltaPayloadMaxSize(size_t deviceIdLength, size_t count) {
+  return 5 + deviceIdLength + (count > 0 ? SEGMENT_PAYLOAD_RECORD_SIZE + (count - 1) * SEGMENT_PAYLOAD_DELTA_MAX : 0);
+}
+
+// Appends the zig-zag varint of value at out; returns its length
+inline size_t writeZigZagVarint(uint8_t* out, int64_t value) {
+  uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+  size_t length = 0;
+  while (zigzag >= 0x80) {
+    out[length++] = (uint8_t)(zigzag | 0x80);
+    zigzag >>= 7;
+  }
+  out[length++] = (uint8_t)zigzag;
+  return length;
+}
+
+// Encodes count segments as a version 2 payload into out; returns the
+// payload size, or 0 if it does not fit capacity (or count or the device id
+// are too long)
+inline size_t encodeSegmentDeltaPayload(uint8_t* out, size_t capacity, const char* deviceId,
+                                        const SegmentQuality* segments, const time_t* timestamps, size_t count) {
+  size_t idLength = strlen(deviceId);
+  if (count == 0 || count > 255 || idLength > 255) return 0;
+
+  // The anchor must fit; each delta record is checked before it is written
+  if (5 + idLength + SEGMENT_PAYLOAD_RECORD_SIZE > capacity) return 0;
+  out[0] = SEGMENT_PAYLOAD_MAGIC[0];
+  out[1] = SEGMENT_PAYLOAD_MAGIC[1];
+  out[2] = SEGMENT_PAYLOAD_DELTA;
+  out[3] = (uint8_t)count;
+  out[4] = (uint8_t)idLength;
+  memcpy(out + 5, deviceId, idLength);
+  size_t length = 5 + idLength;
+  int32_t previousLatitude = 0, previousLongitude = 0;
+  uint32_t previousTimestamp = 0;
+  for (size_t i = 0; i < count; i++) {
+    int32_t latitude = (int32_t)lround(segments[i].latitude * SEGMENT_PAYLOAD_SCALE);
+    int32_t longitude = (int32_t)lround(segments[i].longitude * SEGMENT_PAYLOAD_SCALE);
+    uint32_t timestamp = (uint32_t)timestamps[i];
+    if (i == 0) {
+      memcpy(out + length, &latitude, 4);
+      memcpy(out + length + 4, &longitude, 4);
+      memcpy(out + length + 8, &timestamp, 4);
+      length += 12;
+    } else {
+      uint8_t record[SEGMENT_PAYLOAD_DELTA_MAX];
+      size_t n = writeZigZagVarint(record, (int64_t)latitude - previousLatitude);
+      n += writeZigZagVarint(record + n, (int64_t)longitude - previousLongitude);
+      n += writeZigZagVarint(record + n, (int64_t)timestamp - previousTimestamp);
+      if (length + n + 1 > capacity) return 0;
+      memcpy(out + length, record, n);
+      length += n;
+    }
+    out[length++] = segments[i].quality;
+    previousLatitude = latitude;
+    previousLongitude = longitude;
+    previousTimestamp = timestamp;
+  }
+  return length;
+}
+
+// Turns the version 2 payload of length bytes into a version 3 payload in
+// out (which must not overlap it), or copies it if compressing does not
+// make it smaller; returns the size written, or 0 if it does not fit
+// capacity
+inline size_t compressSegmentPayload(const uint8_t* payload, size_t length, uint8_t* out, size_t capacity) {
+  if (length < 5 || payload[2] != SEGMENT_PAYLOAD_DELTA || 5 + (size_t)payload[4] > length) return 0;
+  size_t headerLength = 5 + payload[4];
+  size_t recordsLength = length - headerLength;
+  size_t packed = 0;
+  if (capacity > headerLength && recordsLength > 1) {
+    size_t room = capacity - headerLength < recordsLength - 1 ? capacity - headerLength : recordsLength - 1;
+    packed = lzssCompress(payload + headerLength, recordsLength, out + headerLength, room);
+  }
+  if (packed == 0) {
+    if (length > capacity) return 0;
+    memcpy(out, payload, length);
+    return length;
+  }
+  memcpy(out, payload, headerLength);
+  out[2] = SEGMENT_PAYLOAD_DELTA_LZ;
+  return headerLength + packed;
+}
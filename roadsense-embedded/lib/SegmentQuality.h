@@ -6,4 +6,30 @@ struct SegmentQuality {
   double longitude;
   uint8_t quality;
 };
-#endif // SEGMENTQUALITY_H
\ No newline at end of file
+
+#define SEGMENT_EXCEEDANCE_LEVELS 3
+#define SPECTRUM_BANDS 4
+
+// Vibration features of a segment's Z acceleration (raw sensor units,
+// 16384 = 1 g), see SegmentFeatures.h
+struct SegmentFeatures {
+  uint16_t rms;          // RMS about the segment mean
+  uint16_t peakToPeak;   // Maximum - minimum
+  uint16_t crestFactor;  // Largest deviation from the mean / RMS [1/256]
+  uint16_t kurtosis;     // Fourth central moment / variance^2 (3 for Gaussian noise) [1/256]
+  uint16_t exceedances[SEGMENT_EXCEEDANCE_LEVELS]; // Samples deviating by more than 0.1 g, 0.25 g, 0.5 g
+  uint16_t samples;      // Samples in the segment (saturates)
+};
+
+// Roughness spectrum of a segment's Z acceleration, see RoughnessSpectrum.h
+struct SegmentSpectrum {
+  uint16_t bands[SPECTRUM_BANDS]; // RMS per band of 1-2, 2-4, 4-8, 8-16 cycles/m, scaled to 30 km/h (raw units)
+  uint16_t frames;                // FFT frames averaged
+};
+
+// Segment quality with the vibration features it was derived from
+struct DetailedSegmentQuality : SegmentQuality {
+  SegmentFeatures features;
+  SegmentSpectrum spectrum; // All zero without ROUGHNESS_SPECTRUM
+};
+#endif // SEGMENTQUALITY_H
@@ -0,0 +1,161 @@
+#pragma once
+
+// Speed compensation of the segment metric.
+//
+// The acceleration a road produces grows with speed, so the same pothole
+// gives a larger peak at 50 km/h than at 15 km/h. The calibration range is
+// therefore kept per speed bucket: during calibration every measurement is
+// filed under the bucket nearest to the current speed, and each bucket's
+// min/max is its range. Buckets that did not get enough of the calibration
+// drive are filled from the others with a power law, metric ~ speed^e.
+// The exponent e is fitted to the maxima of the buckets that have their
+// own range (least squares in log-log); when they span less than
+// SPEED_EXPONENT_SPREAD in speed it is SPEED_EXPONENT, a placeholder that
+// has not been validated on real roads.
+// A segment is quantized with the range interpolated between the two
+// buckets around its speed, so its quality byte means the same at any
+// speed.
+
+#include <Arduino.h>
+#include <math.h>
+
+#define SPEED_BUCKETS 8
+#define SPEED_EXPONENT 0.75       // Exponent without a fit (placeholder, chosen on the synthetic drives of host/tracegen)
+#define SPEED_EXPONENT_SPREAD 2.0 // The fitted buckets must span this speed ratio, else SPEED_EXPONENT
+#define SPEED_EXPONENT_MIN 0.0    // Fitted exponents are clamped to this range
+#define SPEED_EXPONENT_MAX 2.0
+#define SPEED_REFERENCE_KMPH 30.0 // Speed of a range given without speed (e.g. replay --calibration)
+#define SPEED_MIN_KMPH 5.0        // Slower measurements are not used for calibration
+#define SPEED_BUCKET_MIN_SHARE 0.2 // Share of the calibration measurements a bucket needs to keep its own range
+
+// Bucket centres [km/h]
+static const float SPEED_BUCKET_KMPH[SPEED_BUCKETS] = {10.0f, 20.0f, 30.0f, 40.0f, 50.0f, 65.0f, 85.0f, 110.0f};
+
+struct SpeedBucketCalibration {
+  int32_t minValue;
+  int32_t maxValue;
+};
+
+// Factor that takes a metric measured at fromKmph to toKmph
+inline double speedScale(double fromKmph, double toKmph, double exponent = SPEED_EXPONENT) {
+  return pow(toKmph / fromKmph, exponent);
+}
+
+inline uint8_t nearestSpeedBucket(double kmph) {
+  uint8_t nearest = 0;
+  for (uint8_t b = 1; b < SPEED_BUCKETS; b++) {
+    if (fabs(kmph - SPEED_BUCKET_KMPH[b]) < fabs(kmph - SPEED_BUCKET_KMPH[nearest])) nearest = b;
+  }
+  return nearest;
+}
+
+// Fills every bucket from a range measured at referenceKmph
+inline void fillSpeedBuckets(SpeedBucketCalibration (&buckets)[SPEED_BUCKETS], int32_t minValue, int32_t maxValue,
+                             double referenceKmph = SPEED_REFERENCE_KMPH, double exponent = SPEED_EXPONENT) {
+  for (uint8_t b = 0; b < SPEED_BUCKETS; b++) {
+    double scale = speedScale(referenceKmph, SPEED_BUCKET_KMPH[b], exponent);
+    buckets[b] = {(int32_t)lround(minValue * scale), (int32_t)lround(maxValue * scale)};
+  }
+}
+
+// Calibration range at `kmph`, interpolated linearly between the buckets
+inline SpeedBucketCalibration speedCalibrationAt(const SpeedBucketCalibration (&buckets)[SPEED_BUCKETS], double kmph) {
+  if (kmph <= SPEED_BUCKET_KMPH[0]) return buckets[0];
+  for (uint8_t b = 1; b < SPEED_BUCKETS; b++) {
+    if (kmph <= SPEED_BUCKET_KMPH[b]) {
+      double t = (kmph - SPEED_BUCKET_KMPH[b - 1]) / (SPEED_BUCKET_KMPH[b] - SPEED_BUCKET_KMPH[b - 1]);
+      return {(int32_t)lround(buckets[b - 1].minValue + t * (buckets[b].minValue - buckets[b - 1].minValue)),
+              (int32_t)lround(buckets[b - 1].maxValue + t * (buckets[b].maxValue - buckets[b - 1].maxValue))};
+    }
+  }
+  return buckets[SPEED_BUCKETS - 1];
+}
+
+// Collects the calibration measurements per speed bucket
+class SpeedCalibrator {
+  public:
+    void reset() {
+      for (uint8_t b = 0; b < SPEED_BUCKETS; b++) {
+        minValues[b] = INT32_MAX;
+        maxValues[b] = INT32_MIN;
+        counts[b] = 0;
+      }
+      total = 0;
+      fittedExponent = SPEED_EXPONENT;
+      fittedBuckets = 0;
+    }
+
+    // One calibration measurement (a value the min/max is taken over) at kmph
+    void add(int32_t value, double kmph) {
+      if (kmph < SPEED_MIN_KMPH) return;
+      uint8_t b = nearestSpeedBucket(kmph);
+      if (value < minValues[b]) minValues[b] = value;
+      if (value > maxValues[b]) maxValues[b] = value;
+      counts[b]++;
+      total++;
+    }
+
+    // Builds the bucket table; returns false without any measurement. The
+    // range of all measurements brought to SPEED_REFERENCE_KMPH is stored
+    // in referenceMin/referenceMax.
+    bool finish(SpeedBucketCalibration (&buckets)[SPEED_BUCKETS], int32_t& referenceMin, int32_t& referenceMax) {
+      if (total == 0) return false;
+      fitExponent();
+      double minimum = INFINITY, maximum = 0.0;
+      for (uint8_t b = 0; b < SPEED_BUCKETS; b++) {
+        if (counts[b] == 0) continue;
+        double scale = speedScale(SPEED_BUCKET_KMPH[b], SPEED_REFERENCE_KMPH, fittedExponent);
+        if (minValues[b] * scale < minimum) minimum = minValues[b] * scale;
+        if (maxValues[b] * scale > maximum) maximum = maxValues[b] * scale;
+      }
+      referenceMin = (int32_t)lround(minimum);
+      referenceMax = (int32_t)lround(maximum);
+      fillSpeedBuckets(buckets, referenceMin, referenceMax, SPEED_REFERENCE_KMPH, fittedExponent);
+      for (uint8_t b = 0; b < SPEED_BUCKETS; b++) {
+        if (hasOwnRange(b)) {
+          buckets[b] = {minValues[b], maxValues[b]};
+        }
+      }
+      return true;
+    }
+
+    // Exponent the last finish() used, and the buckets it was fitted to (0: SPEED_EXPONENT)
+    double exponent() const { return fittedExponent; }
+    uint8_t exponentBuckets() const { return fittedBuckets; }
+
+  private:
+    int32_t minValues[SPEED_BUCKETS];
+    int32_t maxValues[SPEED_BUCKETS];
+    uint32_t counts[SPEED_BUCKETS];
+    uint32_t total = 0;
+    double fittedExponent = SPEED_EXPONENT;
+    uint8_t fittedBuckets = 0;
+
+    bool hasOwnRange(uint8_t b) const {
+      return counts[b] >= total * SPEED_BUCKET_MIN_SHARE && minValues[b] < maxValues[b];
+    }
+
+    // Slope of log(max) over log(speed) of the buckets with their own range
+    void fitExponent() {
+      double sumX = 0.0, sumY = 0.0, sumXX = 0.0, sumXY = 0.0;
+      uint8_t n = 0, lowest = SPEED_BUCKETS, highest = 0;
+      for (uint8_t b = 0; b < SPEED_BUCKETS; b++) {
+        if (!hasOwnRange(b) || maxValues[b] <= 0) continue;
+        if (lowest == SPEED_BUCKETS) lowest = b;
+        highest = b;
+        double x = log(SPEED_BUCKET_KMPH[b]);
+        double y = log((double)maxValues[b]);
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+        n++;
+      }
+      fittedExponent = SPEED_EXPONENT;
+      fittedBuckets = 0;
+      if (n < 2 || SPEED_BUCKET_KMPH[highest] < SPEED_EXPONENT_SPREAD * SPEED_BUCKET_KMPH[lowest]) return;
+      double slope = (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+      fittedExponent = slope < SPEED_EXPONENT_MIN ? SPEED_EXPONENT_MIN : slope > SPEED_EXPONENT_MAX ? SPEED_EXPONENT_MAX : slope;
+      fittedBuckets = n;
+    }
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+// Lock-free single-producer / single-consumer ring buffer.
+//
+// One thread (or ISR) calls push()/pushN(), one other thread calls
+// pop()/popN(); no mutex is taken, so neither side blocks the other. The
+// capacity must be a power of two: indices run freely and are masked into
+// the array, and the producer publishes items with a release store of its
+// index that the consumer reads with acquire (and the other way round for
+// the freed slots).
+//
+// The overflow policy says what a push into a full buffer does:
+// - RingOverflow::DropNewest refuses the new items (wait-free)
+// - RingOverflow::DropOldest discards the oldest unread items to make room,
+//   by advancing the consumer index with a compare-and-swap. While the
+//   consumer is copying items out (a flag in its index) they are not
+//   discarded and the new items are refused instead, so the two sides never
+//   touch the same slot.
+// Either way the lost items are counted.
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+enum class RingOverflow {
+  DropNewest, // A push into a full buffer is refused
+  DropOldest  // A push into a full buffer replaces the oldest items
+};
+
+template <typename T, size_t Capacity, RingOverflow Overflow = RingOverflow::DropNewest>
+class SpscRingBuffer {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+  // Producer side
+  bool push(const T& item) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (makeRoom(h, 1) == 0) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    buffer[slotOf(h)] = item;
+    head.store(h + STEP, std::memory_order_release);
+    return true;
+  }
+
+  // Pushes up to n items, returns the number stored (the rest is dropped)
+  size_t pushN(const T* items, size_t n) {
+    size_t skipped = 0;
+    if (Overflow == RingOverflow::DropOldest && n > Capacity) {
+      // Only the last Capacity items can remain
+      skipped = n - Capacity;
+      items += skipped;
+      n = Capacity;
+    }
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t stored = makeRoom(h, n);
+    for (size_t i = 0; i < stored; i++) {
+      buffer[slotOf(h + i * STEP)] = items[i];
+    }
+    head.store(h + stored * STEP, std::memory_order_release);
+    if (skipped + n - stored > 0) {
+      dropped.fetch_add((uint32_t)(skipped + n - stored), std::memory_order_relaxed);
+    }
+    return stored;
+  }
+
+  // Consumer side
+  bool pop(T& item) {
+    return popN(&item, 1) == 1;
+  }
+
+  // Pops up to n items in order, returns the number popped
+  size_t popN(T* items, size_t n) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    if (t == h) return 0;
+    if (Overflow == RingOverflow::DropOldest) {
+      // Claim the unread items, the producer may have discarded some since
+      while (!tail.compare_exchange_weak(t, t | READING, std::memory_order_acquire, std::memory_order_relaxed)) {}
+      h = head.load(std::memory_order_acquire);
+    }
+    size_t available = (h - t) / STEP;
+    size_t popped = n < available ? n : available;
+    for (size_t i = 0; i < popped; i++) {
+      items[i] = buffer[slotOf(t + i * STEP)];
+    }
+    tail.store(t + popped * STEP, std::memory_order_release);
+    return popped;
+  }
+
+  size_t size() const {
+    size_t t = tail.load(std::memory_order_acquire) & ~READING;
+    size_t used = (head.load(std::memory_order_acquire) - t) / STEP;
+    return used < Capacity ? used : Capacity;
+  }
+  bool isEmpty() const { return size() == 0; }
+  bool isFull() const { return size() == Capacity; }
+  static constexpr size_t capacity() { return Capacity; }
+
+  // Items lost to overflow: refused, or discarded as the oldest (DropOldest)
+  uint32_t getDroppedCount() const { return dropped.load(std::memory_order_relaxed) + overwritten.load(std::memory_order_relaxed); }
+  // Of these, the items discarded as the oldest
+  uint32_t getOverwrittenCount() const { return overwritten.load(std::memory_order_relaxed); }
+
+private:
+  // Indices count in steps of 2, the low bit of tail is set while the
+  // consumer copies items out (DropOldest only)
+  static constexpr size_t STEP = 2;
+  static constexpr size_t READING = 1;
+
+  T buffer[Capacity];
+  std::atomic<size_t> head{0}; // written by the producer only
+  std::atomic<size_t> tail{0}; // written by the consumer, and by the producer when it discards items (DropOldest)
+  std::atomic<uint32_t> dropped{0};
+  std::atomic<uint32_t> overwritten{0};
+
+  static size_t slotOf(size_t index) { return (index / STEP) & (Capacity - 1); }
+
+  // Free slots for up to n (<= Capacity) items at head h, discarding the
+  // oldest items if the policy allows it
+  size_t makeRoom(size_t h, size_t n) {
+    size_t t = tail.load(std::memory_order_acquire);
+    while (true) {
+      size_t room = Capacity - (h - (t & ~READING)) / STEP;
+      if (room >= n || Overflow == RingOverflow::DropNewest || (t & READING)) {
+        return room < n ? room : n;
+      }
+      size_t discard = n - room;
+      if (tail.compare_exchange_weak(t, t + discard * STEP, std::memory_order_acq_rel, std::memory_order_acquire)) {
+        overwritten.fetch_add((uint32_t)discard, std::memory_order_relaxed);
+        return n;
+      }
+    }
+  }
+};
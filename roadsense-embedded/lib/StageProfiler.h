@@ -0,0 +1,126 @@
+#pragma once
+
+// Per-stage latency histograms for the RoadQualifier inner loop.
+//
+// StageProfiler is the Profiler policy of BasicRoadQualifier that records
+// them, NoStageProfiler the one that compiles to nothing and keeps no
+// state; PROFILE_STAGES selects StageProfiler for RoadQualifier (see
+// roadqualifier.h).
+// Ticks are CPU cycles on the M7 and nanoseconds on host builds (see
+// CycleCounter.h); on the host, waits on the virtual clock (delay()) cost
+// almost no real time.
+
+#include <Arduino.h>
+#include "CycleCounter.h"
+
+enum ProfileStage : uint8_t {
+  STAGE_GPS_READ,    // readGPSData()
+  STAGE_GPS_UPDATE,  // updateLocation() / updateSpeed()
+  STAGE_IMU_READ,    // imu.read(), or the sample queue drain with IMU_SAMPLER
+  STAGE_DISTANCE,    // peak difference and distance update
+  STAGE_DELAY,       // delay(DELAY_AFTER_ITERATION), or the wait for samples with IMU_SAMPLER
+  STAGE_COUNT
+};
+
+#define PROFILE_BUCKETS 32 // bucket b counts latencies in [2^b, 2^(b+1)) ticks
+
+struct StageHistogram {
+  uint32_t count;
+  uint32_t maxTicks;
+  uint64_t totalTicks;
+  uint32_t buckets[PROFILE_BUCKETS];
+
+  inline void record(uint32_t ticks) {
+    count++;
+    totalTicks += ticks;
+    if (ticks > maxTicks) maxTicks = ticks;
+    buckets[ticks ? 31 - __builtin_clz(ticks) : 0]++;
+  }
+
+  // Upper bound of the bucket holding the given quantile (0..1), at most
+  // the largest time recorded
+  uint32_t quantileUpperBound(float quantile) const {
+    uint32_t rank = (uint32_t)(quantile * count);
+    uint32_t seen = 0;
+    for (int b = 0; b < PROFILE_BUCKETS; b++) {
+      seen += buckets[b];
+      if (seen > rank) {
+        uint32_t bound = b >= 31 ? UINT32_MAX : (2u << b) - 1;
+        return bound < maxTicks ? bound : maxTicks;
+      }
+    }
+    return maxTicks;
+  }
+};
+
+class StageProfile {
+public:
+  StageProfile() { reset(); }
+
+  void reset() { memset(stages, 0, sizeof(stages)); }
+
+  inline void record(ProfileStage stage, uint32_t ticks) { stages[stage].record(ticks); }
+
+  const StageHistogram& stage(ProfileStage stage) const { return stages[stage]; }
+
+  static const char* stageName(ProfileStage stage) {
+    static const char* const names[STAGE_COUNT] = {"gps_read", "gps_update", "imu_read", "distance", "delay"};
+    return stage < STAGE_COUNT ? names[stage] : "?";
+  }
+
+  // Prints count, mean, p50, p99 and max per stage, then the histograms
+  void print(Print& out) const {
+    char line[112];
+    out.println(CycleCounter::countsCycles ? "stage          count     mean      p50      p99      max  [cycles]"
+                                           : "stage          count     mean      p50      p99      max  [ns]");
+    for (uint8_t s = 0; s < STAGE_COUNT; s++) {
+      const StageHistogram& h = stages[s];
+      snprintf(line, sizeof(line), "%-10s %9lu %8lu %8lu %8lu %8lu", stageName((ProfileStage)s),
+               (unsigned long)h.count, (unsigned long)(h.count ? h.totalTicks / h.count : 0),
+               (unsigned long)h.quantileUpperBound(0.5f), (unsigned long)h.quantileUpperBound(0.99f),
+               (unsigned long)h.maxTicks);
+      out.println(line);
+    }
+    for (uint8_t s = 0; s < STAGE_COUNT; s++) {
+      out.print(stageName((ProfileStage)s));
+      out.print(":");
+      for (int b = 0; b < PROFILE_BUCKETS; b++) {
+        if (!stages[s].buckets[b]) continue;
+        out.print(" 2^");
+        out.print(b);
+        out.print("=");
+        out.print((unsigned long)stages[s].buckets[b]);
+      }
+      out.println();
+    }
+  }
+
+private:
+  StageHistogram stages[STAGE_COUNT];
+};
+
+class StageProfiler {
+public:
+  void begin() { CycleCounter::begin(); }
+
+  // Starts timing at the current point
+  inline void start() { lap = CycleCounter::now(); }
+
+  // Charges the time since the previous probe to a stage
+  inline void lapTo(ProfileStage stage) {
+    CycleCounter::Ticks now = CycleCounter::now();
+    profile.record(stage, (uint32_t)(now - lap));
+    lap = now;
+  }
+
+  StageProfile profile;
+
+private:
+  CycleCounter::Ticks lap = 0;
+};
+
+struct NoStageProfiler {
+  void begin() {}
+  void start() {}
+  void lapTo(ProfileStage) {}
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+// Streaming quantile estimation for the online calibration.
+//
+// P2Quantile is the P-square algorithm (Jain and Chlamtac, 1985): five
+// markers track the minimum, the p/2, p and (1+p)/2 quantiles and the
+// maximum, and move by piecewise-parabolic interpolation as values arrive.
+// It needs no buffer, takes constant time per value and is trivially
+// copyable, so its state can be checkpointed to flash as it is.
+//
+// OnlineCalibrator tracks a low and a high quantile of the segment metric
+// as the calibration range: a single outlier moves a quantile by at most
+// one marker step, where it would define a min/max range.
+//
+// Both are trivial types, to be stored in CalibrationData: call reset()
+// before the first add().
+
+#include <Arduino.h>
+#include <math.h>
+
+#define ONLINE_CALIBRATION_LOW 0.02  // Quantile of the segment metric that maps to quality 0
+#define ONLINE_CALIBRATION_HIGH 0.98 // Quantile that maps to quality 255
+
+class P2Quantile {
+  public:
+    void reset(double quantile) {
+      p = quantile;
+      count = 0;
+    }
+
+    void add(double x) {
+      if (count < 5) {
+        heights[count++] = x;
+        if (count == 5) {
+          // Sort the first five values, they become the markers
+          for (int i = 1; i < 5; i++) {
+            for (int j = i; j > 0 && heights[j] < heights[j - 1]; j--) {
+              double swap = heights[j];
+              heights[j] = heights[j - 1];
+              heights[j - 1] = swap;
+            }
+          }
+          for (int i = 0; i < 5; i++) positions[i] = i + 1;
+          desired[0] = 1.0;
+          desired[1] = 1.0 + 2.0 * p;
+          desired[2] = 1.0 + 4.0 * p;
+          desired[3] = 3.0 + 2.0 * p;
+          desired[4] = 5.0;
+        }
+        return;
+      }
+      count++;
+
+      // Cell of x, extending the extremes
+      int k;
+      if (x < heights[0]) {
+        heights[0] = x;
+        k = 0;
+      } else if (x >= heights[4]) {
+        heights[4] = x;
+        k = 3;
+      } else {
+        k = 0;
+        while (x >= heights[k + 1]) k++;
+      }
+      for (int i = k + 1; i < 5; i++) positions[i] += 1.0;
+      desired[1] += p / 2.0;
+      desired[2] += p;
+      desired[3] += (1.0 + p) / 2.0;
+      desired[4] += 1.0;
+
+      // Move the middle markers that are a position or more off
+      for (int i = 1; i <= 3; i++) {
+        double d = desired[i] - positions[i];
+        if ((d >= 1.0 && positions[i + 1] - positions[i] > 1.0) || (d <= -1.0 && positions[i - 1] - positions[i] < -1.0)) {
+          int s = d > 0 ? 1 : -1;
+          double h = parabolic(i, s);
+          heights[i] = heights[i - 1] < h && h < heights[i + 1] ? h : linear(i, s);
+          positions[i] += s;
+        }
+      }
+    }
+
+    double value() const {
+      if (count >= 5) return heights[2];
+      if (count == 0) return 0.0;
+      // Sample quantile of the first values
+      double sorted[5];
+      for (uint32_t i = 0; i < count; i++) {
+        uint32_t j = i;
+        for (; j > 0 && sorted[j - 1] > heights[i]; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = heights[i];
+      }
+      return sorted[(uint32_t)lround(p * (count - 1))];
+    }
+
+    uint32_t values() const { return count; }
+
+  private:
+    double p;
+    uint32_t count;
+    double heights[5];   // Marker heights (the first values until there are five)
+    double positions[5]; // Marker positions, 1-based ranks
+    double desired[5];   // Desired marker positions
+
+    double parabolic(int i, int s) const {
+      return heights[i] + s / (positions[i + 1] - positions[i - 1]) *
+                            ((positions[i] - positions[i - 1] + s) * (heights[i + 1] - heights[i]) / (positions[i + 1] - positions[i]) +
+                             (positions[i + 1] - positions[i] - s) * (heights[i] - heights[i - 1]) / (positions[i] - positions[i - 1]));
+    }
+
+    double linear(int i, int s) const {
+      return heights[i] + s * (heights[i + s] - heights[i]) / (positions[i + s] - positions[i]);
+    }
+};
+
+class OnlineCalibrator {
+  public:
+    void reset() {
+      low.reset(ONLINE_CALIBRATION_LOW);
+      high.reset(ONLINE_CALIBRATION_HIGH);
+    }
+
+    void add(int32_t value) {
+      low.add(value);
+      high.add(value);
+    }
+
+    uint32_t count() const { return low.values(); }
+
+    // Current calibration range (maxValue > minValue)
+    void range(int32_t& minValue, int32_t& maxValue) const {
+      minValue = (int32_t)lround(low.value());
+      maxValue = (int32_t)lround(high.value());
+      if (maxValue <= minValue) maxValue = minValue + 1;
+    }
+
+  private:
+    P2Quantile low;
+    P2Quantile high;
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+// u-blox binary protocol (UBX) backend for the GPS module.
+//
+// begin() switches the receiver's UART to UBX output only at UBX_BAUD and
+// enables UBX-NAV-PVT (position, velocity, time) at UBX_NAV_RATE_HZ and
+// UBX-MON-HW (antenna status) once per second. encode() then decodes the
+// fixed-layout NAV-PVT payload by copying it into a UbxNavPvt struct: no
+// text, no number parsing, one checksum per frame. It has the same
+// interface as NmeaParser and publishes the same GpsSnapshot.
+//
+// The structs assume a little-endian CPU, like the protocol (Cortex-M7 and
+// x86 hosts are).
+
+#include <Arduino.h>
+#include "NmeaParser.h"
+
+#define UBX_BAUD 115200       // Receiver UART baud rate in UBX mode
+#define UBX_NAV_RATE_HZ 10    // Navigation solutions per second
+#define UBX_MAX_PAYLOAD 92    // Longest payload decoded (NAV-PVT); longer frames are skipped
+#define UBX_MAX_LENGTH 1024   // Longer length fields are taken as line noise
+
+#define UBX_SYNC_1 0xB5
+#define UBX_SYNC_2 0x62
+#define UBX_CLASS_NAV 0x01
+#define UBX_CLASS_CFG 0x06
+#define UBX_CLASS_MON 0x0A
+#define UBX_NAV_PVT 0x07
+#define UBX_CFG_PRT 0x00
+#define UBX_CFG_MSG 0x01
+#define UBX_CFG_RATE 0x08
+#define UBX_MON_HW 0x09
+
+// UBX-NAV-PVT payload (u-blox 8 / M8 protocol 15+)
+struct UbxNavPvt {
+  uint32_t iTOW;      // GPS time of week [ms]
+  uint16_t year;      // UTC
+  uint8_t month, day, hour, min, sec;
+  uint8_t valid;      // bit 0: validDate, bit 1: validTime
+  uint32_t tAcc;      // [ns]
+  int32_t nano;       // [ns]
+  uint8_t fixType;    // 0 none, 1 dead reckoning, 2 2D, 3 3D, 4 GNSS + DR, 5 time only
+  uint8_t flags;      // bit 0: gnssFixOK
+  uint8_t flags2;
+  uint8_t numSV;
+  int32_t lon;        // [1e-7 degrees]
+  int32_t lat;        // [1e-7 degrees]
+  int32_t height;     // [mm]
+  int32_t hMSL;       // [mm]
+  uint32_t hAcc;      // [mm]
+  uint32_t vAcc;      // [mm]
+  int32_t velN, velE, velD; // [mm/s]
+  int32_t gSpeed;     // Ground speed [mm/s]
+  int32_t headMot;    // [1e-5 degrees]
+  uint32_t sAcc;      // [mm/s]
+  uint32_t headAcc;   // [1e-5 degrees]
+  uint16_t pDOP;      // [0.01]
+  uint8_t flags3;
+  uint8_t reserved1[5];
+  int32_t headVeh;    // [1e-5 degrees]
+  int16_t magDec;     // [1e-2 degrees]
+  uint16_t magAcc;    // [1e-2 degrees]
+};
+static_assert(sizeof(UbxNavPvt) == 92, "UbxNavPvt must match the NAV-PVT payload layout");
+
+#define UBX_MON_HW_ASTATUS 20 // Offset of the antenna supervisor state in the MON-HW payload
+#define UBX_ANTENNA_SHORT 3
+#define UBX_ANTENNA_OPEN 4
+
+class UbxParser {
+  public:
+    // Opens `serial` at the receiver's power-up baud rate and configures the
+    // receiver for UBX output at UBX_BAUD. The port configuration is sent at
+    // both rates, so it also applies to a receiver that is still in UBX mode
+    // from before a reset of the board.
+    static void begin(HardwareSerial& serial, unsigned long baud) {
+      // UART1: 8N1, UBX and NMEA in, UBX out
+      uint8_t prt[20] = {1, 0, 0, 0, 0xD0, 0x08, 0, 0,
+                         (uint8_t)UBX_BAUD, (uint8_t)(UBX_BAUD >> 8), (uint8_t)(UBX_BAUD >> 16), (uint8_t)(UBX_BAUD >> 24),
+                         0x03, 0, 0x01, 0, 0, 0, 0, 0};
+      serial.begin(baud);
+      sendFrame(serial, UBX_CLASS_CFG, UBX_CFG_PRT, prt, sizeof(prt));
+      delay(100); // Transmit before the baud rate changes
+      serial.begin(UBX_BAUD);
+      sendFrame(serial, UBX_CLASS_CFG, UBX_CFG_PRT, prt, sizeof(prt));
+      delay(100);
+
+      // Measurement period [ms], one measurement per solution, UTC time reference
+      const uint16_t period = 1000 / UBX_NAV_RATE_HZ;
+      uint8_t rate[6] = {(uint8_t)period, (uint8_t)(period >> 8), 1, 0, 0, 0};
+      sendFrame(serial, UBX_CLASS_CFG, UBX_CFG_RATE, rate, sizeof(rate));
+
+      // Output rates relative to the navigation rate, on the current port
+      uint8_t pvt[3] = {UBX_CLASS_NAV, UBX_NAV_PVT, 1};
+      sendFrame(serial, UBX_CLASS_CFG, UBX_CFG_MSG, pvt, sizeof(pvt));
+      uint8_t hw[3] = {UBX_CLASS_MON, UBX_MON_HW, UBX_NAV_RATE_HZ};
+      sendFrame(serial, UBX_CLASS_CFG, UBX_CFG_MSG, hw, sizeof(hw));
+    }
+
+    // Feeds one byte; returns true when it completed a valid NAV-PVT or MON-HW frame
+    bool encode(char c) {
+      uint8_t b = (uint8_t)c;
+      switch (step) {
+        case SYNC_1:
+          if (b == UBX_SYNC_1) step = SYNC_2;
+          return false;
+        case SYNC_2:
+          step = b == UBX_SYNC_2 ? CLASS : (b == UBX_SYNC_1 ? SYNC_2 : SYNC_1);
+          return false;
+        case CLASS:
+          checksumA = checksumB = 0;
+          addToChecksum(b);
+          messageClass = b;
+          step = ID;
+          return false;
+        case ID:
+          addToChecksum(b);
+          messageId = b;
+          step = LENGTH_1;
+          return false;
+        case LENGTH_1:
+          addToChecksum(b);
+          length = b;
+          step = LENGTH_2;
+          return false;
+        case LENGTH_2:
+          addToChecksum(b);
+          length |= (uint16_t)b << 8;
+          received = 0;
+          step = length == 0 ? CHECKSUM_A : (length <= UBX_MAX_LENGTH ? PAYLOAD : SYNC_1);
+          return false;
+        case PAYLOAD:
+          addToChecksum(b);
+          if (received < UBX_MAX_PAYLOAD) payload[received] = b;
+          if (++received == length) step = CHECKSUM_A;
+          return false;
+        case CHECKSUM_A:
+          step = b == checksumA ? CHECKSUM_B : SYNC_1;
+          if (step == SYNC_1) checksumErrors++;
+          return false;
+        case CHECKSUM_B:
+          step = SYNC_1;
+          if (b != checksumB) {
+            checksumErrors++;
+            return false;
+          }
+          frames++;
+          return commit();
+      }
+      return false;
+    }
+
+    const GpsSnapshot& state() const { return current; }
+
+    uint32_t frames = 0;         // Frames with a valid checksum
+    uint32_t checksumErrors = 0; // Frames dropped for a bad checksum
+
+  private:
+    enum Step : uint8_t { SYNC_1, SYNC_2, CLASS, ID, LENGTH_1, LENGTH_2, PAYLOAD, CHECKSUM_A, CHECKSUM_B };
+
+    GpsSnapshot current;
+
+    // Frame being read
+    Step step = SYNC_1;
+    uint8_t messageClass = 0, messageId = 0;
+    uint16_t length = 0, received = 0;
+    uint8_t checksumA = 0, checksumB = 0;
+    alignas(4) uint8_t payload[UBX_MAX_PAYLOAD];
+
+    void addToChecksum(uint8_t b) {
+      checksumA += b;
+      checksumB += checksumA;
+    }
+
+    bool commit() {
+      unsigned long now = millis();
+      if (messageClass == UBX_CLASS_NAV && messageId == UBX_NAV_PVT && length == sizeof(UbxNavPvt)) {
+        UbxNavPvt pvt;
+        memcpy(&pvt, payload, sizeof(pvt));
+        if (pvt.valid & 0x02) {
+          current.hour = pvt.hour;
+          current.minute = pvt.min;
+          current.second = pvt.sec;
+        }
+        if ((pvt.valid & 0x03) == 0x03) {
+          current.year = pvt.year;
+          current.month = pvt.month;
+          current.day = pvt.day;
+          current.dateTimeValid = true;
+        }
+        if ((pvt.flags & 0x01) && pvt.fixType >= 2 && pvt.fixType <= 4) {
+          current.latitudeE7 = pvt.lat;
+          current.longitudeE7 = pvt.lon;
+          current.locationTime = now;
+          current.locationUpdates++;
+          current.speedMmps = pvt.gSpeed > 0 ? (uint32_t)pvt.gSpeed : 0;
+          current.speedTime = now;
+          current.speedUpdates++;
+        }
+        return true;
+      }
+      if (messageClass == UBX_CLASS_MON && messageId == UBX_MON_HW && length > UBX_MON_HW_ASTATUS) {
+        // Without an antenna supervisor the state is "unknown": only a
+        // detected short or open circuit counts as a fault
+        uint8_t antenna = payload[UBX_MON_HW_ASTATUS];
+        current.antennaOk = antenna != UBX_ANTENNA_SHORT && antenna != UBX_ANTENNA_OPEN;
+        current.antennaUpdates++;
+        return true;
+      }
+      return false;
+    }
+
+    static void sendFrame(Stream& serial, uint8_t messageClass, uint8_t messageId, const uint8_t* data, uint16_t size) {
+      uint8_t header[6] = {UBX_SYNC_1, UBX_SYNC_2, messageClass, messageId, (uint8_t)size, (uint8_t)(size >> 8)};
+      uint8_t a = 0, b = 0;
+      for (int i = 2; i < 6; i++) { a += header[i]; b += a; }
+      for (uint16_t i = 0; i < size; i++) { a += data[i]; b += a; }
+      serial.write(header, sizeof(header));
+      serial.write(data, size);
+      serial.write(a);
+      serial.write(b);
+    }
+};
@@ -3,31 +3,91 @@
 // Include necessary libraries
 #include <Wire.h>             // I2C for MPU6050
 #include <MPU6050.h>          // MPU6050 library by Electronic Cats
-#include <TinyGPS++.h>        // TinyGPS++ library by Mikal Hart
 #include <FlashIAPBlockDevice.h>
 #include "FlashIAPLimits.h"
 #include "SegmentQuality.h"
+#include "SegmentFeatures.h"
+#include "BlockDsp.h"
+#include "StageProfiler.h"
+#include "ImuAcquisition.h"
+#include "ImuSampler.h"
+#include "ImuFilter.h"
+#include "RoughnessSpectrum.h"
+#include "SpeedCompensation.h"
+#include "EqualizedQuantizer.h"
+#include "StreamingQuantile.h"
+#include "GpsParser.h"
+#include "GpsReceiver.h"
+#include "DeadReckoning.h"
 
 
 // Define constants
+// The switches below (and DUMMY_GPS, DUMMY_MPU) select the policies of the
+// RoadQualifier alias: sensors, GPS, acquisition, metric, spectrum,
+// calibration, profiling and debug output. Other configurations can
+// instantiate BasicRoadQualifier directly (see "RoadQualifier policies" below)
 // For debugging output, uncomment the following line
 #define DEBUG
-// To delete calibration data from flash memory, uncomment the following line
-//#define DELETE_CALIBRATION
+// For per-stage latency histograms of qualifySegment() (see StageProfiler.h), uncomment the following line
+//#define PROFILE_STAGES
+// For FIFO burst acquisition of the accelerometer at a fixed 1 kHz sample rate (see ImuAcquisition.h), uncomment the following line
+//#define IMU_FIFO
+// For a fixed sample clock (timer driven sampler thread, see ImuSampler.h) instead of reading the sensor once per loop iteration, uncomment the following line
+//#define IMU_SAMPLER
+// For a band-pass filtered acceleration (gravity and body motion removed, see ImuFilter.h) instead of sample-to-sample differences, uncomment the following line (needs IMU_FIFO or IMU_SAMPLER)
+//#define IMU_FILTER
+// For band energies of each segment from an FFT (see RoughnessSpectrum.h), uncomment the following line (needs IMU_FIFO or IMU_SAMPLER)
+//#define ROUGHNESS_SPECTRUM
+// For calibration ranges per speed bucket (see SpeedCompensation.h) instead of one range for all speeds, uncomment the following line
+//#define SPEED_COMPENSATION
+// For quality bytes that split the calibrated distribution into equal shares (see EqualizedQuantizer.h) instead of a linear min/max mapping, uncomment the following line
+//#define EQUALIZED_QUANTIZER
+// For a calibration range from running quantiles of the segments while qualifying (see StreamingQuantile.h) instead of a blocking calibration drive at the first start, uncomment the following line
+//#define ONLINE_CALIBRATION
+// For NMEA parsing on a separate low-priority thread (see GpsReceiver.h) instead of inside the sampling loop, uncomment the following line
+//#define GPS_THREAD
+// For the u-blox binary protocol (UBX NAV-PVT at 10 Hz, see UbxParser.h) instead of NMEA at 1 Hz, uncomment the following line
+//#define GPS_UBX
 
 // Define dummy sensor modules for testing without actual hardware
 // Comment out to use actual hardware
+// (host builds select the sensors on the compiler command line, see host/Makefile)
+#ifndef ROADSENSE_HOST
 #define DUMMY_GPS
 #define DUMMY_MPU
+#endif
+
+#if defined(IMU_FIFO) && defined(DUMMY_MPU)
+#error "IMU_FIFO needs the MPU6050 (or its host emulation), not DUMMY_MPU"
+#endif
+#if defined(GPS_THREAD) && defined(DUMMY_GPS)
+#error "GPS_THREAD needs the GPS module (or its host emulation), not DUMMY_GPS"
+#endif
+#if defined(EQUALIZED_QUANTIZER) && defined(SPEED_COMPENSATION)
+#error "EQUALIZED_QUANTIZER and SPEED_COMPENSATION each replace the linear calibration range, use one of them"
+#endif
+#if defined(ONLINE_CALIBRATION) && (defined(SPEED_COMPENSATION) || defined(EQUALIZED_QUANTIZER))
+#error "ONLINE_CALIBRATION estimates a single linear range, it cannot be combined with SPEED_COMPENSATION or EQUALIZED_QUANTIZER"
+#endif
+#if defined(GPS_UBX) && defined(DUMMY_GPS)
+#error "GPS_UBX needs the GPS module (or its host emulation), not DUMMY_GPS"
+#endif
 
-#define GPS_BAUD 9600         // GPS module baud rate
+#define GPS_BAUD 9600         // GPS module baud rate at power-up (UbxParser switches to UBX_BAUD)
 
 #define MAX_GPS_WAIT 20000    // Maximum time to wait for GPS data in milliseconds
 #define CALIBRATION_TIME_INITIAL_WAIT 5000
 #define CALIBRATION_TIME 20000 // Calibration time in milliseconds
-#define MIN_CALIBRATION_VALUE 2000 // Minimum value for calibration to avoid noise from sensor
+#define MIN_CALIBRATION_VALUE 2000 // Minimum value for calibration to avoid noise from sensor (DifferenceMetric)
 #define SEGMENT_LENGTH 1.    // Length of road segment in meters
 #define DELAY_AFTER_ITERATION 5 // Delay after each iteration in milliseconds (change for different numbers of iterations)
+#define GPS_MAX_FIX_AGE 2000  // Oldest GPS location/speed a segment may start from in milliseconds
+
+#define IMU_FILTER_HIGHPASS_HZ 3.0 // Removes gravity, body roll and bounce (sprung mass modes at 1-2 Hz)
+#define IMU_FILTER_LOWPASS_HZ 80.0 // Keeps wheel hop (10-15 Hz) and road texture up to here
+#define CALIBRATION_WINDOW_MS 100  // With FilteredMetric or EqualizedCalibration: calibration takes the peak per window of this length (about a segment)
+#define ONLINE_CALIBRATION_WARMUP 200 // With OnlineCalibration: segments before the running range replaces a stored one
+#define ONLINE_CALIBRATION_CHECKPOINT_MS 600000 // With OnlineCalibration: interval of the calibration checkpoints to flash
 
 #define DUMMY_GPS_SPEED 30.0f // Dummy speed for testing
 #define DUMMY_GPS_SPEED_STR "30.0" // Dummy speed string for testing
@@ -38,11 +98,19 @@
 
 using namespace mbed;
 
-// A known signature for calibration data
-static const uint32_t CALIBRATION_SIGNATURE = 0xDEADBEEF;
-
-// Struct to store calibration data
+// Calibration data in flash: the linear range, then what the calibration
+// policy stores (see "Calibration policies" below)
+template <class Stored>
 struct CalibrationData {
+  uint32_t signature; // Calibration::signature (one per layout: another layout must not load)
+  int32_t minZAccDifference; // With SpeedCalibration: brought to SPEED_REFERENCE_KMPH
+  int32_t maxZAccDifference;
+  Stored stored;
+};
+
+// A calibration policy without data of its own
+template <>
+struct CalibrationData<void> {
   uint32_t signature;
   int32_t minZAccDifference;
   int32_t maxZAccDifference;
@@ -53,7 +121,6 @@ struct CalibrationData {
 // ===================================================== //
 
 // --- Dummy MPU6050 class ---
-#ifdef DUMMY_MPU
 class DUMMY_MPU6050 {
   public:
     void initialize() {}
@@ -98,12 +165,9 @@ class DUMMY_MPU6050 {
     void PrintActiveOffsets() {}
     bool testConnection() { return true; }
 };
-#endif
-
-#ifdef DUMMY_GPS
 
 const float gpsDummySpeed = DUMMY_GPS_SPEED; // [km/h]
-const char* gpsDummySpeedStr = DUMMY_GPS_SPEED_STR; // [km/h]
+const char* const gpsDummySpeedStr = DUMMY_GPS_SPEED_STR; // [km/h]
 
 // --- Dummy location class to mimic TinyGPSLocation ---
 class DUMMY_TinyGPSLocation {
@@ -205,40 +269,757 @@ public:
     bool isUpdated() { return true; }
 };
 
-#endif
+// ====================================================== //
+// ================ RoadQualifier policies ============== //
+// ====================================================== //
+
+// RoadQualifier is a class template over eight policies, resolved at
+// compile time, so that every configuration is a specialization without
+// virtual calls and several can be built from one source:
+// - ImuDevice: the accelerometer, MPU6050 or DUMMY_MPU6050
+// - Gnss: where position, speed and time come from, SerialGnss<Parser>,
+//   ThreadedGnss<Parser> (Parser: NmeaParser or UbxParser) or DummyGnss
+// - Metric: the segment metric, DifferenceMetric or FilteredMetric
+// - Log: DebugLog or QuietLog
+// - Acquisition: how the ImuDevice is read, PolledImu, FifoImu or
+//   SampledImu<...> (default PolledImu)
+// - Spectrum: RoughnessSpectrum or NoSpectrum (default)
+// - Calibration: how the metric maps to the quality byte,
+//   LinearCalibration (default), SpeedCalibration, EqualizedCalibration or
+//   OnlineCalibration
+// - Profiler: StageProfiler or NoStageProfiler (default, see StageProfiler.h)
+// BasicRoadQualifier<...> names a configuration by its policies (bundled
+// in RoadQualifierPolicies for PolicyRoadQualifier). The RoadQualifier
+// alias below the class picks them with the switches at the top of this
+// file.
+
+// helper function to convert a given date/time to a Unix timestamp.
+// The algorithm is adapted from standard formulas for converting a date/time to Unix time.
+inline time_t dateTimeToUnix(int year, int month, int day, int hour, int minute, int second) {
+    // Unix time starts on Jan 1 1970 (UTC)
+    // Calculate days from 1970 until the given year
+    int a = (14 - month) / 12;
+    int y = year + 4800 - a;
+    int m = month + 12*a - 3;
+    
+    // Julian day number for this date
+    // Note: This formula is valid for year >= 1 (no leap second)
+    uint32_t julian_day = day + ((153*m + 2)/5) + 365*y + y/4 - y/100 + y/400 - 32045;
+    
+    // Julian day of Unix epoch (1970-01-01) is 2440588
+    uint32_t days_since_epoch = julian_day - 2440588;
+    
+    // Convert to seconds
+    time_t unix_time = (time_t)days_since_epoch*86400 + hour*3600 + minute*60 + second;
+    return unix_time;
+}
+
+// --- GNSS policies ---
+// A GNSS policy provides
+//   bool begin(unsigned long baud)   open the receiver (returns false if failed)
+//   void read()                      take in what was received since the last call
+//   bool antennaStatusKnown(), antennaConnected()
+//   bool hasRecentLocation(unsigned long maxAge)
+//   bool updateLocation(double& latitude, double& longitude, unsigned long& time)
+//   bool updateSpeed(double& kmph, unsigned long& time)
+//                                    new value since the last call (returns false if none)
+//   void nextSegment()               called after every valid segment
+//   time_t unixTime()                UTC of the last fix, 0 if unknown (safe from the publisher task)
+//   static const unsigned long readPeriodMs  pause between read() calls while waiting for the receiver
+
+// State of a GPS parser after the last read(), shared by the receiver policies
+class GnssSnapshotSource {
+  public:
+    bool antennaStatusKnown() const { return state.antennaUpdates > 0; }
+    bool antennaConnected() const { return state.antennaOk; }
+    bool hasRecentLocation(unsigned long maxAge) const {
+      return state.locationUpdates > 0 && millis() - state.locationTime < maxAge;
+    }
+
+    bool updateLocation(double& latitude, double& longitude, unsigned long& time) {
+      if (state.locationUpdates == seenLocationUpdates)
+        return false;
+
+      seenLocationUpdates = state.locationUpdates;
+      latitude = state.latitudeE7 * 1e-7;
+      longitude = state.longitudeE7 * 1e-7;
+      time = state.locationTime;
+      return true;
+    }
+
+    bool updateSpeed(double& kmph, unsigned long& time) {
+      if (state.speedUpdates == seenSpeedUpdates)
+        return false;
+
+      seenSpeedUpdates = state.speedUpdates;
+      kmph = state.speedMmps * 0.0036; // [mm/s] to [km/h]
+      time = state.speedTime;
+      return true;
+    }
+
+    void nextSegment() {}
+
+  protected:
+    GpsSnapshot state; // GPS state after the last read()
+    uint32_t seenLocationUpdates = 0;
+    uint32_t seenSpeedUpdates = 0;
+
+    static time_t unixTimeOf(const GpsSnapshot& snapshot) {
+      if (!snapshot.dateTimeValid) {
+        return 0;
+      }
+      return dateTimeToUnix(snapshot.year, snapshot.month, snapshot.day, snapshot.hour, snapshot.minute, snapshot.second);
+    }
+};
+
+// Parser (NmeaParser or UbxParser, see GpsParser.h) on Serial1, fed from the sampling loop
+template <class Parser>
+class SerialGnss : public GnssSnapshotSource {
+  public:
+    static const unsigned long readPeriodMs = 0;
+
+    bool begin(unsigned long baud) {
+      Parser::begin(Serial1, baud);
+      return true;
+    }
+
+    void read() {
+      bool updated = false;
+      while (Serial1.available() > 0) {
+        char c = Serial1.read();
+        if (parser.encode(c)) updated = true;
+      }
+      if (updated) {
+        state = parser.state();
+        published.publish(state);
+      }
+    }
+
+    // Called from the publisher task, while read() may run: the published
+    // copy of the snapshot
+    time_t unixTime() const { return unixTimeOf(published.read()); }
+
+  private:
+    Parser parser;
+    GpsSnapshotBuffer published;
+};
+
+// Parser on a receiver thread (see GpsReceiver.h)
+template <class Parser>
+class ThreadedGnss : public GnssSnapshotSource {
+  public:
+    static const unsigned long readPeriodMs = GPS_POLL_PERIOD_MS; // Let the receiver thread run
+
+    bool begin(unsigned long baud) {
+      if (!receiver.begin(baud)) {
+        Serial.println("Failed to start GPS receiver thread.");
+        return false;
+      }
+      return true;
+    }
+
+    void read() { state = receiver.snapshot(); }
+
+    time_t unixTime() const { return unixTimeOf(receiver.snapshot()); }
+
+  private:
+    GpsReceiver<Parser> receiver;
+};
+
+// Fixed speed, a new location every segment
+class DummyGnss {
+  public:
+    static const unsigned long readPeriodMs = 0;
+
+    DummyGnss()
+      : antennaStatus(gps, "GPTXT", 4),
+        speedKmph(gps, "GNVTG", 7) // $GNVTG term 7 is the speed over ground in km/h (term 6 is the "N" unit of the knots value)
+    {}
+
+    bool begin(unsigned long baud) {
+      Serial1.begin(baud);
+      return true;
+    }
+
+    void read() {}
+    bool antennaStatusKnown() { return antennaStatus.isUpdated(); }
+    bool antennaConnected() { return true; }
+    bool hasRecentLocation(unsigned long maxAge) { return gps.location.isValid() && gps.location.age() < maxAge; }
+
+    bool updateLocation(double& latitude, double& longitude, unsigned long& time) {
+      if (!gps.location.isUpdated() || !gps.location.isValid())
+        return false;
+
+      latitude = gps.location.lat();
+      longitude = gps.location.lng();
+      time = millis();
+      return true;
+    }
+
+    bool updateSpeed(double& kmph, unsigned long& time) {
+      if (!speedKmph.isUpdated() || speedKmph.value()[0] == '\0')
+        return false;
+
+      kmph = atof(speedKmph.value());
+      time = millis();
+      return true;
+    }
+
+    void nextSegment() { gps.nextLoc(); }
+
+    time_t unixTime() {
+      if (!gps.date.isValid() || !gps.time.isValid()) {
+        // If GPS time/date is not valid, return 0 or some error code
+        return 0;
+      }
+
+      int year   = (int)gps.date.year();   // e.g., 2024
+      int month  = (int)gps.date.month();  // 1-12
+      int day    = (int)gps.date.day();    // 1-31
+      int hour   = (int)gps.time.hour();   // 0-23
+      int minute = (int)gps.time.minute(); // 0-59
+      int second = (int)gps.time.second(); // 0-59
+
+      return dateTimeToUnix(year, month, day, hour, minute, second);
+    }
+
+  private:
+    DUMMY_TinyGPSPlus gps;
+    DUMMY_TinyGPSCustom antennaStatus;
+    DUMMY_TinyGPSCustom speedKmph;
+};
+
+// --- Acquisition policies ---
+// An acquisition policy chooses how the ImuDevice is read:
+//   template <class Mpu> using Reader   PolledAcquisition or FifoAcquisition (see ImuAcquisition.h)
+//   template <class R> using Sampler    ImuSampler<R> when a timer thread queues the samples (see ImuSampler.h), otherwise NoImuSampler
+//   static const bool sampled           the samples come from the Sampler (otherwise the loop reads the Reader)
+//   static const bool fixedRate         sampleRateHz is the actual sample rate
+//   static constexpr double sampleRateHz  [Hz]
+
+// Stands in for the ImuSampler when the loop reads the sensor itself
+struct NoImuSampler {
+  template <class Reader>
+  explicit NoImuSampler(Reader&) {}
+};
+
+// One sample per loop iteration, the rate follows the loop
+struct PolledImu {
+  template <class Mpu> using Reader = PolledAcquisition<Mpu>;
+  template <class R> using Sampler = NoImuSampler;
+  static const bool sampled = false;
+  static const bool fixedRate = false;
+  static constexpr double sampleRateHz = 0.0;
+};
+
+// Every sample since the last loop iteration from the FIFO, at its output data rate
+struct FifoImu {
+  template <class Mpu> using Reader = FifoAcquisition<Mpu>;
+  template <class R> using Sampler = NoImuSampler;
+  static const bool sampled = false;
+  static const bool fixedRate = true;
+  static constexpr double sampleRateHz = 1000.0 / (1 + FIFO_RATE_DIVIDER);
+};
+
+// Base read by the sampler thread every IMU_SAMPLER_PERIOD_US: a polled
+// sensor at the tick rate, the FIFO at its output data rate
+template <class Base>
+struct SampledImu {
+  template <class Mpu> using Reader = typename Base::template Reader<Mpu>;
+  template <class R> using Sampler = ImuSampler<R>;
+  static const bool sampled = true;
+  static const bool fixedRate = true;
+  static constexpr double sampleRateHz = Base::fixedRate ? Base::sampleRateHz : 1000000.0 / IMU_SAMPLER_PERIOD_US;
+};
+
+// --- Metric policies ---
+// A metric policy computes the segment metric, the value that is quantized
+// to the quality byte, and the calibration measurements:
+//   void start(int16_t z)               first sample after a pause
+//   int32_t peak(int16_t* z, size_t n)  metric of a block of samples (may
+//                                       transform z in place, the features
+//                                       see the result)
+//   void calibrate(int16_t z, F measurement)
+//                                       one calibration sample, calls
+//                                       measurement(value) when a measurement
+//                                       is complete
+//   static const bool windowed          a measurement per window of about a segment (otherwise per sample)
+//   static const int32_t calibrationFloor  only larger measurements set the calibration minimum
+//   static constexpr double sampleRateHz   the fixed rate the metric is built for (0: any rate)
+
+// Peak |sample-to-sample difference|
+class DifferenceMetric {
+  public:
+    static const bool windowed = false;
+    static const int32_t calibrationFloor = MIN_CALIBRATION_VALUE;
+    static constexpr double sampleRateHz = 0.0;
+
+    void start(int16_t z) { last = z; }
+
+    int32_t peak(int16_t* z, size_t n) {
+      int32_t diff = dspMaxAbsDifference(z, n, last);
+      if (diff == INT16_MAX) {
+        // Saturated: the exact difference can be larger (full scale swing)
+        int32_t before = last;
+        for (size_t i = 0; i < n; i++) {
+          int32_t exact = abs((int32_t)z[i] - before);
+          if (exact > diff) diff = exact;
+          before = z[i];
+        }
+      }
+      last = z[n - 1];
+      return diff;
+    }
+
+    template <class Measurement>
+    void calibrate(int16_t z, Measurement&& measurement) {
+      int32_t diff = abs((int32_t)z - (int32_t)last);
+      last = z;
+      measurement(diff);
+    }
+
+  private:
+    int16_t last = 0;
+};
+
+// Peak |band-passed acceleration| at the sample rate of Acquisition (see ImuFilter.h)
+template <class Acquisition>
+class FilteredMetric {
+  static_assert(Acquisition::fixedRate, "FilteredMetric needs a fixed sample rate (FifoImu or SampledImu)");
+
+  public:
+    static const bool windowed = true;
+    static const int32_t calibrationFloor = -1; // The filter removes the offset, every window counts
+    static constexpr double sampleRateHz = Acquisition::sampleRateHz;
+
+    void start(int16_t z) {
+      filter.reset(z);
+      windowCount = 0;
+      windowPeak = 0;
+    }
+
+    int32_t peak(int16_t* z, size_t n) {
+      filter.process(z, z, n);
+      int16_t minimum, maximum;
+      dspMinMax(z, n, minimum, maximum);
+      return -(int32_t)minimum > maximum ? -(int32_t)minimum : maximum;
+    }
+
+    // Peak per window of about a segment: the quietest window is the noise
+    // floor, the roughest one the maximum
+    template <class Measurement>
+    void calibrate(int16_t z, Measurement&& measurement) {
+      int16_t filtered;
+      filter.process(&z, &filtered, 1);
+      if (abs(filtered) > windowPeak)
+        windowPeak = abs(filtered);
+      if (++windowCount < WINDOW_SAMPLES)
+        return;
+
+      measurement(windowPeak);
+      windowCount = 0;
+      windowPeak = 0;
+    }
+
+  private:
+    static constexpr BiquadCoefficients stages[2] = {
+      butterworthHighPass(IMU_FILTER_HIGHPASS_HZ, sampleRateHz),
+      butterworthLowPass(IMU_FILTER_LOWPASS_HZ, sampleRateHz),
+    };
+    static const uint32_t WINDOW_SAMPLES = (uint32_t)(sampleRateHz * CALIBRATION_WINDOW_MS / 1000);
+    BiquadCascade<2> filter{stages};
+    uint32_t windowCount = 0;
+    int32_t windowPeak = 0;
+};
+
+// --- Spectrum policies ---
+// RoughnessSpectrum (band energies of each segment, see RoughnessSpectrum.h)
+// or NoSpectrum:
+//   explicit Spectrum(float sampleRateHz)
+//   void reset()                                start of a segment
+//   void addBlock(const int16_t* z, size_t n)
+//   SegmentSpectrum finish(double speedKmph)    bands of the segment
+//   static const bool enabled                   needs a fixed sample rate
+
+struct NoSpectrum {
+  static const bool enabled = false;
+
+  explicit NoSpectrum(float) {}
+  void reset() {}
+  void addBlock(const int16_t*, size_t) {}
+  SegmentSpectrum finish(double) { return {}; }
+};
+
+// --- Calibration policies ---
+// A calibration policy maps the segment metric to the quality byte. The
+// qualifier keeps the range minZAccDifference..maxZAccDifference for every
+// policy; the policy provides
+//   typedef Stored                    what it adds to CalibrationData (void: nothing)
+//   static const uint32_t signature   of CalibrationData<Stored>
+//   static const bool needsSpeed      the calibration drive files its measurements under the current speed
+//   static const bool online          no calibration drive, the range follows the segments (see OnlineCalibration)
+//   class Calibrator                  a calibration drive (not with online):
+//     explicit Calibrator(bool windowed)   windowed: Metric::windowed
+//     void add(int32_t value, double kmph, bool aboveFloor)  every measurement of the metric
+//     void tick()                          every loop iteration
+//     bool finish(Policy&, int32_t& minValue, int32_t& maxValue)  false if the drive did not calibrate
+//   uint8_t quantize(int32_t value, double kmph, int32_t minValue, int32_t maxValue) const
+//   void load(const CalibrationData<Stored>&), save(CalibrationData<Stored>&) const
+//   static void fromRange(CalibrationData<Stored>&)  complete a record that has only the range (replay --calibration)
+//   void reset(), start(), print() const  delete, qualifying starts, print after calibrating
+
+// Maps value in minValue..maxValue linearly to 0..255 (minValue < maxValue)
+inline uint8_t quantizeLinear(int32_t value, int32_t minValue, int32_t maxValue) {
+  // Clamp the value
+  if (value <= minValue) {
+    return 0;
+  } else if (value >= maxValue) {
+    return 255;
+  }
+
+  uint32_t range = (uint32_t)(maxValue - minValue);
+  
+  // Use 64-bit arithmetic to avoid overflow
+  // (value - minValue) * 255 might overflow 32-bit if the range is large
+  uint64_t numerator = (uint64_t)(value - minValue) * 255ULL + (range / 2ULL);
+  uint64_t result = numerator / range;
+
+  // result should always be <= 255, but clamp just in case
+  if (result > 255ULL) {
+    result = 255ULL;
+  }
+
+  return (uint8_t)result;
+}
+
+// One range for all speeds, from a calibration drive at the first start
+struct LinearCalibration {
+  typedef void Stored;
+  static const uint32_t signature = 0xDEADBEEF;
+  static const bool needsSpeed = false;
+  static const bool online = false;
+
+  struct Calibrator {
+    explicit Calibrator(bool) {}
+    void add(int32_t, double, bool) {}
+    void tick() {}
+    bool finish(LinearCalibration&, int32_t&, int32_t&) { return true; }
+  };
+
+  uint8_t quantize(int32_t value, double, int32_t minValue, int32_t maxValue) const {
+    return quantizeLinear(value, minValue, maxValue);
+  }
+  void load(const CalibrationData<Stored>&) {}
+  void save(CalibrationData<Stored>&) const {}
+  static void fromRange(CalibrationData<Stored>&) {}
+  void reset() {}
+  void start() {}
+  void print() const {}
+};
+
+// A range per speed bucket (see SpeedCompensation.h)
+class SpeedCalibration {
+  public:
+    struct Stored {
+      SpeedBucketCalibration speedBuckets[SPEED_BUCKETS];
+    };
+    static const uint32_t signature = 0xDEADBEF1;
+    static const bool needsSpeed = true;
+    static const bool online = false;
+
+    class Calibrator {
+      public:
+        explicit Calibrator(bool) { speedCalibrator.reset(); }
+
+        void add(int32_t value, double kmph, bool aboveFloor) {
+          if (aboveFloor) speedCalibrator.add(value, kmph);
+        }
+
+        void tick() {}
+
+        bool finish(SpeedCalibration& calibration, int32_t& minValue, int32_t& maxValue) {
+          if (!speedCalibrator.finish(calibration.speedBuckets, minValue, maxValue)) {
+            Serial.println("No calibration measurements while driving.");
+            return false;
+          }
+          Serial.print("Speed exponent: "); Serial.print(speedCalibrator.exponent());
+          if (speedCalibrator.exponentBuckets() > 0) {
+            Serial.print(" (fit of "); Serial.print(speedCalibrator.exponentBuckets()); Serial.println(" buckets)");
+          } else {
+            Serial.println(" (default, too few buckets with their own range)");
+          }
+          return true;
+        }
+
+      private:
+        SpeedCalibrator speedCalibrator;
+    };
+
+    uint8_t quantize(int32_t value, double kmph, int32_t, int32_t) const {
+      SpeedBucketCalibration range = speedCalibrationAt(speedBuckets, kmph);
+      return quantizeLinear(value, range.minValue, range.maxValue);
+    }
+
+    void load(const CalibrationData<Stored>& calData) {
+      memcpy(speedBuckets, calData.stored.speedBuckets, sizeof(speedBuckets));
+      print();
+    }
+
+    void save(CalibrationData<Stored>& calData) const {
+      memcpy(calData.stored.speedBuckets, speedBuckets, sizeof(speedBuckets));
+    }
+
+    // The range applies at SPEED_REFERENCE_KMPH, the speed model gives the buckets
+    static void fromRange(CalibrationData<Stored>& calData) {
+      fillSpeedBuckets(calData.stored.speedBuckets, calData.minZAccDifference, calData.maxZAccDifference);
+    }
+
+    void reset() { memset(speedBuckets, 0, sizeof(speedBuckets)); }
+    void start() {}
+
+    void print() const {
+      Serial.println("Calibration per speed bucket [km/h: min..max]:");
+      for (uint8_t b = 0; b < SPEED_BUCKETS; b++) {
+        Serial.print(SPEED_BUCKET_KMPH[b], 0);
+        Serial.print(": ");
+        Serial.print(speedBuckets[b].minValue);
+        Serial.print("..");
+        Serial.println(speedBuckets[b].maxValue);
+      }
+    }
+
+  private:
+    SpeedBucketCalibration speedBuckets[SPEED_BUCKETS] = {};
+};
+
+// Quality bytes that split the calibrated distribution into equal shares
+// (see EqualizedQuantizer.h)
+class EqualizedCalibration {
+  public:
+    struct Stored {
+      uint16_t quantizerThresholds[QUANTIZER_THRESHOLDS]; // Lower bound of quality 1..255
+    };
+    static const uint32_t signature = 0xDEADBEF2;
+    static const bool needsSpeed = false;
+    static const bool online = false;
+
+    // Distribution of the peak per window, which stands in for a segment
+    class Calibrator {
+      public:
+        explicit Calibrator(bool windowed) : windowed(windowed), windowStart(windowed ? 0 : millis()) {
+          peakHistogram.reset();
+        }
+
+        void add(int32_t value, double, bool) {
+          if (windowed)
+            peakHistogram.add(value);
+          else if (value > windowPeak)
+            windowPeak = value;
+        }
+
+        // Windows of per-sample measurements
+        void tick() {
+          if (!windowed && millis() - windowStart >= CALIBRATION_WINDOW_MS) {
+            peakHistogram.add(windowPeak);
+            windowPeak = 0;
+            windowStart = millis();
+          }
+        }
+
+        bool finish(EqualizedCalibration& calibration, int32_t&, int32_t&) {
+          if (!peakHistogram.equalizedThresholds(calibration.quantizerThresholds)) {
+            Serial.println("No calibration windows.");
+            return false;
+          }
+          Serial.print("Quality thresholds from "); Serial.print(peakHistogram.count()); Serial.println(" windows");
+          return true;
+        }
+
+      private:
+        PeakHistogram peakHistogram;
+        bool windowed;
+        unsigned long windowStart;
+        int32_t windowPeak = 0;
+    };
+
+    uint8_t quantize(int32_t value, double, int32_t, int32_t) const {
+      return quantizeWithThresholds(quantizerThresholds, value);
+    }
+
+    void load(const CalibrationData<Stored>& calData) {
+      memcpy(quantizerThresholds, calData.stored.quantizerThresholds, sizeof(quantizerThresholds));
+    }
+
+    void save(CalibrationData<Stored>& calData) const {
+      memcpy(calData.stored.quantizerThresholds, quantizerThresholds, sizeof(quantizerThresholds));
+    }
+
+    // A linear table: the same quality bytes as LinearCalibration
+    static void fromRange(CalibrationData<Stored>& calData) {
+      linearThresholds(calData.stored.quantizerThresholds, calData.minZAccDifference, calData.maxZAccDifference);
+    }
+
+    void reset() { memset(quantizerThresholds, 0, sizeof(quantizerThresholds)); }
+    void start() {}
+    void print() const {}
+
+  private:
+    uint16_t quantizerThresholds[QUANTIZER_THRESHOLDS] = {};
+};
+
+// A range from running quantiles of the segments while qualifying (see
+// StreamingQuantile.h), checkpointed to flash every
+// ONLINE_CALIBRATION_CHECKPOINT_MS. The calibration data is a log of
+// checkpoint records in the first erase block, each padded to the program
+// size; the last complete one is loaded
+class OnlineCalibration {
+  public:
+    struct Stored {
+      OnlineCalibrator onlineCalibrator; // Quantile estimates the range comes from (none in a range stored by replay --calibration)
+      uint32_t checksum; // checksum() of the record, detects a checkpoint cut short by a power loss
+    };
+    typedef CalibrationData<Stored> Record;
+    static const uint32_t signature = 0xDEADBEF3;
+    static const bool needsSpeed = false;
+    static const bool online = true;
+
+    // FNV-1a over the record up to the checksum
+    static uint32_t checksum(const Record& calData) {
+      const uint8_t* bytes = (const uint8_t*)&calData;
+      uint32_t hash = 2166136261u;
+      for (size_t i = 0; i < offsetof(Record, stored) + offsetof(Stored, checksum); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+      }
+      return hash;
+    }
+
+    uint8_t quantize(int32_t value, double, int32_t minValue, int32_t maxValue) const {
+      return quantizeLinear(value, minValue, maxValue);
+    }
+
+    // Adds the metric of a segment; the running range replaces a stored one once it has warmed up
+    void addSegment(int32_t value, int32_t& minValue, int32_t& maxValue) {
+      onlineCalibrator.add(value);
+      if (!storedRange || onlineCalibrator.count() >= ONLINE_CALIBRATION_WARMUP) {
+        onlineCalibrator.range(minValue, maxValue);
+      }
+    }
+
+    bool checkpointDue() const { return millis() - lastCheckpoint >= ONLINE_CALIBRATION_CHECKPOINT_MS; }
+    void checkpointed() { lastCheckpoint = millis(); }
+    uint32_t segments() const { return onlineCalibrator.count(); }
+
+    void load(const Record& calData) {
+      onlineCalibrator = calData.stored.onlineCalibrator;
+      if (onlineCalibrator.count() == 0) onlineCalibrator.reset(); // A range without estimates
+      storedRange = true;
+      Serial.print("Segments in the estimates: "); Serial.println(onlineCalibrator.count());
+    }
+
+    void save(Record& calData) const {
+      calData.stored.onlineCalibrator = onlineCalibrator;
+      calData.stored.checksum = checksum(calData);
+    }
+
+    // A range without estimates
+    static void fromRange(Record& calData) {
+      calData.stored.checksum = checksum(calData);
+    }
+
+    void reset() {
+      onlineCalibrator.reset();
+      storedRange = false;
+    }
+
+    // The first checkpoint is due ONLINE_CALIBRATION_CHECKPOINT_MS after qualifying starts
+    void start() { lastCheckpoint = millis(); }
+    void print() const {}
+
+  private:
+    OnlineCalibrator onlineCalibrator;
+    unsigned long lastCheckpoint = 0; // millis() of the last checkpoint
+    bool storedRange = false; // Range loaded from flash, used until the running range has warmed up
+};
+
+// --- Logging policies ---
+// debug: print every segment and the calibration details, check API use
+struct DebugLog {
+  static const bool debug = true;
+};
+
+struct QuietLog {
+  static const bool debug = false;
+};
 
 // ====================================================== //
 // ================= RoadQualifier class ================ //
 // ====================================================== //
 
-class RoadQualifier {
+// The policies of a RoadQualifier configuration (see "RoadQualifier
+// policies" above). Members are defined once for PolicyRoadQualifier<Policies>,
+// so a new policy only adds a parameter here and a typedef in the class.
+template <class ImuDeviceP, class GnssP, class MetricP, class LogP, class AcquisitionP = PolledImu,
+          class SpectrumP = NoSpectrum, class CalibrationP = LinearCalibration, class ProfilerP = NoStageProfiler>
+struct RoadQualifierPolicies {
+  typedef ImuDeviceP ImuDevice;
+  typedef GnssP Gnss;
+  typedef MetricP Metric;
+  typedef LogP Log;
+  typedef AcquisitionP Acquisition;
+  typedef SpectrumP Spectrum;
+  typedef CalibrationP Calibration;
+  typedef ProfilerP Profiler;
+};
+
+template <class Policies>
+class PolicyRoadQualifier {
+  typedef typename Policies::ImuDevice ImuDevice;
+  typedef typename Policies::Gnss Gnss;
+  typedef typename Policies::Metric Metric;
+  typedef typename Policies::Log Log;
+  typedef typename Policies::Acquisition Acquisition;
+  typedef typename Policies::Spectrum Spectrum;
+  typedef typename Policies::Calibration Calibration;
+  typedef typename Policies::Profiler Profiler;
+
+  static_assert(Metric::sampleRateHz == 0.0 || (Acquisition::fixedRate && Metric::sampleRateHz == Acquisition::sampleRateHz),
+                "The metric is built for another sample rate than the acquisition");
+  static_assert(!Spectrum::enabled || Acquisition::fixedRate, "The spectrum needs a fixed sample rate (FifoImu or SampledImu)");
+
   public:
     // ----- API ----- //
-    RoadQualifier(); // Constructor
     bool begin(); // Initialize class (returns false if failed) 
     bool isReady(); // Check if class is ready
-    bool qualifySegment(); // Analyze a <SEGMENT_LENGTH>m road segment (returns false if segment is invalid)
+    bool qualifySegment(); // Analyze the next <SEGMENT_LENGTH>m road segment, continuing where the previous call stopped (returns false if segment is invalid)
     SegmentQuality getSegmentQuality();  // Return the quality of the last validly qualified segment (only call after qualifySegment() returns true)
+    DetailedSegmentQuality getDetailedSegmentQuality(); // Same, with the vibration features (see SegmentFeatures.h) and, with RoughnessSpectrum, the band energies of the segment
+    static const bool hasSpectrum = Spectrum::enabled; // getDetailedSegmentQuality() has band energies
     bool deleteCalibrationFromFlash(); // Delete calibration data from flash memory (returns false if failed)   
+    FlashIAPBlockDevice* getFlashDevice(); // The initialized block device of the calibration, for the flash after calibrationAreaSize() (nullptr if failed)
+    bd_size_t calibrationAreaSize() const; // Bytes at the start of the flash device the calibration owns (whole erase blocks)
     
     time_t getUnixTime(); // Checks for valid GPS date and time and returns Unix time for mqtt message
 
+    static uint8_t quantifyToByte(int32_t value, int32_t minValue, int32_t maxValue); // Quantify a value to a byte based on min and max values
+
+    typedef CalibrationData<typename Calibration::Stored> CalibrationRecord; // Calibration data in flash
+    static CalibrationRecord calibrationRecord(int32_t minValue, int32_t maxValue); // Calibration data with the range minValue..maxValue (as replay --calibration stores it)
+
+    // With StageProfiler
+    const StageProfile& getStageProfile() const; // Per-stage latency histograms of qualifySegment() since the last reset
+    void printStageProfile(Print& out) const; // Print the per-stage latency summary and histograms
+    void resetStageProfile(); // Clear the per-stage latency histograms
+
   private:
+    typedef typename Acquisition::template Reader<ImuDevice> ImuReader;
+
     // ----- Sensor objects ----- //
-  #ifndef DUMMY_MPU
-    MPU6050 mpu;
-  #else
-    DUMMY_MPU6050 mpu;
-  #endif
-  #ifndef DUMMY_GPS
-    TinyGPSPlus gps;
-    TinyGPSCustom antennaStatus;
-    TinyGPSCustom speedKmph;
-  #else
-    DUMMY_TinyGPSPlus gps;
-    DUMMY_TinyGPSCustom antennaStatus;
-    DUMMY_TinyGPSCustom speedKmph;
-  #endif
+    ImuDevice mpu;
+    ImuReader imu{mpu};
+    typename Acquisition::template Sampler<ImuReader> sampler{imu};
+    Metric metric;
+    Spectrum spectrum{(float)Acquisition::sampleRateHz};
+    Gnss gnss;
 
     bool sensorsInitialized = false;
 
@@ -246,22 +1027,24 @@ class RoadQualifier {
     bool initializeMPU6050(); // Initialize MPU6050 sensor (returns false if not connected)
 
     bool initializeGPS(); // Initialize GPS module (returns false if not connected)
+    bool startGPS(); // Initialize GPS module and wait for a valid location and speed (returns false if failed)
     bool isGPSAntennaConnected(); // Check if GPS antenna is connected (returns false if not connected)
     bool waitForValidLocation(); // Wait for valid GPS location (returns false if not found within MAX_GPS_WAIT)
     bool waitForValidSpeed(); // Wait for valid speed data (returns false if not found within MAX_GPS_WAIT)
-    void readGPSData(); // Read GPS data from serial port
+    void readGPSData(); // Read GPS data from serial port (with ThreadedGnss: take a snapshot of the receiver state)
     bool updateLocation(); // Update current location after previous call to readGPSData() (returns false if not updated or invalid)
     bool updateSpeed(); // Update current speed after previous call to readGPSData() (returns false if not updated or invalid)
-
-    uint8_t quantifyToByte(int32_t value, int32_t minValue, int32_t maxValue); // Quantify a value to a byte based on min and max values
+    void processSamples(int16_t* z, size_t n); // Add a frame of Z acceleration samples to the current segment (filters them in place with FilteredMetric)
 
     // ----- Calibration functions ----- //
     bool calibrate(unsigned long calibrationTime); // Calibrate accelerations (returns false if failed)
+    void updateOnlineCalibration(); // With OnlineCalibration: add the segment peak to the running range, checkpoint it every ONLINE_CALIBRATION_CHECKPOINT_MS
 
     // ----- Flash memory handling ----- //
     bool initFlashMemory(); // Initialize flash memory for calibration data (returns false if failed)
     bool loadCalibrationFromFlash(); // Load calibration data from flash memory (returns false if failed)
     bool saveCalibrationToFlash(); // Save calibration data to flash memory (returns false if failed)x
+    size_t calibrationRecordSize() const; // Bytes a calibration record takes in flash (whole program blocks)
 
     // ----- Data ----- //
     // GPS data
@@ -271,84 +1054,169 @@ class RoadQualifier {
     double segmentLongitude = 0.0;
     double currentSpeedKmph = 0.0;
     double segmentDistance = 0.0;
+    double segmentOdometer = 0.0; // Distance driven before the current segment [m]
+    DeadReckoning deadReckoning; // Segment positions between GPS fixes
+    unsigned long lastLocationTime = 0; // millis() of the last location update
+    unsigned long lastSpeedTime = 0; // millis() of the last speed update
     // Acceleration data
-    int16_t lastZAcceleration = 0;
-    int16_t currentZAcceleration = 0;
-    int32_t accelerationDifference = 0;
-    int32_t peakSegmentZAccDifference = 0;
-    int16_t dummyAcc;
+    int32_t peakSegmentZAccDifference = 0; // Segment metric: peak |sample-to-sample difference| (with FilteredMetric: peak |filtered acceleration|)
+    SegmentFeatureAccumulator featureAccumulator; // Vibration features of the current segment
+    bool segmenterRunning = false; // Set by the first qualifySegment(), segments then follow each other without gaps
+    int16_t zSamples[Acquisition::sampled ? DSP_FRAME_SIZE : IMU_MAX_SAMPLES_PER_READ]; // Samples drained by the last imu.read() (sampled: frame of samples taken from the sampler)
+    unsigned long lastIterationEnd = 0; // millis() at the end of the last loop iteration (loop reads)
+    uint32_t lastSampleTime = 0; // Time of the last sample taken from the sampler [us]
+    uint32_t seenDroppedSamples = 0; // sampler.getDroppedCount() at the last check
+    unsigned long segmentSamples = 0;
     // Quality data
     uint8_t currentSegmentQuality;
+    SegmentFeatures currentSegmentFeatures = {};
+    SegmentSpectrum currentSegmentSpectrum = {};
     // Calibration values
     int32_t maxZAccDifference = 0;
     int32_t minZAccDifference = 0;
+    Calibration calibration; // What the policy adds to the range
+    size_t calibrationSlot = 0; // With OnlineCalibration: next free record of the calibration log
     // Flash memory handling
     FlashIAPBlockDevice* flashBD = nullptr;
     size_t programBlockSize;
     size_t eraseBlockSize;
     bool flashInitialized = false;
+    // Profiling
+    Profiler profiler;
 };
 
+// A configuration by its policies: BasicRoadQualifier<ImuDevice, Gnss,
+// Metric, Log[, Acquisition, Spectrum, Calibration, Profiler]>
+template <class ImuDevice, class Gnss, class Metric, class Log, class Acquisition = PolledImu,
+          class Spectrum = NoSpectrum, class Calibration = LinearCalibration, class Profiler = NoStageProfiler>
+using BasicRoadQualifier =
+  PolicyRoadQualifier<RoadQualifierPolicies<ImuDevice, Gnss, Metric, Log, Acquisition, Spectrum, Calibration, Profiler>>;
+
+// The GPS protocol selected with GPS_UBX
+#ifdef GPS_UBX
+using RoadQualifierGpsParser = UbxParser;
+#else
+using RoadQualifierGpsParser = NmeaParser;
+#endif
+
+// The acquisition selected with IMU_FIFO and IMU_SAMPLER
+#if defined(IMU_FIFO) && defined(IMU_SAMPLER)
+using RoadQualifierAcquisition = SampledImu<FifoImu>;
+#elif defined(IMU_FIFO)
+using RoadQualifierAcquisition = FifoImu;
+#elif defined(IMU_SAMPLER)
+using RoadQualifierAcquisition = SampledImu<PolledImu>;
+#else
+using RoadQualifierAcquisition = PolledImu;
+#endif
+
+// The configuration selected with the switches at the top of this file
+using RoadQualifier = BasicRoadQualifier<
+#ifdef DUMMY_MPU
+  DUMMY_MPU6050,
+#else
+  MPU6050,
+#endif
+#if defined(DUMMY_GPS)
+  DummyGnss,
+#elif defined(GPS_THREAD)
+  ThreadedGnss<RoadQualifierGpsParser>,
+#else
+  SerialGnss<RoadQualifierGpsParser>,
+#endif
+#ifdef IMU_FILTER
+  FilteredMetric<RoadQualifierAcquisition>,
+#else
+  DifferenceMetric,
+#endif
+#ifdef DEBUG
+  DebugLog,
+#else
+  QuietLog,
+#endif
+  RoadQualifierAcquisition,
+#ifdef ROUGHNESS_SPECTRUM
+  RoughnessSpectrum,
+#else
+  NoSpectrum,
+#endif
+#if defined(SPEED_COMPENSATION)
+  SpeedCalibration,
+#elif defined(EQUALIZED_QUANTIZER)
+  EqualizedCalibration,
+#elif defined(ONLINE_CALIBRATION)
+  OnlineCalibration,
+#else
+  LinearCalibration,
+#endif
+#ifdef PROFILE_STAGES
+  StageProfiler
+#else
+  NoStageProfiler
+#endif
+>;
+
 // ============================================================ //
-// ============== Constructor and begin function ============== //
+// ===================== begin function ======================= //
 // ============================================================ //
 
-RoadQualifier::RoadQualifier() : 
-  antennaStatus(gps, "GPTXT", 4),
-  speedKmph(gps, "GNVTG", 6)
-{}
-
-bool RoadQualifier::begin() {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::begin() {
   Serial.println("Initializing RoadQualifier...");
 
+  profiler.begin();
+
   if (!initializeMPU6050()) {
     Serial.println("Failed to initialize MPU6050.");
     return false;
   }
 
+  if constexpr (Acquisition::sampled) {
+    if (!sampler.start()) {
+      Serial.println("Failed to start IMU sampler.");
+      return false;
+    }
+  }
+
   if (!initFlashMemory()) {
     Serial.println("Failed to initialize flash memory for calibration data.");
     return false;
   }
 
-  #ifdef DELETE_CALIBRATION
-  if (!deleteCalibrationFromFlash()) {
-    Serial.println("Failed to delete calibration data from flash.");
-    return false;
+  if constexpr (Calibration::needsSpeed) {
+    // Calibration files its measurements under the current speed
+    if (!startGPS()) {
+      return false;
+    }
   }
-  delay(60000); // Wait for 1 minute to allow user to see the message
-  #endif
 
   if (!loadCalibrationFromFlash()) {
-    Serial.println("No valid calibration found. Starting calibration...");
-    if (!calibrate(CALIBRATION_TIME)) { // calibrate for CALIBRATION_TIME ms
-      Serial.println("Calibration failed.");
-      return false;
-    }
-    if (!saveCalibrationToFlash()) {
-      Serial.println("Failed to save calibration to flash.");
-      return false;
+    if constexpr (Calibration::online) {
+      // Qualify right away, the range comes from the first segments
+      Serial.println("No valid calibration found. Calibrating while qualifying.");
+      calibration.reset();
+    } else {
+      Serial.println("No valid calibration found. Starting calibration...");
+      if (!calibrate(CALIBRATION_TIME)) { // calibrate for CALIBRATION_TIME ms
+        Serial.println("Calibration failed.");
+        return false;
+      }
+      if (!saveCalibrationToFlash()) {
+        Serial.println("Failed to save calibration to flash.");
+        return false;
+      }
     }
   } else {
     Serial.println("Calibration loaded from flash.");
   }
 
-  if (!initializeGPS()) {
-    Serial.println("Failed to initialize GPS module.");
-    return false;
-  }
-
-  // get initial valid information from th gps
-  if (!waitForValidLocation()) {
-    Serial.println("Failed to acquire valid GPS location.");
-    return false;
-  }
-
-  if(!waitForValidSpeed()) {
-    Serial.println("Failed to acquire valid speed data.");
-    return false;
+  if constexpr (!Calibration::needsSpeed) {
+    if (!startGPS()) {
+      return false;
+    }
   }
 
+  calibration.start();
 
   sensorsInitialized = true;
   Serial.println("RoadQualifier initialized successfully.");
@@ -364,7 +1232,8 @@ bool RoadQualifier::begin() {
 // ================= isReady function ================== //
 // ===================================================== //
 
-bool RoadQualifier::isReady() {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::isReady() {
   return sensorsInitialized;
 }
 
@@ -372,129 +1241,253 @@ bool RoadQualifier::isReady() {
 // ============== Qualify Segment function ============== //
 // ====================================================== //
 
-bool RoadQualifier::qualifySegment() {
-#ifdef DEBUG
-  if (!sensorsInitialized) {
-    Serial.println("Sensors not initialized. Call begin() first.");
-    return false;
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::qualifySegment() {
+  if constexpr (Log::debug) {
+    if (!sensorsInitialized) {
+      Serial.println("Sensors not initialized. Call begin() first.");
+      return false;
+    }
   }
-#endif
 
   const float segmentTotalDistance = (float)SEGMENT_LENGTH;  
   const float first10PercentDistance = segmentTotalDistance * 0.1f; // 0.05 m
 
-  segmentDistance = 0.0;
+  // Road driven past the end of the previous segment belongs to this one,
+  // so consecutive segments cover the road without gaps
+  double carriedDistance = segmenterRunning ? fmod(segmentDistance, (double)segmentTotalDistance) : 0.0;
+  segmentOdometer += segmentDistance - carriedDistance;
+  segmentDistance = carriedDistance;
   peakSegmentZAccDifference = 0;
+  featureAccumulator.reset();
+  spectrum.reset();
+  segmentSamples = 0;
 
   bool segmentComplete = false;
-  bool haveInitialGPSForSegment = false;
-  bool haveInitialSpeedForSegment = false;
-  bool segmentValid = true;
-
-  // Use last known gps data at segment start
-
-  mpu.getAcceleration(&dummyAcc, &dummyAcc, &lastZAcceleration);
-  
-  //unsigned long segmentBeginTime = millis();  // For fallback because GPS speed is faulty
-  unsigned long iterationEnd = millis();
+  bool samplesLost = false; // The sampler dropped samples of this segment
+
+  // Start from the last known GPS data if it is recent enough, moved along
+  // the heading by the distance driven since the fix; a fix within the
+  // first 10% of the segment replaces it
+  unsigned long segmentStart = millis();
+  bool haveInitialGPSForSegment = segmentStart - lastLocationTime <= GPS_MAX_FIX_AGE;
+  bool haveInitialSpeedForSegment = segmentStart - lastSpeedTime <= GPS_MAX_FIX_AGE;
+  deadReckoning.position(segmentOdometer + segmentDistance, segmentLatitude, segmentLongitude);
+
+  ImuSample sample;
+  if (!segmenterRunning) {
+    if constexpr (!Acquisition::sampled) {
+      metric.start(imu.start());
+      lastIterationEnd = millis();
+    } else {
+      // Samples queued since the sampler started (calibration, GPS start)
+      // are stale: the first fresh one is the reference
+      sampler.discard();
+      seenDroppedSamples = sampler.getDroppedCount();
+      while (!sampler.pop(sample)) sampler.waitForSamples();
+      metric.start(sample.z);
+      lastSampleTime = sample.time;
+    }
+  }
+  // Time spent between calls counts towards this segment (loop reads)
+  unsigned long iterationEnd = lastIterationEnd;
+  segmenterRunning = true;
   unsigned long iter = 0;
 
   while (!segmentComplete) {
-    unsigned long iterationStart = iterationEnd; // Start time of iteration
+    unsigned long iterationStart = iterationEnd; // Start time of iteration (loop reads)
+    profiler.start();
 
     // Try reading GPS data
     readGPSData();
+    profiler.lapTo(STAGE_GPS_READ);
     // Update GPS data
-    if(updateLocation() && (segmentDistance <= first10PercentDistance) && !haveInitialGPSForSegment) {
+    if(updateLocation() && (segmentDistance <= first10PercentDistance)) {
       // Lock onto this GPS reading for the segment start
       haveInitialGPSForSegment = true;
       segmentLatitude = currentLatitude;
       segmentLongitude = currentLongitude;
-    }else if(!haveInitialGPSForSegment && segmentDistance > first10PercentDistance){
-      segmentValid = false;
-      break;
     }
 
     // Update speed data
-    if(updateSpeed() && (segmentDistance <= first10PercentDistance) && !haveInitialSpeedForSegment) {
+    if(updateSpeed() && (segmentDistance <= first10PercentDistance)) {
       haveInitialSpeedForSegment = true;
-    }else if(!haveInitialSpeedForSegment && segmentDistance > first10PercentDistance){
-      segmentValid = false;
-      break;
-    }
-    // Update acceleration difference
-    mpu.getAcceleration(&dummyAcc, &dummyAcc, &currentZAcceleration);
-    int32_t diff = abs((int32_t)currentZAcceleration - (int32_t)lastZAcceleration);
-    if (diff > peakSegmentZAccDifference) {
-      peakSegmentZAccDifference = diff;
     }
-    lastZAcceleration = currentZAcceleration;
-
-    // Compute distance traveled
-    iterationEnd = millis();
-    segmentDistance += currentSpeedKmph * (iterationEnd - iterationStart) / 3600.0f; // [km/h] * [ms] / [3600 s/h] = [m]
+    profiler.lapTo(STAGE_GPS_UPDATE);
+
+    if constexpr (!Acquisition::sampled) {
+      // Update acceleration difference (one sample when polling, every sample since the last iteration from the FIFO)
+      size_t samples = imu.read(zSamples, IMU_MAX_SAMPLES_PER_READ);
+      profiler.lapTo(STAGE_IMU_READ);
+      processSamples(zSamples, samples);
+
+      // Compute distance traveled
+      iterationEnd = millis();
+      segmentDistance += currentSpeedKmph * (iterationEnd - iterationStart) / 3600.0f; // [km/h] * [ms] / [3600 s/h] = [m]
+
+      //Actual model:
+      if (segmentDistance >= segmentTotalDistance) {
+      // Fallback because of faulty gps speed 
+      //if (millis() - segmentBeginTime > 1000) {
+        segmentComplete = true;
+      }
+      profiler.lapTo(STAGE_DISTANCE);
+
+      iter++;
+      delay(DELAY_AFTER_ITERATION); // Delay to ensure the iteration time is consistent
+      profiler.lapTo(STAGE_DELAY);
+      lastIterationEnd = iterationEnd;
+    } else {
+      // Update distance for every queued sample, up to the one that completes
+      // the segment (the rest start the next one), and acceleration difference
+      // per frame of up to DSP_FRAME_SIZE samples
+      size_t frameLength;
+      do {
+        frameLength = 0;
+        while (!segmentComplete && frameLength < DSP_FRAME_SIZE && sampler.pop(sample)) {
+          zSamples[frameLength++] = sample.z;
+
+          segmentDistance += currentSpeedKmph * (uint32_t)(sample.time - lastSampleTime) / 3600000.0; // [km/h] * [us] / [3600000 us*km/(h*m)] = [m]
+          lastSampleTime = sample.time;
+
+          if (segmentDistance >= segmentTotalDistance) {
+            segmentComplete = true;
+          }
+        }
+        processSamples(zSamples, frameLength);
+      } while (frameLength == DSP_FRAME_SIZE && !segmentComplete);
+      // Samples dropped while the loop fell behind leave a gap: its distance
+      // was driven, but not measured
+      if (sampler.getDroppedCount() != seenDroppedSamples) {
+        seenDroppedSamples = sampler.getDroppedCount();
+        samplesLost = true;
+      }
+      profiler.lapTo(STAGE_IMU_READ);
 
-    //Actual model:
-    if (segmentDistance >= segmentTotalDistance) {
-    // Fallback because of faulty gps speed 
-    //if (millis() - segmentBeginTime > 1000) {
-      segmentComplete = true;
+      iter++;
+      if (!segmentComplete) {
+        sampler.waitForSamples(); // Sleep until the sampler has queued new samples
+      }
+      profiler.lapTo(STAGE_DELAY);
     }
+  }
 
-    iter++;
-    delay(DELAY_AFTER_ITERATION); // Delay to ensure the iteration time is consistent
+  if (!haveInitialGPSForSegment || !haveInitialSpeedForSegment) {
+    if constexpr (Log::debug) {
+      Serial.println("Segment invalid: No recent GPS location or speed at the segment start.");
+    }
+    return false;
   }
 
-  if (!segmentValid) {
-    #ifdef DEBUG
-      Serial.println("Segment invalid: Unable to get initial GPS data within the first 10% or conditions not met.");
-    #endif
+  if (samplesLost) {
+    if constexpr (Log::debug) {
+      Serial.println("Segment invalid: The IMU sampler dropped samples.");
+    }
     return false;
   }
 
   // Segment complete and valid
-  currentSegmentQuality = quantifyToByte(peakSegmentZAccDifference, minZAccDifference, maxZAccDifference);
-
-#ifdef DUMMY_GPS
-  gps.nextLoc();
-#endif
-
-#ifdef DEBUG
-  Serial.println("Segment completed:");
-  Serial.print("Initial Segment Position: Lat=");
-  Serial.print(segmentLatitude, 6);
-  Serial.print(", Lon=");
-  Serial.println(segmentLongitude, 6);
-  Serial.print("Segment Length: ");
-  Serial.print(segmentDistance);
-  Serial.println(" m");
-  Serial.print("Current Speed: ");
-  Serial.print(currentSpeedKmph);
-  Serial.println(" km/h");
-  Serial.print("Number of iterations: ");
-  Serial.println(iter);
-  Serial.print("Peak Z-Acceleration Difference: ");
-  Serial.println(peakSegmentZAccDifference);
-  Serial.print("Quality Measure: ");
-  Serial.println(currentSegmentQuality);
-  Serial.println("--------------------------------------");
-#endif
+  if constexpr (Calibration::online) {
+    updateOnlineCalibration();
+  }
+  currentSegmentQuality = calibration.quantize(peakSegmentZAccDifference, currentSpeedKmph, minZAccDifference, maxZAccDifference);
+  currentSegmentFeatures = featureAccumulator.finish();
+  currentSegmentSpectrum = spectrum.finish(currentSpeedKmph);
+
+  gnss.nextSegment();
+
+  if constexpr (Log::debug) {
+    Serial.println("Segment completed:");
+    Serial.print("Initial Segment Position: Lat=");
+    Serial.print(segmentLatitude, 6);
+    Serial.print(", Lon=");
+    Serial.println(segmentLongitude, 6);
+    Serial.print("Segment Length: ");
+    Serial.print(segmentDistance);
+    Serial.println(" m");
+    Serial.print("Current Speed: ");
+    Serial.print(currentSpeedKmph);
+    Serial.println(" km/h");
+    Serial.print("Number of iterations: ");
+    Serial.println(iter);
+    Serial.print("Number of samples: ");
+    Serial.println(segmentSamples);
+    if constexpr (Acquisition::sampled) {
+      Serial.print("Dropped samples (total): ");
+      Serial.println(sampler.getDroppedCount());
+    }
+    Serial.print("Peak Z-Acceleration Difference: ");
+    Serial.println(peakSegmentZAccDifference);
+    Serial.print("Quality Measure: ");
+    Serial.println(currentSegmentQuality);
+    Serial.print("RMS / Peak-to-Peak: ");
+    Serial.print(currentSegmentFeatures.rms);
+    Serial.print(" / ");
+    Serial.println(currentSegmentFeatures.peakToPeak);
+    Serial.print("Crest Factor / Kurtosis: ");
+    Serial.print(currentSegmentFeatures.crestFactor / 256.0f);
+    Serial.print(" / ");
+    Serial.println(currentSegmentFeatures.kurtosis / 256.0f);
+    Serial.print("Exceedances (0.1 g / 0.25 g / 0.5 g): ");
+    Serial.print(currentSegmentFeatures.exceedances[0]);
+    Serial.print(" / ");
+    Serial.print(currentSegmentFeatures.exceedances[1]);
+    Serial.print(" / ");
+    Serial.println(currentSegmentFeatures.exceedances[2]);
+    if constexpr (Spectrum::enabled) {
+      Serial.print("Band RMS (1-2 / 2-4 / 4-8 / 8-16 cycles/m): ");
+      for (uint8_t b = 0; b < SPECTRUM_BANDS; b++) {
+        if (b > 0) Serial.print(" / ");
+        Serial.print(currentSegmentSpectrum.bands[b]);
+      }
+      Serial.println();
+    }
+    Serial.println("--------------------------------------");
+  }
 
   return true;
 }
 
 // returns the quality of the last validly qualified segment
 // only call this function after qualifySegment() returns true
-SegmentQuality RoadQualifier::getSegmentQuality() {
+template <class Policies>
+SegmentQuality PolicyRoadQualifier<Policies>::getSegmentQuality() {
   return {segmentLatitude, segmentLongitude, currentSegmentQuality};
 }
 
+// returns the quality of the last validly qualified segment with its vibration features
+// only call this function after qualifySegment() returns true
+template <class Policies>
+DetailedSegmentQuality PolicyRoadQualifier<Policies>::getDetailedSegmentQuality() {
+  return {{segmentLatitude, segmentLongitude, currentSegmentQuality}, currentSegmentFeatures, currentSegmentSpectrum};
+}
+
+// ===================================================== //
+// ================ Stage profiling API ================ //
+// ===================================================== //
+
+template <class Policies>
+const StageProfile& PolicyRoadQualifier<Policies>::getStageProfile() const {
+  return profiler.profile;
+}
+
+template <class Policies>
+void PolicyRoadQualifier<Policies>::printStageProfile(Print& out) const {
+  profiler.profile.print(out);
+}
+
+template <class Policies>
+void PolicyRoadQualifier<Policies>::resetStageProfile() {
+  profiler.profile.reset();
+}
+
 // ===================================================== //
 // ================== Helper functions ================= //
 // ===================================================== //
 
 // Initializes MPU6050 (returns false if not connected)
-bool RoadQualifier::initializeMPU6050() {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::initializeMPU6050() {
   Serial.println("Initializing MPU6050...");
   Wire.begin();
   mpu.initialize();
@@ -514,26 +1507,52 @@ bool RoadQualifier::initializeMPU6050() {
   mpu.setYGyroOffset(-55);
   mpu.setZGyroOffset(7);
 
-  #ifdef DEBUG
-  mpu.CalibrateAccel(6);
-  mpu.CalibrateGyro(6);
-  Serial.println("These are the Active offsets: ");
-  mpu.PrintActiveOffsets();
-  #endif
+  if constexpr (Log::debug) {
+    mpu.CalibrateAccel(6);
+    mpu.CalibrateGyro(6);
+    Serial.println("These are the Active offsets: ");
+    mpu.PrintActiveOffsets();
+  }
 
   Serial.println("MPU6050 calibrated");
+
+  if (!imu.begin()) {
+    Serial.println("MPU6050 acquisition setup failed");
+    return false;
+  }
   return true;
 }
 
+// Adds a frame of Z acceleration samples to the current segment: the
+// segment metric, the vibration features as block kernels, and the
+// roughness spectrum
+template <class Policies>
+void PolicyRoadQualifier<Policies>::processSamples(int16_t* z, size_t n) {
+  if (n == 0) return;
+  int32_t peak = metric.peak(z, n);
+  if (peak > peakSegmentZAccDifference) {
+    peakSegmentZAccDifference = peak;
+  }
+  featureAccumulator.addBlock(z, n);
+  spectrum.addBlock(z, n);
+  segmentSamples += n;
+}
+
 // Initializes GPS module (returns false if not connected)
-bool RoadQualifier::initializeGPS() {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::initializeGPS() {
   Serial.println("Initializing GPS module...");
-  Serial1.begin(GPS_BAUD);
+  if (!gnss.begin(GPS_BAUD)) {
+    return false;
+  }
 
   unsigned long start = millis();
   while (millis() - start < 5000) {
     readGPSData();
-    if (antennaStatus.isUpdated()) {
+    if (Gnss::readPeriodMs > 0) {
+      delay(Gnss::readPeriodMs);
+    }
+    if (gnss.antennaStatusKnown()) {
       if (isGPSAntennaConnected()) {
         Serial.println("GPS antenna connected.");
         return true;
@@ -548,16 +1567,35 @@ bool RoadQualifier::initializeGPS() {
   return false;
 }
 
+// Initializes GPS module and gets initial valid information from it (returns false if failed)
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::startGPS() {
+  if (!initializeGPS()) {
+    Serial.println("Failed to initialize GPS module.");
+    return false;
+  }
+
+  if (!waitForValidLocation()) {
+    Serial.println("Failed to acquire valid GPS location.");
+    return false;
+  }
+
+  if(!waitForValidSpeed()) {
+    Serial.println("Failed to acquire valid speed data.");
+    return false;
+  }
+  return true;
+}
+
 // Waits for valid GPS location (returns false if not found within 20 seconds)
-bool RoadQualifier::waitForValidLocation() {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::waitForValidLocation() {
   Serial.println("Waiting for valid GPS location...");
   unsigned long end = millis() + MAX_GPS_WAIT;
   while (millis() < end) {
     readGPSData();
-    if (gps.location.isValid() && gps.location.age() < 2000) {
-      currentLatitude = gps.location.lat();
-      currentLongitude = gps.location.lng();
-      return true;
+    if (gnss.hasRecentLocation(2000)) {
+      return updateLocation();
     }
     delay(500);
   }
@@ -565,17 +1603,14 @@ bool RoadQualifier::waitForValidLocation() {
 }
 
 // Waits for valid speed data (returns false if not found within 20 seconds)
-bool RoadQualifier::waitForValidSpeed() {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::waitForValidSpeed() {
   Serial.println("Waiting for valid speed data...");
   unsigned long end = millis() + MAX_GPS_WAIT;
   while (millis() < end) {
     readGPSData();
-    if (speedKmph.isUpdated()) {
-      const char* speedStr = speedKmph.value();
-      if (speedStr && speedStr[0] != '\0') {
-        currentSpeedKmph = atof(speedStr); 
-        return true;
-      }
+    if (updateSpeed()) {
+      return true;
     }
     delay(500);
   }
@@ -583,82 +1618,66 @@ bool RoadQualifier::waitForValidSpeed() {
 }
 
 // Checks if GPS antenna is connected
-bool RoadQualifier::isGPSAntennaConnected() {
-#ifndef DUMMY_GPS
-  const char* status = antennaStatus.value();
-  return (strcmp(status, "ANTENNA OK") == 0);
-#else
-  return true;
-#endif
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::isGPSAntennaConnected() {
+  return gnss.antennaConnected();
 }
 
 // Reads GPS data from serial port
-void RoadQualifier::readGPSData() {
-#ifndef DUMMY_GPS
-  while (Serial1.available() > 0) {
-    char c = Serial1.read();
-    gps.encode(c);
-  }
-#endif
+template <class Policies>
+void PolicyRoadQualifier<Policies>::readGPSData() {
+  gnss.read();
 }
 
 // Updates current location after previous call to readGPSData()
 // (returns false if not updated or invalid)
-bool RoadQualifier::updateLocation(){
-  if (!gps.location.isUpdated() || !gps.location.isValid())
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::updateLocation(){
+  if (!gnss.updateLocation(currentLatitude, currentLongitude, lastLocationTime))
     return false;
-  
-  currentLatitude = gps.location.lat();
-  currentLongitude = gps.location.lng();
 
+  deadReckoning.fix(currentLatitude, currentLongitude, segmentOdometer + segmentDistance);
   return true;
 }
 
 // Updates current speed after previous call to readGPSData()
 // (returns false if not updated or invalid)
-bool RoadQualifier::updateSpeed(){
-  if (!speedKmph.isUpdated() || speedKmph.value()[0] == '\0')
-    return false;
-  
-  currentSpeedKmph = atof(speedKmph.value());
-  return true;
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::updateSpeed(){
+  return gnss.updateSpeed(currentSpeedKmph, lastSpeedTime);
 }
 
-uint8_t RoadQualifier::quantifyToByte(int32_t value, int32_t minValue, int32_t maxValue) {
-  #ifdef DEBUG
-  if (minValue >= maxValue) {
-    // Handle error: minValue must be less than maxValue
-    return 0;
-  }
-  #endif
-
-  // Clamp the value
-  if (value <= minValue) {
-    return 0;
-  } else if (value >= maxValue) {
-    return 255;
+template <class Policies>
+uint8_t PolicyRoadQualifier<Policies>::quantifyToByte(int32_t value, int32_t minValue, int32_t maxValue) {
+  if constexpr (Log::debug) {
+    if (minValue >= maxValue) {
+      // Handle error: minValue must be less than maxValue
+      return 0;
+    }
   }
 
-  uint32_t range = (uint32_t)(maxValue - minValue);
-  
-  // Use 64-bit arithmetic to avoid overflow
-  // (value - minValue) * 255 might overflow 32-bit if the range is large
-  uint64_t numerator = (uint64_t)(value - minValue) * 255ULL + (range / 2ULL);
-  uint64_t result = numerator / range;
-
-  // result should always be <= 255, but clamp just in case
-  if (result > 255ULL) {
-    result = 255ULL;
-  }
+  return quantizeLinear(value, minValue, maxValue);
+}
 
-  return (uint8_t)result;
+// Calibration data with the range minValue..maxValue, completed by the
+// calibration policy
+template <class Policies>
+auto PolicyRoadQualifier<Policies>::calibrationRecord(int32_t minValue, int32_t maxValue) -> CalibrationRecord {
+  CalibrationRecord calData;
+  memset(&calData, 0, sizeof(CalibrationRecord)); // Padding is part of the checksum (OnlineCalibration)
+  calData.signature = Calibration::signature;
+  calData.minZAccDifference = minValue;
+  calData.maxZAccDifference = maxValue;
+  Calibration::fromRange(calData);
+  return calData;
 }
 
 // ======================================================= //
 // ================= Calibration Function ================ //
 // ======================================================= //
 
-bool RoadQualifier::calibrate(unsigned long calibrationTime) {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::calibrate(unsigned long calibrationTime) {
   Serial.println("Calibrating accelerations...");
   delay(CALIBRATION_TIME_INITIAL_WAIT);
 
@@ -667,36 +1686,91 @@ bool RoadQualifier::calibrate(unsigned long calibrationTime) {
   minZAccDifference = MAX_INT16_VALUE;
   maxZAccDifference = 0;
 
-  mpu.getAcceleration(&dummyAcc, &dummyAcc, &currentZAcceleration);
+  ImuSample sample;
+  if constexpr (!Acquisition::sampled) {
+    metric.start(imu.start());
+  } else {
+    sampler.discard(); // Samples queued during the initial wait
+    while (!sampler.pop(sample)) sampler.waitForSamples();
+    metric.start(sample.z);
+  }
+  typename Calibration::Calibrator calibrator(Metric::windowed);
 
-  while(millis() < endTime) {
+  // The range spans the measurements of the metric
+  auto measurement = [&](int32_t value) {
+    if (value > maxZAccDifference)
+      maxZAccDifference = value;
+    bool aboveFloor = value > Metric::calibrationFloor;
+    calibrator.add(value, currentSpeedKmph, aboveFloor);
+    if (!aboveFloor)
+      return;
 
-    lastZAcceleration = currentZAcceleration;
-    mpu.getAcceleration(&dummyAcc, &dummyAcc, &currentZAcceleration);
-    accelerationDifference = abs((int32_t)currentZAcceleration - (int32_t)lastZAcceleration);
+    if (value < minZAccDifference)
+      minZAccDifference = value;
+  };
 
-    if (accelerationDifference > maxZAccDifference)
-      maxZAccDifference = accelerationDifference;
+  while(millis() < endTime) {
+    if constexpr (Calibration::needsSpeed) {
+      readGPSData();
+      updateSpeed();
+    }
 
-    if ((accelerationDifference < minZAccDifference) && (accelerationDifference > MIN_CALIBRATION_VALUE))
-      minZAccDifference = accelerationDifference;
+    if constexpr (!Acquisition::sampled) {
+      size_t samples = imu.read(zSamples, IMU_MAX_SAMPLES_PER_READ);
+      for (size_t i = 0; i < samples; i++) {
+        metric.calibrate(zSamples[i], measurement);
+      }
+    } else {
+      while (sampler.pop(sample)) {
+        metric.calibrate(sample.z, measurement);
+      }
+    }
+    calibrator.tick();
     
-    delay(5);
+    if constexpr (!Acquisition::sampled) {
+      delay(5);
+    } else {
+      sampler.waitForSamples();
+    }
+  }
+
+  if (!calibrator.finish(calibration, minZAccDifference, maxZAccDifference)) {
+    return false;
   }
 
   Serial.println("Calibration complete.");
   Serial.print("Calibrated minZAccDifference: "); Serial.println(minZAccDifference);
   Serial.print("Calibrated maxZAccDifference: "); Serial.println(maxZAccDifference);
+  calibration.print();
 
   return true;
 }
 
+template <class Policies>
+void PolicyRoadQualifier<Policies>::updateOnlineCalibration() {
+  calibration.addSegment(peakSegmentZAccDifference, minZAccDifference, maxZAccDifference);
+
+  if (calibration.checkpointDue()) {
+    saveCalibrationToFlash();
+    calibration.checkpointed();
+    if constexpr (Log::debug) {
+      Serial.print("Calibration checkpoint after ");
+      Serial.print(calibration.segments());
+      Serial.print(" segments: ");
+      Serial.print(minZAccDifference);
+      Serial.print("..");
+      Serial.println(maxZAccDifference);
+    }
+  }
+}
+
 // ======================================================= //
 // ============== Flash Memory Handling ================== //
 // ======================================================= //
 
 // Initializes flash memory for calibration data (returns false if failed)
-bool RoadQualifier::initFlashMemory() {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::initFlashMemory() {
   if (flashInitialized) return true;
 
   auto [flashSize, startAddress, iapSize] = getFlashIAPLimits();
@@ -716,26 +1790,71 @@ bool RoadQualifier::initFlashMemory() {
   programBlockSize = flashBD->get_program_size();
   eraseBlockSize = flashBD->get_erase_size();
 
+  // OnlineCalibration logs its records in one erase block, which must hold at least one
+  if (calibrationRecordSize() > calibrationAreaSize() || calibrationAreaSize() >= flashBD->size()) {
+    Serial.println("Calibration record does not fit the flash.");
+    return false;
+  }
+
   flashInitialized = true;
   Serial.println("Flash memory initialized successfully.");
   return true;
 }
 
+// The initialized block device of the calibration; others may use it after
+// calibrationAreaSize() (returns nullptr if failed)
+template <class Policies>
+FlashIAPBlockDevice* PolicyRoadQualifier<Policies>::getFlashDevice() {
+  return initFlashMemory() ? flashBD : nullptr;
+}
+
+// The erase blocks of one calibration record, or of the record log of
+// OnlineCalibration (valid once the flash is initialized)
+template <class Policies>
+bd_size_t PolicyRoadQualifier<Policies>::calibrationAreaSize() const {
+  if constexpr (Calibration::online) return eraseBlockSize;
+  return (sizeof(CalibrationRecord) + eraseBlockSize - 1) / eraseBlockSize * eraseBlockSize;
+}
+
+// Bytes one calibration record is programmed as
+template <class Policies>
+size_t PolicyRoadQualifier<Policies>::calibrationRecordSize() const {
+  return (sizeof(CalibrationRecord) + programBlockSize - 1) / programBlockSize * programBlockSize;
+}
+
 // Loads calibration data from flash memory (returns false if failed)
-bool RoadQualifier::loadCalibrationFromFlash() {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::loadCalibrationFromFlash() {
   if (!flashInitialized || !flashBD) return false;
 
-  CalibrationData calData;
-  memset(&calData, 0, sizeof(CalibrationData));
-
-  flashBD->read(&calData, 0, sizeof(CalibrationData));
+  CalibrationRecord calData;
+  memset(&calData, 0, sizeof(CalibrationRecord));
+
+  if constexpr (Calibration::online) {
+    // Scan the log up to the first record that was never written
+    size_t recordSize = calibrationRecordSize();
+    bool found = false;
+    for (calibrationSlot = 0; (calibrationSlot + 1) * recordSize <= calibrationAreaSize(); calibrationSlot++) {
+      CalibrationRecord record;
+      flashBD->read(&record, calibrationSlot * recordSize, sizeof(CalibrationRecord));
+      if (record.signature != Calibration::signature) break;
+      if (record.stored.checksum == Calibration::checksum(record)) {
+        calData = record;
+        found = true;
+      }
+    }
+    if (!found) calData.signature = 0;
+  } else {
+    flashBD->read(&calData, 0, sizeof(CalibrationRecord));
+  }
 
-  if (calData.signature == CALIBRATION_SIGNATURE) {
+  if (calData.signature == Calibration::signature) {
     minZAccDifference = calData.minZAccDifference;
     maxZAccDifference = calData.maxZAccDifference;
     Serial.println("Previously stored calibration data:");
     Serial.print("MinZAcceleration: "); Serial.println(minZAccDifference);
     Serial.print("MaxZAcceleration: "); Serial.println(maxZAccDifference);
+    calibration.load(calData);
     return true;
   }
 
@@ -743,36 +1862,54 @@ bool RoadQualifier::loadCalibrationFromFlash() {
 }
 
 // Saves calibration data to flash memory (returns false if failed)
-bool RoadQualifier::saveCalibrationToFlash() {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::saveCalibrationToFlash() {
   if (!flashInitialized || !flashBD) return false;
 
-  CalibrationData calData;
-  calData.signature = CALIBRATION_SIGNATURE;
+  CalibrationRecord calData;
+  memset(&calData, 0, sizeof(CalibrationRecord)); // Padding is part of the checksum (OnlineCalibration)
+  calData.signature = Calibration::signature;
   calData.minZAccDifference = minZAccDifference;
   calData.maxZAccDifference = maxZAccDifference;
+  calibration.save(calData);
+
+  size_t dataSize = sizeof(CalibrationRecord);
+  size_t programSize = calibrationRecordSize();
+  size_t offset = 0;
+  if constexpr (Calibration::online) {
+    // Append to the log, erasing only when the erase block is full
+    if ((calibrationSlot + 1) * programSize > calibrationAreaSize()) {
+      calibrationSlot = 0;
+    }
+    if (calibrationSlot == 0) {
+      flashBD->erase(0, calibrationAreaSize());
+    }
+    offset = calibrationSlot * programSize;
+  } else {
+    flashBD->erase(0, calibrationAreaSize());
+  }
 
-  size_t dataSize = sizeof(CalibrationData);
-  size_t eraseBlocks = (dataSize + eraseBlockSize - 1) / eraseBlockSize;
-  flashBD->erase(0, eraseBlocks * eraseBlockSize);
-
-  size_t programSize = ((dataSize + programBlockSize - 1) / programBlockSize) * programBlockSize;
   uint8_t *buffer = (uint8_t*)malloc(programSize);
   memset(buffer, 0xFF, programSize);
   memcpy(buffer, &calData, dataSize);
 
-  int err = flashBD->program(buffer, 0, programSize);
+  int err = flashBD->program(buffer, offset, programSize);
   free(buffer);
 
   if (err != 0) {
     Serial.println("Failed to program flash.");
     return false;
   }
+  if constexpr (Calibration::online) {
+    calibrationSlot++;
+  }
 
   Serial.println("Calibration saved to flash.");
   return true;
 }
 
-bool RoadQualifier::deleteCalibrationFromFlash() {
+template <class Policies>
+bool PolicyRoadQualifier<Policies>::deleteCalibrationFromFlash() {
   initFlashMemory();
   
   if (!flashInitialized || !flashBD) {
@@ -782,23 +1919,20 @@ bool RoadQualifier::deleteCalibrationFromFlash() {
 
   Serial.println("Erasing calibration data from flash...");
 
-  size_t dataSize = sizeof(CalibrationData);
-  size_t eraseBlocks = (dataSize + eraseBlockSize - 1) / eraseBlockSize;
-
   // Erase the flash region where calibration data is stored
-  int err = flashBD->erase(0, eraseBlocks * eraseBlockSize);
+  int err = flashBD->erase(0, calibrationAreaSize());
   if (err != 0) {
       Serial.println("Failed to erase calibration data from flash.");
       return false;
   }
 
   // Verify that the calibration data is actually erased
-  CalibrationData calData;
-  memset(&calData, 0, sizeof(CalibrationData));
-  flashBD->read(&calData, 0, sizeof(CalibrationData));
+  CalibrationRecord calData;
+  memset(&calData, 0, sizeof(CalibrationRecord));
+  flashBD->read(&calData, 0, sizeof(CalibrationRecord));
 
-  // After erase, flash is typically 0xFF, so signature should not match CALIBRATION_SIGNATURE
-  if (calData.signature == CALIBRATION_SIGNATURE) {
+  // After erase, flash is typically 0xFF, so signature should not match Calibration::signature
+  if (calData.signature == Calibration::signature) {
       Serial.println("Warning: Calibration signature still present after erase!");
       Serial.println("This may indicate hardware or flash configuration issues.");
       return false;
@@ -807,48 +1941,16 @@ bool RoadQualifier::deleteCalibrationFromFlash() {
   // Reset in-memory calibration values
   minZAccDifference = 0;
   maxZAccDifference = 0;
+  calibration.reset();
+  calibrationSlot = 0;
 
   Serial.println("Calibration data erased from flash successfully.");
 
   return true;
 }
 
-// ================ Unix Time Function =================== //
-
-// helper function to convert a given date/time to a Unix timestamp.
-// The algorithm is adapted from standard formulas for converting a date/time to Unix time.
-time_t dateTimeToUnix(int year, int month, int day, int hour, int minute, int second) {
-    // Unix time starts on Jan 1 1970 (UTC)
-    // Calculate days from 1970 until the given year
-    int a = (14 - month) / 12;
-    int y = year + 4800 - a;
-    int m = month + 12*a - 3;
-    
-    // Julian day number for this date
-    // Note: This formula is valid for year >= 1 (no leap second)
-    uint32_t julian_day = day + ((153*m + 2)/5) + 365*y + y/4 - y/100 + y/400 - 32045;
-    
-    // Julian day of Unix epoch (1970-01-01) is 2440588
-    uint32_t days_since_epoch = julian_day - 2440588;
-    
-    // Convert to seconds
-    time_t unix_time = (time_t)days_since_epoch*86400 + hour*3600 + minute*60 + second;
-    return unix_time;
-}
-
 // Checks if we have valid GPS date and time and returns Unix time
-time_t RoadQualifier::getUnixTime() {
-    if (!gps.date.isValid() || !gps.time.isValid()) {
-        // If GPS time/date is not valid, return 0 or some error code
-        return 0;
-    }
-
-    int year   = (int)gps.date.year();   // e.g., 2024
-    int month  = (int)gps.date.month();  // 1-12
-    int day    = (int)gps.date.day();    // 1-31
-    int hour   = (int)gps.time.hour();   // 0-23
-    int minute = (int)gps.time.minute(); // 0-59
-    int second = (int)gps.time.second(); // 0-59
-
-    return dateTimeToUnix(year, month, day, hour, minute, second);
-}
\ No newline at end of file
+template <class Policies>
+time_t PolicyRoadQualifier<Policies>::getUnixTime() {
+  return gnss.unixTime();
+}
@@ -3,6 +3,9 @@
 #include "./lib/SegmentQuality.h"
 #include "./lib/RabbitMQClient.h" // includes PubSubClient.h which uses Arduino::Stream
 #include "./lib/roadqualifier.h"  // roadqualifier code
+#include "./lib/SpscRingBuffer.h" // segment buffer shared by the tasks
+#include "./lib/PackedSegment.h"  // 11 byte segment records in the buffer
+#include "./lib/SegmentLog.h"     // flash log of the segments not yet published
 
 #include <mbed.h>
 #include <rtos.h>
@@ -13,79 +16,65 @@
 #undef Stream
 
 #define DEBUG // Enable debug output
+//#define BENCH_HOT_PATHS // Print cycle counts of the hot paths (lib/HotPathBench.h) instead of running the tasks
+//#define DELETE_CALIBRATION // Delete the calibration data from flash before begin(), which then calibrates again
+//#define PUBLISH_FEATURES // Also publish the vibration features of the segments on FEATURE_TOPIC while online (not logged to flash)
+
+#ifdef BENCH_HOT_PATHS
+#include "./lib/HotPathBench.h"
+#endif
 
 using namespace rtos;
 
 #define TIME_T2 1.0
-#define BUFFER_SIZE 1000
+#define SEGMENT_BUFFER_SIZE 2048 // Segments buffered while WiFi is down (power of two, 11 bytes each)
+#define FEATURE_BUFFER_SIZE 256  // Segments with features waiting for task2 (power of two, 37 bytes each)
 #define WATCHDOG_TIMEOUT 3.0  // Watchdog timeout in seconds
 #define SERIAL_BAUD 115200    // Serial baud rate
 
 
 rtos::Thread t1;
 rtos::Thread t2;
-rtos::Mutex buffer_mutex;
 
 RoadQualifier roadQualifier;
 RabbitMQClient rabbitMQClient;
 
-class MyCircularBuffer {
-public:
-    MyCircularBuffer() : head(0), tail(0), full(false) {}
-
-    bool put(const SegmentQuality& item) {
-        std::lock_guard<Mutex> lock(buffer_mutex); // mutex gets released automatically when lock goes out of scope
-        buffer[head] = item;
-        if (full) {
-            tail = (tail + 1) % BUFFER_SIZE;
-        }
-        head = (head + 1) % BUFFER_SIZE;
-        full = head == tail;
-        return true;
-    }
-
-    bool get(SegmentQuality& item) {
-        std::lock_guard<Mutex> lock(buffer_mutex);
-        if (isEmpty()) {
-            return false;
-        }
-        item = buffer[tail];
-        full = false;
-        tail = (tail + 1) % BUFFER_SIZE;
-        return true;
-    }
-
-    bool isEmpty() const {
-        return (!full && (head == tail));
-    }
-
-    bool isFull() const {
-        return full;
-    }
-
-private:
-    SegmentQuality buffer[BUFFER_SIZE];
-    size_t head;
-    size_t tail;
-    bool full;
-};
+// Lock-free hand-over from task1 (producer) to task2 (consumer)
+SpscRingBuffer<PackedSegment, SEGMENT_BUFFER_SIZE, RingOverflow::DropOldest> circular_buffer;
 
+#ifdef PUBLISH_FEATURES
+// The same segments with their features; best effort, the oldest are dropped while offline
+SpscRingBuffer<PackedDetailedSegment, FEATURE_BUFFER_SIZE, RingOverflow::DropOldest> feature_buffer;
+#endif
 
-MyCircularBuffer circular_buffer;
+// Segments waiting for the broker, in the flash after the calibration area
+SegmentLog segmentLog;
 
 Watchdog &watchdog = Watchdog::get_instance();
 
 // Task 1: run the road qualifier
 void task1_function() {
-    SegmentQuality segmentQuality;
+    #ifdef PUBLISH_FEATURES
+        DetailedSegmentQuality segmentQuality;
+    #else
+        SegmentQuality segmentQuality;
+    #endif
+    #ifdef PROFILE_STAGES
+        unsigned long profiledSegments = 0;
+    #endif
 
     while (true) {
         // Qualify a road segment
         if (roadQualifier.qualifySegment()) {
-            segmentQuality = roadQualifier.getSegmentQuality();
+            #ifdef PUBLISH_FEATURES
+                segmentQuality = roadQualifier.getDetailedSegmentQuality();
+                feature_buffer.push(packDetailedSegment(segmentQuality, millis()));
+            #else
+                segmentQuality = roadQualifier.getSegmentQuality();
+            #endif
 
             // Add data to the buffer (overwriting oldest data if full)
-            circular_buffer.put(segmentQuality);
+            circular_buffer.push(packSegment(segmentQuality, millis()));
 
             #ifdef DEBUG
                 Serial.print("Added to buffer segment quality: ");
@@ -101,42 +90,99 @@ void task1_function() {
             #endif
         }
 
-        ThisThread::sleep_for(100); // 100 ms
+        #ifdef PROFILE_STAGES
+            // Dump the per-stage latency histograms every 100 segments
+            if (++profiledSegments % 100 == 0) {
+                roadQualifier.printStageProfile(Serial);
+                roadQualifier.resetStageProfile();
+            }
+        #endif
+
+        // No sleep here: the next segment starts where this one ended
     }
 }
 
-// Task 2: send data over RabbitMQ
-void task2_function() {
-    SegmentQuality segmentQuality;
+// Publishes a batch of count segments (up to SEGMENT_BATCH_SIZE) in one message
+bool publishSegments(const PackedSegment* packedSegments, const time_t* timestamps, size_t count) {
+    SegmentQuality segments[SEGMENT_BATCH_SIZE];
+    for (size_t i = 0; i < count; i++) segments[i] = unpackSegment(packedSegments[i]);
+    bool sent = rabbitMQClient.sendBatchCallback(segments, timestamps, count);
+
+    #ifdef DEBUG
+        Serial.print(sent ? "Sent segment qualities: " : "Failed to send segment qualities: ");
+        Serial.print((unsigned long)count);
+        Serial.print(", last ");
+        Serial.print(segments[count - 1].latitude);
+        Serial.print(", ");
+        Serial.print(segments[count - 1].longitude);
+        Serial.print(", ");
+        Serial.print(segments[count - 1].quality);
+        Serial.print(", ");
+        Serial.println((unsigned long)timestamps[count - 1]);
+    #endif
+    return sent;
+}
+
+// When a buffered segment was qualified
+time_t segmentTime(const PackedSegment& packedSegment) {
+    return packedSegmentTime(packedSegment, millis(), roadQualifier.getUnixTime());
+}
 
+#ifdef PUBLISH_FEATURES
+// Publishes the buffered features in batches; a batch that fails is dropped
+void publishFeatures() {
+    PackedDetailedSegment packedSegments[SEGMENT_BATCH_SIZE];
+    DetailedSegmentQuality segments[SEGMENT_BATCH_SIZE];
+    time_t timestamps[SEGMENT_BATCH_SIZE];
+    while (size_t count = feature_buffer.popN(packedSegments, SEGMENT_BATCH_SIZE)) {
+        for (size_t i = 0; i < count; i++) {
+            segments[i] = unpackDetailedSegment(packedSegments[i]);
+            timestamps[i] = segmentTime(packedSegments[i].segment);
+        }
+        if (!rabbitMQClient.sendFeatureBatchCallback(segments, timestamps, count)) {
+            #ifdef DEBUG
+                Serial.print("Dropped feature batch: ");
+                Serial.println((unsigned long)count);
+            #endif
+            return;
+        }
+    }
+}
+#endif
+
+// Task 2: send data over RabbitMQ in batches, through the flash log while offline
+void task2_function() {
     while (true) {
-        // Connect to WiFi
-        rabbitMQClient.connectWiFi();
-
-        while (rabbitMQClient.isConnectedWiFi()) {
-            if (circular_buffer.get(segmentQuality)) {
-
-                rabbitMQClient.sendDataCallback(segmentQuality, roadQualifier.getUnixTime());
-                
-                #ifdef DEBUG
-                    Serial.print("Sent segment quality: ");
-                    Serial.print(segmentQuality.latitude);
-                    Serial.print(", ");
-                    Serial.print(segmentQuality.longitude);
-                    Serial.print(", ");
-                    Serial.print(segmentQuality.quality);
-                    Serial.print(", ");
-                    Serial.println(roadQualifier.getUnixTime());
-                #endif
-            } else {
-                #ifdef DEBUG
-                    Serial.println("Buffer is empty. Waiting for data.");
-                #endif
-            }
-            ThisThread::sleep_for(100); // 100 ms
-        } 
-        T
-    }ThisThread::sleep_for(1000); // 1 second
+        bool online = rabbitMQClient.isConnectedWiFi();
+        if (!online) {
+            // Move the buffered segments to flash before trying to connect
+            forwardSegments<SEGMENT_BATCH_SIZE>(segmentLog, circular_buffer, false, segmentTime, publishSegments);
+            rabbitMQClient.connectWiFi();
+            online = rabbitMQClient.isConnectedWiFi();
+        }
+
+        uint32_t published = forwardSegments<SEGMENT_BATCH_SIZE>(segmentLog, circular_buffer, online, segmentTime, publishSegments);
+        #ifdef PUBLISH_FEATURES
+            if (online) publishFeatures();
+        #endif
+        #ifdef DEBUG
+            if (online && published == 0) Serial.println("Buffer is empty. Waiting for data.");
+        #else
+            (void)published;
+        #endif
+
+        ThisThread::sleep_for(online ? 100 : 1000); // 100 ms, 1 second while offline
+    }
+}
+
+// Mounts the segment log on the flash after the calibration area, through
+// the block device of the road qualifier
+bool initSegmentLog() {
+    FlashIAPBlockDevice* flash = roadQualifier.getFlashDevice();
+    if (!flash) return false;
+
+    bd_size_t start = roadQualifier.calibrationAreaSize();
+    return segmentLog.begin(flash, start, flash->size() - start);
 }
 
 void setup() {
@@ -146,6 +192,22 @@ void setup() {
         while (!Serial);
     #endif
 
+    #ifdef BENCH_HOT_PATHS
+        PipelineCosts costs = runHotPathBenchmarks(Serial, rabbitMQClient);
+        Serial.println();
+        printCpuBudget(Serial, costs);
+        while (true) {
+            ThisThread::sleep_for(1000);
+        }
+    #endif
+
+    #ifdef DELETE_CALIBRATION
+        if (!roadQualifier.deleteCalibrationFromFlash()) {
+            Serial.println("Failed to delete calibration data from flash.");
+        }
+        delay(60000); // Wait for 1 minute to allow user to see the message
+    #endif
+
     // Initialize the road qualifier
     while(true){
       if (roadQualifier.begin()) {
@@ -157,6 +219,13 @@ void setup() {
       }
     }
 
+    if (initSegmentLog()) {
+        Serial.print("Segment log mounted, unpublished segments: ");
+        Serial.println(segmentLog.size());
+    } else {
+        Serial.println("Failed to mount the segment log, segments are only buffered in RAM.");
+    }
+
     t1.start(task1_function);
     t2.start(task2_function);    
 }
@@ -0,0 +1,102 @@
+// Records a drive trace for host replay (see host/TraceReplay.h):
+// MPU6050 Z acceleration at SAMPLE_PERIOD_US and every NMEA sentence or UBX
+// frame from the GPS, each line stamped with micros() since the start of
+// recording. To record UBX, run the GPS_UBX firmware first (the receiver
+// keeps its configuration until it loses power) and set GPS_BAUD to
+// UBX_BAUD (115200).
+// Capture the serial output to a file, e.g. `arduino-cli monitor > drive.trace`.
+#include <Wire.h>
+#include <MPU6050.h>  // MPU6050 library by Electronic Cats
+
+#define SERIAL_BAUD 115200
+#define GPS_BAUD 9600
+#define SAMPLE_PERIOD_US 1000  // 1 kHz
+
+MPU6050 mpu;
+
+char sentence[100];
+size_t sentenceLength = 0;
+unsigned long sentenceStart = 0;
+uint8_t frame[200];         // UBX frame from sync to checksum
+size_t frameLength = 0;     // 0: not in a frame
+size_t frameSize = 0;       // Known once the length field is in
+unsigned long frameStart = 0;
+unsigned long recordStart = 0;
+unsigned long nextSample = 0;
+
+void setup() {
+  Serial.begin(SERIAL_BAUD);
+  while (!Serial);
+
+  Wire.begin();
+  Wire.setClock(400000);
+  mpu.initialize();
+  if (!mpu.testConnection()) {
+    Serial.println("# MPU6050 connection failed");
+    while (1);
+  }
+  // Same offsets as the firmware
+  mpu.setXAccelOffset(2290);
+  mpu.setYAccelOffset(-2687);
+  mpu.setZAccelOffset(5392);
+
+  Serial1.begin(GPS_BAUD);
+
+  Serial.println("# roadsense-trace v1");
+  recordStart = micros();
+  nextSample = recordStart;
+}
+
+void loop() {
+  // NMEA: one line per sentence, stamped with the arrival of its '$'
+  // UBX: one line per frame in hex, stamped with the arrival of its sync
+  while (Serial1.available() > 0) {
+    char c = Serial1.read();
+    if (frameLength > 0 || ((uint8_t)c == 0xB5 && sentenceLength == 0)) {
+      if (frameLength == 0) frameStart = micros() - recordStart;
+      frame[frameLength++] = (uint8_t)c;
+      if (frameLength == 2 && frame[1] != 0x62) frameLength = 0;
+      if (frameLength == 6) frameSize = 8 + (frame[4] | frame[5] << 8);
+      if (frameLength == 6 && frameSize > sizeof(frame)) frameLength = 0;
+      if (frameLength >= 6 && frameLength == frameSize) {
+        Serial.print("U ");
+        Serial.print(frameStart);
+        Serial.print(' ');
+        for (size_t i = 0; i < frameLength; i++) {
+          if (frame[i] < 0x10) Serial.print('0');
+          Serial.print(frame[i], HEX);
+        }
+        Serial.println();
+        frameLength = 0;
+      }
+      continue;
+    }
+    if (c == '$') {
+      sentenceStart = micros() - recordStart;
+      sentenceLength = 0;
+    }
+    if (c == '\r' || c == '\n') {
+      if (sentenceLength > 0) {
+        sentence[sentenceLength] = '\0';
+        Serial.print("G ");
+        Serial.print(sentenceStart);
+        Serial.print(' ');
+        Serial.println(sentence);
+        sentenceLength = 0;
+      }
+    } else if (sentenceLength < sizeof(sentence) - 1) {
+      sentence[sentenceLength++] = c;
+    }
+  }
+
+  // Accelerometer at a fixed period
+  unsigned long now = micros();
+  if ((long)(now - nextSample) >= 0) {
+    int16_t z = mpu.getAccelerationZ();
+    Serial.print("A ");
+    Serial.print(now - recordStart);
+    Serial.print(' ');
+    Serial.println(z);
+    nextSample += SAMPLE_PERIOD_US;
+  }
+}
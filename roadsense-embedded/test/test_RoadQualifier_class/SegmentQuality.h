@@ -1,9 +0,0 @@
-#ifndef SEGMENTQUALITY_H
-#define SEGMENTQUALITY_H
-// Struct to store segment quality data
-struct SegmentQuality {
-  double latitude;
-  double longitude;
-  uint8_t quality;
-};
-#endif // SEGMENTQUALITY_H
\ No newline at end of file